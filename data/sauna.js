@@ -348,6 +348,60 @@ function setDoor(data){
   }
 }
 
+// Binary telemetry frames (src/telemetry_frame.h): version, presence bitmap,
+// then the present fields in bit order, little endian fixed point.
+// Decoded into the same object a JSON frame would give.
+const frameVersion = 1;
+const frameFields = [
+  // key, type, scale
+  ["enabled", "bool"],
+  ["target", "s16", 100],
+  ["pid", "u16", 10000],
+  ["temp", "s16", 100],
+  ["ambiant", "s16", 100],
+  ["door", "door"],
+  ["relayModes", "u8s"],
+  ["relayStates", "u8s"],
+  ["relayDutyCycles", "u16s", 10000],
+  ["voltages", "u16s", 10],
+  ["client", "ip"],
+];
+
+function decodeFrame(buf){
+  const v=new DataView(buf);
+  if (v.getUint8(0) !== frameVersion) throw new Error("frame version "+v.getUint8(0));
+  const present=v.getUint16(1, true);
+  const data={};
+  let p=3;
+  const fixed=(signed, scale)=>{
+    const x=signed ? v.getInt16(p, true) : v.getUint16(p, true);
+    p+=2;
+    return x === (signed ? -32768 : 0xffff) ? null : x/scale;
+  };
+  frameFields.forEach(([key, type, scale], bit)=>{
+    if (!(present & (1<<bit))) return;
+    switch (type) {
+      case "bool": data[key]=v.getUint8(p++) !== 0; break;
+      case "door": data[key]=v.getUint8(p++) ? "open" : "closed"; break;
+      case "s16":  data[key]=fixed(true, scale); break;
+      case "u16":  data[key]=fixed(false, scale); break;
+      case "u8s":
+      case "u16s": {
+        const n=v.getUint8(p++);
+        const arr=[];
+        for (let i=0; i<n; i++) arr.push(type === "u8s" ? v.getUint8(p++) : fixed(false, scale));
+        data[key]=arr;
+        break;
+      }
+      case "ip":
+        data[key]=[0,1,2,3].map(i=>v.getUint8(p+i)).join(".");
+        p+=4;
+        break;
+    }
+  });
+  return data;
+}
+
 function process_json(data)
 {
   lastUpdate=Date.now();
@@ -397,15 +451,21 @@ window.onload=function(){
           console.error('Error fetching status.json:', error);
       });
 
-  // open socket
-  ws=new WebSocket("ws://"+window.location.host+"/ws");
-  ws.onmessage=(event)=>{
-    try{
-      const data=JSON.parse(event.data);
-      process_json(data);
-
-    } catch(e){ console.error("Parse error:",e); }
+  // open socket ; reopened when the server drops us (e.g. evicted for lagging)
+  const connect=()=>{
+    ws=new WebSocket("ws://"+window.location.host+"/ws");
+    ws.binaryType="arraybuffer";
+    ws.onopen=()=>ws.send("proto:bin1");   // compact telemetry; replies stay JSON
+    ws.onmessage=(event)=>{
+      try{
+        const data=(event.data instanceof ArrayBuffer) ? decodeFrame(event.data) : JSON.parse(event.data);
+        process_json(data);
+
+      } catch(e){ console.error("Parse error:",e); }
+    };
+    ws.onclose=()=>setTimeout(connect,2000);
   };
+  connect();
 
   const powerToggle = document.getElementById("powerToggle");
   if (powerToggle) powerToggle.onchange=handlePowerToggle;
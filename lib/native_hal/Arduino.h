@@ -0,0 +1,152 @@
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+/*
+ * Host stand-in for the ESP8266 Arduino core.
+ *
+ * Time is virtual: millis()/micros() read a counter that only moves when the
+ * firmware calls delay() or when the host driver advances it (see hal.h).
+ * Tickers and GPIO interrupts fire from within that advance, which is where
+ * they would preempt loop() on the device.
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include "WString.h"
+#include "IPAddress.h"
+#include "hal.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT             0x00
+#define OUTPUT            0x01
+#define INPUT_PULLUP      0x02
+
+#define RISING    0x01
+#define FALLING   0x02
+#define CHANGE    0x03
+
+#define LSBFIRST 0
+#define MSBFIRST 1
+
+#define IRAM_ATTR
+#define ICACHE_RAM_ATTR
+
+// NodeMCU pin labels (GPIO numbers)
+#define D0 16
+#define D1 5
+#define D2 4
+#define D3 0
+#define D4 2
+#define D5 14
+#define D6 12
+#define D7 13
+#define D8 15
+#define RX 3
+#define TX 1
+#define A0 17
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val);
+
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode);
+void detachInterrupt(uint8_t pin);
+inline uint8_t digitalPinToInterrupt(uint8_t pin) { return pin; }
+void noInterrupts();
+void interrupts();
+
+// timer1: the ESP8266 hardware timer, 80 MHz through a divider
+#define TIM_DIV1    0
+#define TIM_DIV16   1
+#define TIM_DIV256  3
+#define TIM_EDGE    0
+#define TIM_LEVEL   1
+#define TIM_SINGLE  0
+#define TIM_LOOP    1
+typedef void (*timercallback)(void);
+void timer1_isr_init();
+void timer1_attachInterrupt(timercallback userFunc);
+void timer1_detachInterrupt();
+void timer1_enable(uint8_t divider, uint8_t int_type, uint8_t reload);
+void timer1_disable();
+void timer1_write(uint32_t ticks);
+
+// GPIO0..15 output set / clear registers (esp8266_peri.h): a store sets or
+// clears the pins of its mask, one digitalWrite() each here
+namespace hal {
+  struct GpioOutputRegister {
+    uint8_t level;
+    void operator=(uint32_t mask) const;
+  };
+}
+extern const hal::GpioOutputRegister GPOS, GPOC;
+
+template <typename T> T constrain(T x, T lo, T hi) { return x < lo ? lo : x > hi ? hi : x; }
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buf, size_t len);
+    size_t write(const char *s) { return s ? write((const uint8_t *)s, strlen(s)) : 0; }
+
+    size_t print(const char *s) { return write(s); }
+    size_t print(const String &s) { return write(s.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int v, int base = 10) { return print(String(v, (unsigned char)base)); }
+    size_t print(unsigned int v, int base = 10) { return print(String(v, (unsigned char)base)); }
+    size_t print(long v, int base = 10) { return print(String(v, (unsigned char)base)); }
+    size_t print(unsigned long v, int base = 10) { return print(String(v, (unsigned char)base)); }
+    size_t print(double v, int digits = 2) { return print(String(v, (unsigned char)digits)); }
+    size_t print(const IPAddress &ip) { return print(ip.toString()); }
+
+    template <typename T> size_t println(const T &v) { size_t n = print(v); return n + println(); }
+    template <typename T> size_t println(const T &v, int fmt) { size_t n = print(v, fmt); return n + println(); }
+    size_t println() { return write("\r\n"); }
+
+    size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class HardwareSerial : public Print {
+  public:
+    void begin(unsigned long baud) { (void)baud; }
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buf, size_t len) override;
+    using Print::write;
+    int available() { return 0; }
+    int read() { return -1; }
+    void flush() {}
+};
+
+extern HardwareSerial Serial;
+
+class EspClass {
+  public:
+    uint32_t getFreeHeap() { return 40 * 1024; }
+    uint32_t getCycleCount() { return (uint32_t)(hal::now_us() * 80); } // 80 MHz
+    void restart() { exit(0); }
+};
+
+extern EspClass ESP;
+
+// the firmware defines these
+void setup();
+void loop();
+
+#endif
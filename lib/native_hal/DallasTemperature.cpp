@@ -0,0 +1,44 @@
+#include "DallasTemperature.h"
+
+bool DallasTemperature::getAddress(uint8_t *address, uint8_t index) {
+  if (index >= _wire->devices() || !_wire->device(index).connected) return false;
+  memcpy(address, _wire->device(index).address, 8);
+  return true;
+}
+
+int16_t DallasTemperature::millisToWaitForConversion(uint8_t bits) const {
+  switch (bits) {
+    case 9:  return 94;
+    case 10: return 188;
+    case 11: return 375;
+    default: return 750;
+  }
+}
+
+void DallasTemperature::requestTemperatures() {
+  unsigned long conv = millisToWaitForConversion(_resolution);
+  _wire->convertAll((uint64_t)conv * 1000);
+  if (_wait) delay(conv);
+}
+
+bool DallasTemperature::isConversionComplete() {
+  for (size_t i = 0; i < _wire->devices(); i++) {
+    FakeDS18B20 &d = _wire->device(i);
+    if (d.connected && d.converting()) return false;
+  }
+  return true;
+}
+
+float DallasTemperature::getTempC(const uint8_t *address) {
+  FakeDS18B20 *d = _wire->find(address);
+  if (!d || !d->connected) return DEVICE_DISCONNECTED_C;
+
+  // quantize like the sensor does: 1/16 °C at 12 bits, 1/2 °C at 9 bits
+  float step = 0.0625f * (1 << (12 - _resolution));
+  return floorf(d->read() / step) * step;
+}
+
+float DallasTemperature::getTempCByIndex(uint8_t index) {
+  if (index >= _wire->devices()) return DEVICE_DISCONNECTED_C;
+  return getTempC(_wire->device(index).address);
+}
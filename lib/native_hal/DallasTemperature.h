@@ -0,0 +1,39 @@
+#ifndef NATIVE_DALLASTEMPERATURE_H
+#define NATIVE_DALLASTEMPERATURE_H
+/*
+ * Host stand-in for milesburton/DallasTemperature, talking to the fake bus
+ * from OneWire.h. Only the calls the firmware makes are provided.
+ */
+#include <Arduino.h>
+#include <OneWire.h>
+
+#define DEVICE_DISCONNECTED_C -127
+
+typedef uint8_t DeviceAddress[8];
+
+class DallasTemperature {
+  public:
+    explicit DallasTemperature(OneWire *wire) : _wire(wire), _wait(true), _resolution(12) {}
+
+    void begin() {}
+    uint8_t getDeviceCount() const { return (uint8_t)_wire->devices(); }
+    bool getAddress(uint8_t *address, uint8_t index);
+
+    void setWaitForConversion(bool wait) { _wait = wait; }
+    bool getWaitForConversion() const { return _wait; }
+    void setResolution(uint8_t bits) { _resolution = bits < 9 ? 9 : bits > 12 ? 12 : bits; }
+    uint8_t getResolution() const { return _resolution; }
+    int16_t millisToWaitForConversion(uint8_t bits) const;
+
+    void requestTemperatures();
+    bool isConversionComplete();
+    float getTempC(const uint8_t *address);
+    float getTempCByIndex(uint8_t index);
+
+  private:
+    OneWire *_wire;
+    bool _wait;
+    uint8_t _resolution;
+};
+
+#endif
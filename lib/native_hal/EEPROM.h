@@ -0,0 +1,49 @@
+#ifndef NATIVE_EEPROM_H
+#define NATIVE_EEPROM_H
+/*
+ * Emulated flash-backed EEPROM: a RAM image (erased to 0xFF) with the
+ * ESP8266 begin()/get()/put()/commit() semantics.
+ */
+#include <Arduino.h>
+#include <vector>
+
+class EEPROMClass {
+  public:
+    void begin(size_t size) { _data.assign(size, 0xFF); }
+    void end() { _data.clear(); }
+    size_t length() const { return _data.size(); }
+    uint8_t *getDataPtr() { _dirty = true; return _data.data(); }
+
+    uint8_t read(int address) const {
+      return address >= 0 && (size_t)address < _data.size() ? _data[address] : 0;
+    }
+    void write(int address, uint8_t value) {
+      if (address < 0 || (size_t)address >= _data.size()) return;
+      _data[address] = value;
+      _dirty = true;
+    }
+
+    template <typename T> T &get(int address, T &t) const {
+      if (address >= 0 && address + sizeof(T) <= _data.size()) memcpy((void *)&t, &_data[address], sizeof(T));
+      return t;
+    }
+    template <typename T> const T &put(int address, const T &t) {
+      if (address >= 0 && address + sizeof(T) <= _data.size()) {
+        memcpy(&_data[address], (const void *)&t, sizeof(T));
+        _dirty = true;
+      }
+      return t;
+    }
+
+    bool commit() { _commits += _dirty; _dirty = false; return true; }
+    unsigned commits() const { return _commits; }   // host side: flash writes so far
+
+  private:
+    std::vector<uint8_t> _data;
+    bool _dirty = false;
+    unsigned _commits = 0;
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
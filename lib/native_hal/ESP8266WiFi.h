@@ -0,0 +1,57 @@
+#ifndef NATIVE_ESP8266WIFI_H
+#define NATIVE_ESP8266WIFI_H
+/*
+ * WiFi stand-in: station mode "connects" instantly, AP mode just records its
+ * configuration.
+ */
+#include <Arduino.h>
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum { WIFI_OFF = 0, WIFI_STA = 1, WIFI_AP = 2, WIFI_AP_STA = 3 } WiFiMode_t;
+
+class ESP8266WiFiClass {
+  public:
+    bool config(IPAddress local, IPAddress gateway, IPAddress subnet, IPAddress dns = IPAddress()) {
+      (void)gateway; (void)subnet; (void)dns;
+      _local = local;
+      return true;
+    }
+    wl_status_t begin(const char *ssid, const char *passphrase = nullptr, int32_t channel = 0,
+                      const uint8_t *bssid = nullptr, bool connect = true) {
+      (void)ssid; (void)passphrase; (void)channel; (void)bssid;
+      _status = connect ? WL_CONNECTED : WL_DISCONNECTED;
+      return _status;
+    }
+    wl_status_t status() const { return _status; }
+    bool disconnect(bool wifioff = false) { (void)wifioff; _status = WL_DISCONNECTED; return true; }
+    bool mode(WiFiMode_t m) { _mode = m; return true; }
+    WiFiMode_t getMode() const { return _mode; }
+
+    bool softAPConfig(IPAddress local, IPAddress gateway, IPAddress subnet) {
+      (void)gateway; (void)subnet;
+      _ap = local;
+      return true;
+    }
+    bool softAP(const char *ssid, const char *passphrase = nullptr) { (void)ssid; (void)passphrase; return true; }
+    IPAddress softAPIP() const { return _ap; }
+    IPAddress localIP() const { return _local; }
+    String macAddress() const { return String("02:00:00:00:00:01"); }
+    String BSSIDstr() const { return String("02:00:00:00:00:02"); }
+    int32_t RSSI() const { return -60; }
+
+  private:
+    wl_status_t _status = WL_IDLE_STATUS;
+    WiFiMode_t _mode = WIFI_STA;
+    IPAddress _local, _ap;
+};
+
+extern ESP8266WiFiClass WiFi;
+
+#endif
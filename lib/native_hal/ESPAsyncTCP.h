@@ -0,0 +1,5 @@
+#ifndef NATIVE_ESPASYNCTCP_H
+#define NATIVE_ESPASYNCTCP_H
+// nothing to stand in for: the web server shim does not go through TCP
+#include <Arduino.h>
+#endif
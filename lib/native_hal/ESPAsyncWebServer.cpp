@@ -0,0 +1,270 @@
+#include "ESPAsyncWebServer.h"
+#include <stdio.h>
+#include <algorithm>
+
+static String _urlDecode(const String &in) {
+  String out;
+  for (unsigned int i = 0; i < in.length(); i++) {
+    char c = in[i];
+    if (c == '+') {
+      out += ' ';
+    } else if (c == '%' && i + 2 < in.length()) {
+      char hex[3] = { in[i + 1], in[i + 2], 0 };
+      out += (char)strtol(hex, nullptr, 16);
+      i += 2;
+    } else {
+      out += c;
+    }
+  }
+  return out;
+}
+
+// ---- request ----
+
+AsyncWebServerRequest::AsyncWebServerRequest(WebRequestMethodComposite method, const String &url)
+  : _method(method) {
+  int q = url.indexOf('?');
+  _url = q < 0 ? url : url.substring(0, q);
+  if (q < 0) return;
+
+  String qs = url.substring(q + 1);
+  unsigned int start = 0;
+  while (start < qs.length()) {
+    int amp = qs.indexOf('&', start);
+    if (amp < 0) amp = qs.length();
+    String pair = qs.substring(start, amp);
+    int eq = pair.indexOf('=');
+    if (eq < 0) _params.push_back(AsyncWebParameter(_urlDecode(pair), String()));
+    else _params.push_back(AsyncWebParameter(_urlDecode(pair.substring(0, eq)), _urlDecode(pair.substring(eq + 1))));
+    start = amp + 1;
+  }
+}
+
+bool AsyncWebServerRequest::hasParam(const String &name, bool post, bool file) const {
+  return getParam(name, post, file) != nullptr;
+}
+
+AsyncWebParameter *AsyncWebServerRequest::getParam(const String &name, bool post, bool file) const {
+  for (auto &p : _params) {
+    if (p.name() == name && p.isPost() == post && p.isFile() == file) return &p;
+  }
+  return nullptr;
+}
+
+AsyncWebParameter *AsyncWebServerRequest::getParam(size_t num) const {
+  return num < _params.size() ? &_params[num] : nullptr;
+}
+
+AsyncWebHeader *AsyncWebServerRequest::getHeader(const String &name) const {
+  for (auto &h : _headers) {
+    if (h.name().equalsIgnoreCase(name)) return &h;
+  }
+  return nullptr;
+}
+
+void AsyncWebServerRequest::send(int code, const String &contentType, const String &content) {
+  responseCode = code;
+  responseType = contentType;
+  responseBody = content;
+}
+
+void AsyncWebServerRequest::send(AsyncWebServerResponse *response) {
+  responseCode = response->code();
+  responseType = response->contentType();
+  responseHeaders = response->headers();
+  responseBody = response->body();
+  delete response;
+}
+
+static const char *_contentType(const String &path);
+
+AsyncFileResponse::AsyncFileResponse(fs::FS &fs, const String &path, const String &contentType)
+  : AsyncWebServerResponse(200, contentType.length() ? contentType : String(::_contentType(path))) {
+  File f = fs.open(path, "r");
+  if (!f && (f = fs.open(path + ".gz", "r"))) addHeader("Content-Encoding", "gzip");
+  if (f) _content = f.readString();
+}
+
+String AsyncChunkedResponse::body() {
+  String out;
+  uint8_t segment[SEGMENT];
+  for (;;) {
+    size_t n = _filler(segment, sizeof(segment), out.length());
+    if (n == RESPONSE_TRY_AGAIN) continue;
+    if (!n) break;
+    out.concat((const char *)segment, n);
+  }
+  return out;
+}
+
+// ---- handlers ----
+
+bool AsyncCallbackWebHandler::canHandle(AsyncWebServerRequest *request) {
+  return (request->method() & _method) && request->url() == _uri;
+}
+
+String AsyncStaticWebHandler::_resolve(const String &url) const {
+  String rel = url.substring(_uri.length());
+  String path = _path;
+  if (path.endsWith("/") && rel.startsWith("/")) rel = rel.substring(1);
+  path += rel;
+  if (path.endsWith("/")) path += _defaultFile;
+  return path;
+}
+
+bool AsyncStaticWebHandler::canHandle(AsyncWebServerRequest *request) {
+  if (!(request->method() & (HTTP_GET | HTTP_HEAD)) || !request->url().startsWith(_uri)) return false;
+  String path = _resolve(request->url());
+  return _fs.exists(path) || _fs.exists(path + ".gz");
+}
+
+static const char *_contentType(const String &path) {
+  if (path.endsWith(".html") || path.endsWith(".htm")) return "text/html";
+  if (path.endsWith(".css")) return "text/css";
+  if (path.endsWith(".js")) return "application/javascript";
+  if (path.endsWith(".json")) return "application/json";
+  if (path.endsWith(".png")) return "image/png";
+  if (path.endsWith(".jpg")) return "image/jpeg";
+  if (path.endsWith(".svg")) return "image/svg+xml";
+  if (path.endsWith(".gz")) return "application/x-gzip";
+  return "text/plain";
+}
+
+void AsyncStaticWebHandler::handleRequest(AsyncWebServerRequest *request) {
+  String path = _resolve(request->url());
+  File f = _fs.open(path, "r");
+  if (!f) f = _fs.open(path + ".gz", "r");
+  if (!f) {
+    request->send(404);
+    return;
+  }
+  request->send(200, _contentType(path), f.readString());
+}
+
+// ---- websocket ----
+
+bool AsyncWebSocketClient::_enqueue() {
+  if (_status != WS_CONNECTED) return false;
+  if (queueIsFull()) {
+    if (!hal::quiet) printf("ws#%u: too many messages queued\n", (unsigned)_id);
+    return false;
+  }
+  if (_stalled) _queued++;
+  return true;
+}
+
+void AsyncWebSocketClient::text(const char *message, size_t len) {
+  if (!_enqueue()) return;
+  sent.push_back(std::string(message, len));
+  if (!hal::quiet) printf("ws#%u < %.*s\n", (unsigned)_id, (int)len, message);
+}
+
+void AsyncWebSocketClient::binary(const uint8_t *message, size_t len) {
+  if (!_enqueue()) return;
+  sent.push_back(std::string((const char *)message, len));
+  if (!hal::quiet) printf("ws#%u < [%u bytes binary]\n", (unsigned)_id, (unsigned)len);
+}
+
+void AsyncWebSocketClient::close(uint16_t code, const char *message) {
+  (void)code; (void)message;
+  _status = WS_DISCONNECTING;
+}
+
+size_t AsyncWebSocket::count() const {
+  size_t n = 0;
+  for (auto &c : _clients) n += c->status() == WS_CONNECTED;
+  return n;
+}
+
+AsyncWebSocketClient *AsyncWebSocket::client(uint32_t id) {
+  for (auto &c : _clients) {
+    if (c->id() == id && c->status() == WS_CONNECTED) return c.get();
+  }
+  return nullptr;
+}
+
+void AsyncWebSocket::cleanupClients(uint16_t maxClients) {
+  _clients.erase(std::remove_if(_clients.begin(), _clients.end(),
+                                [](const std::unique_ptr<AsyncWebSocketClient> &c) { return c->status() == WS_DISCONNECTED; }),
+                 _clients.end());
+  while (count() > maxClients) _clients.front()->close();
+}
+
+void AsyncWebSocket::textAll(const char *message, size_t len) {
+  for (auto &c : _clients) c->text(message, len);
+}
+
+void AsyncWebSocket::binaryAll(const uint8_t *message, size_t len) {
+  for (auto &c : _clients) c->binary(message, len);
+}
+
+AsyncWebSocketClient *AsyncWebSocket::connect(IPAddress ip) {
+  _clients.emplace_back(new AsyncWebSocketClient(this, _nextId++, ip));
+  AsyncWebSocketClient *c = _clients.back().get();
+  if (_handler) _handler(this, c, WS_EVT_CONNECT, nullptr, nullptr, 0);
+  return c;
+}
+
+void AsyncWebSocket::receive(AsyncWebSocketClient *client, const uint8_t *data, size_t len, AwsFrameType opcode) {
+  if (!_handler || !client || client->status() != WS_CONNECTED) return;
+  AwsFrameInfo info = {};
+  info.message_opcode = opcode;
+  info.final = 1;
+  info.opcode = opcode;
+  info.len = len;
+  info.index = 0;
+  std::vector<uint8_t> copy(data, data + len);   // the library hands out a mutable buffer
+  copy.push_back(0);
+  _handler(this, client, WS_EVT_DATA, &info, copy.data(), len);
+}
+
+void AsyncWebSocket::disconnect(AsyncWebSocketClient *client) {
+  if (!client) return;
+  client->_status = WS_DISCONNECTED;
+  if (_handler) _handler(this, client, WS_EVT_DISCONNECT, nullptr, nullptr, 0);
+}
+
+// ---- server ----
+
+AsyncWebServer *AsyncWebServer::_instance = nullptr;
+
+AsyncWebSocket *AsyncWebServer::websocket() {
+  for (AsyncWebHandler *h : _handlers) {
+    if (AsyncWebSocket *ws = dynamic_cast<AsyncWebSocket *>(h)) return ws;
+  }
+  return nullptr;
+}
+
+AsyncCallbackWebHandler &AsyncWebServer::on(const char *uri, WebRequestMethodComposite method, ArRequestHandlerFunction fn) {
+  AsyncCallbackWebHandler *h = new AsyncCallbackWebHandler(uri, method, fn);
+  _owned.emplace_back(h);
+  addHandler(h);
+  return *h;
+}
+
+AsyncStaticWebHandler &AsyncWebServer::serveStatic(const char *uri, fs::FS &fs, const char *path, const char *cacheControl) {
+  AsyncStaticWebHandler *h = new AsyncStaticWebHandler(uri, fs, path, cacheControl);
+  _owned.emplace_back(h);
+  addHandler(h);
+  return *h;
+}
+
+std::unique_ptr<AsyncWebServerRequest> AsyncWebServer::handle(const char *url, WebRequestMethodComposite method,
+                                                              const std::vector<AsyncWebHeader> &headers) {
+  std::unique_ptr<AsyncWebServerRequest> request(new AsyncWebServerRequest(method, url));
+  for (auto &h : headers) request->addHeader(h.name(), h.value());
+  AsyncWebHandler *handler = nullptr;
+  for (AsyncWebHandler *h : _handlers) {
+    if (h->canHandle(request.get())) { handler = h; break; }
+  }
+  if (handler) handler->handleRequest(request.get());
+  else if (_notFound) _notFound(request.get());
+  else request->send(404);
+
+  if (!hal::quiet) {
+    printf("http %s -> %d %s\n", url, request->responseCode, request->responseType.c_str());
+    if (request->responseType.startsWith("text/plain") || request->responseType.startsWith("text/csv") ||
+        request->responseType.startsWith("application/json")) printf("%s\n", request->responseBody.c_str());
+  }
+  return request;
+}
@@ -0,0 +1,326 @@
+#ifndef NATIVE_ESPASYNCWEBSERVER_H
+#define NATIVE_ESPASYNCWEBSERVER_H
+/*
+ * Host stand-in for me-no-dev/ESPAsyncWebServer.
+ *
+ * There is no socket: the native driver (or a simulator) feeds requests with
+ * AsyncWebServer::handle() and websocket traffic with AsyncWebSocket::connect()
+ * / receive(). Responses and outgoing frames are echoed on stdout unless
+ * hal::quiet is set, and kept on the objects for inspection.
+ */
+#include <Arduino.h>
+#include <FS.h>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#define ASYNCWEBSERVER_H_INCLUDED
+#define WS_MAX_QUEUED_MESSAGES 8   // ESP8266 default
+
+typedef enum {
+  HTTP_GET     = 0b00000001,
+  HTTP_POST    = 0b00000010,
+  HTTP_DELETE  = 0b00000100,
+  HTTP_PUT     = 0b00001000,
+  HTTP_PATCH   = 0b00010000,
+  HTTP_HEAD    = 0b00100000,
+  HTTP_OPTIONS = 0b01000000,
+  HTTP_ANY     = 0b01111111,
+} WebRequestMethod;
+typedef uint8_t WebRequestMethodComposite;
+
+class AsyncWebParameter {
+  public:
+    AsyncWebParameter(const String &name, const String &value, bool form = false, bool file = false, size_t size = 0)
+      : _name(name), _value(value), _size(size), _isForm(form), _isFile(file) {}
+    const String &name() const { return _name; }
+    const String &value() const { return _value; }
+    size_t size() const { return _size; }
+    bool isPost() const { return _isForm; }
+    bool isFile() const { return _isFile; }
+
+  private:
+    String _name, _value;
+    size_t _size;
+    bool _isForm, _isFile;
+};
+
+class AsyncWebHeader {
+  public:
+    AsyncWebHeader(const String &name, const String &value) : _name(name), _value(value) {}
+    const String &name() const { return _name; }
+    const String &value() const { return _value; }
+    String toString() const { return _name + ": " + _value; }
+
+  private:
+    String _name, _value;
+};
+
+// ---- responses ----
+
+#define RESPONSE_TRY_AGAIN 0xFFFFFFFF
+typedef std::function<size_t(uint8_t *buffer, size_t maxLen, size_t index)> AwsResponseFiller;
+
+class AsyncWebServerResponse {
+  public:
+    AsyncWebServerResponse(int code, const String &contentType) : _code(code), _contentType(contentType) {}
+    virtual ~AsyncWebServerResponse() {}
+
+    void addHeader(const String &name, const String &value) { _headers.push_back(AsyncWebHeader(name, value)); }
+    int code() const { return _code; }
+    const String &contentType() const { return _contentType; }
+    const std::vector<AsyncWebHeader> &headers() const { return _headers; }
+    virtual String body() = 0;    // host side: the whole content
+
+  private:
+    int _code;
+    String _contentType;
+    std::vector<AsyncWebHeader> _headers;
+};
+
+class AsyncBasicResponse : public AsyncWebServerResponse {
+  public:
+    AsyncBasicResponse(int code, const String &contentType, const String &content)
+      : AsyncWebServerResponse(code, contentType), _content(content) {}
+    String body() override { return _content; }
+
+  private:
+    String _content;
+};
+
+// <path>.gz with Content-Encoding when only that exists, as the library does
+class AsyncFileResponse : public AsyncWebServerResponse {
+  public:
+    AsyncFileResponse(fs::FS &fs, const String &path, const String &contentType);
+    String body() override { return _content; }
+
+  private:
+    String _content;
+};
+
+// drained in TCP-segment sized pieces, as the library would
+class AsyncChunkedResponse : public AsyncWebServerResponse {
+  public:
+    static constexpr size_t SEGMENT = 536;
+    AsyncChunkedResponse(const String &contentType, AwsResponseFiller filler)
+      : AsyncWebServerResponse(200, contentType), _filler(filler) {}
+    String body() override;
+
+  private:
+    AwsResponseFiller _filler;
+};
+
+class AsyncWebServerRequest {
+  public:
+    AsyncWebServerRequest(WebRequestMethodComposite method, const String &url);
+
+    WebRequestMethodComposite method() const { return _method; }
+    const String &url() const { return _url; }
+
+    size_t params() const { return _params.size(); }
+    bool hasParam(const String &name, bool post = false, bool file = false) const;
+    AsyncWebParameter *getParam(const String &name, bool post = false, bool file = false) const;
+    AsyncWebParameter *getParam(size_t num) const;
+
+    void addHeader(const String &name, const String &value) { _headers.push_back(AsyncWebHeader(name, value)); }
+    bool hasHeader(const String &name) const { return getHeader(name) != nullptr; }
+    AsyncWebHeader *getHeader(const String &name) const;
+    void addInterestingHeader(const String &name) { (void)name; }   // host side: all headers are kept
+
+    void send(int code, const String &contentType = String(), const String &content = String());
+    AsyncWebServerResponse *beginResponse(int code, const String &contentType = String(), const String &content = String()) {
+      return new AsyncBasicResponse(code, contentType, content);
+    }
+    AsyncWebServerResponse *beginResponse(fs::FS &fs, const String &path, const String &contentType = String(), bool download = false) {
+      (void)download;
+      return new AsyncFileResponse(fs, path, contentType);
+    }
+    AsyncWebServerResponse *beginChunkedResponse(const String &contentType, AwsResponseFiller filler) {
+      return new AsyncChunkedResponse(contentType, filler);
+    }
+    void send(AsyncWebServerResponse *response);
+
+    // host side: what the handler answered
+    int responseCode = 0;
+    String responseType;
+    String responseBody;
+    std::vector<AsyncWebHeader> responseHeaders;
+
+  private:
+    WebRequestMethodComposite _method;
+    String _url;
+    mutable std::vector<AsyncWebParameter> _params;
+    mutable std::vector<AsyncWebHeader> _headers;
+};
+
+typedef std::function<void(AsyncWebServerRequest *request)> ArRequestHandlerFunction;
+
+class AsyncWebHandler {
+  public:
+    virtual ~AsyncWebHandler() {}
+    virtual bool canHandle(AsyncWebServerRequest *request) = 0;
+    virtual void handleRequest(AsyncWebServerRequest *request) = 0;
+};
+
+class AsyncCallbackWebHandler : public AsyncWebHandler {
+  public:
+    AsyncCallbackWebHandler(const String &uri, WebRequestMethodComposite method, ArRequestHandlerFunction fn)
+      : _uri(uri), _method(method), _fn(fn) {}
+    bool canHandle(AsyncWebServerRequest *request) override;
+    void handleRequest(AsyncWebServerRequest *request) override { if (_fn) _fn(request); }
+
+  private:
+    String _uri;
+    WebRequestMethodComposite _method;
+    ArRequestHandlerFunction _fn;
+};
+
+class AsyncStaticWebHandler : public AsyncWebHandler {
+  public:
+    AsyncStaticWebHandler(const String &uri, fs::FS &fs, const String &path, const char *cacheControl)
+      : _uri(uri), _fs(fs), _path(path), _cacheControl(cacheControl ? cacheControl : ""), _defaultFile("index.htm") {}
+
+    AsyncStaticWebHandler &setDefaultFile(const char *filename) { _defaultFile = filename; return *this; }
+    AsyncStaticWebHandler &setCacheControl(const char *cacheControl) { _cacheControl = cacheControl; return *this; }
+
+    bool canHandle(AsyncWebServerRequest *request) override;
+    void handleRequest(AsyncWebServerRequest *request) override;
+
+  private:
+    String _uri;
+    fs::FS &_fs;
+    String _path;
+    String _cacheControl;
+    String _defaultFile;
+
+    String _resolve(const String &url) const;
+};
+
+// ---- websocket ----
+
+typedef enum { WS_CONTINUATION, WS_TEXT, WS_BINARY, WS_DISCONNECT = 0x08, WS_PING, WS_PONG } AwsFrameType;
+typedef enum { WS_DISCONNECTED, WS_CONNECTED, WS_DISCONNECTING } AwsClientStatus;
+typedef enum { WS_EVT_CONNECT, WS_EVT_DISCONNECT, WS_EVT_PONG, WS_EVT_ERROR, WS_EVT_DATA } AwsEventType;
+
+typedef struct {
+  uint8_t message_opcode;
+  uint32_t num;
+  uint8_t final;
+  uint8_t masked;
+  uint8_t opcode;
+  uint64_t len;
+  uint8_t mask[4];
+  uint64_t index;
+} AwsFrameInfo;
+
+class AsyncWebSocket;
+
+class AsyncWebSocketClient {
+  public:
+    AsyncWebSocketClient(AsyncWebSocket *server, uint32_t id, IPAddress ip)
+      : _server(server), _id(id), _ip(ip), _status(WS_CONNECTED), _queued(0), _stalled(false) {}
+
+    uint32_t id() const { return _id; }
+    IPAddress remoteIP() const { return _ip; }
+    AwsClientStatus status() const { return _status; }
+    AsyncWebSocket *server() { return _server; }
+
+    void text(const char *message, size_t len);
+    void text(const char *message) { text(message, strlen(message)); }
+    void text(const String &message) { text(message.c_str(), message.length()); }
+    void binary(const uint8_t *message, size_t len);
+    void binary(const char *message, size_t len) { binary((const uint8_t *)message, len); }
+    void close(uint16_t code = 0, const char *message = nullptr);
+
+    // messages not acknowledged yet ; beyond WS_MAX_QUEUED_MESSAGES the library drops them
+    size_t queueLen() const { return _queued; }
+    bool queueIsFull() const { return _queued >= WS_MAX_QUEUED_MESSAGES || _status != WS_CONNECTED; }
+
+    // host side: frames sent to this client so far ; a stalled client (a link
+    // with no acks coming back) keeps them queued until it is resumed
+    std::vector<std::string> sent;
+    void stall(bool stalled) { _stalled = stalled; if (!stalled) _queued = 0; }
+
+  private:
+    AsyncWebSocket *_server;
+    uint32_t _id;
+    IPAddress _ip;
+    AwsClientStatus _status;
+    size_t _queued;
+    bool _stalled;
+
+    bool _enqueue();
+
+    friend class AsyncWebSocket;
+};
+
+typedef std::function<void(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type,
+                           void *arg, uint8_t *data, size_t len)> AwsEventHandler;
+
+class AsyncWebSocket : public AsyncWebHandler {
+  public:
+    explicit AsyncWebSocket(const String &url) : _url(url), _nextId(1) {}
+
+    const char *url() const { return _url.c_str(); }
+    void onEvent(AwsEventHandler handler) { _handler = handler; }
+
+    size_t count() const;
+    AsyncWebSocketClient *client(uint32_t id);
+    void cleanupClients(uint16_t maxClients = 8);
+
+    void textAll(const char *message, size_t len);
+    void textAll(const char *message) { textAll(message, strlen(message)); }
+    void textAll(const String &message) { textAll(message.c_str(), message.length()); }
+    void text(uint32_t id, const char *message) { if (auto c = client(id)) c->text(message); }
+    void text(uint32_t id, const char *message, size_t len) { if (auto c = client(id)) c->text(message, len); }
+    void binary(uint32_t id, const char *message, size_t len) { if (auto c = client(id)) c->binary(message, len); }
+    void binaryAll(const uint8_t *message, size_t len);
+    void binaryAll(const char *message, size_t len) { binaryAll((const uint8_t *)message, len); }
+
+    bool canHandle(AsyncWebServerRequest *request) override { (void)request; return false; }
+    void handleRequest(AsyncWebServerRequest *request) override { (void)request; }
+
+    // host side: drive the server as a browser would
+    AsyncWebSocketClient *connect(IPAddress ip = IPAddress(127, 0, 0, 1));
+    void receive(AsyncWebSocketClient *client, const uint8_t *data, size_t len, AwsFrameType opcode = WS_TEXT);
+    void receive(AsyncWebSocketClient *client, const char *text) { receive(client, (const uint8_t *)text, strlen(text)); }
+    void disconnect(AsyncWebSocketClient *client);
+
+  private:
+    String _url;
+    uint32_t _nextId;
+    AwsEventHandler _handler;
+    std::vector<std::unique_ptr<AsyncWebSocketClient>> _clients;
+};
+
+// ---- server ----
+
+class AsyncWebServer {
+  public:
+    explicit AsyncWebServer(uint16_t port) : _port(port) { _instance = this; }
+
+    void begin() { _begun = true; }
+    void end() { _begun = false; }
+
+    AsyncCallbackWebHandler &on(const char *uri, WebRequestMethodComposite method, ArRequestHandlerFunction fn);
+    AsyncCallbackWebHandler &on(const char *uri, ArRequestHandlerFunction fn) { return on(uri, HTTP_ANY, fn); }
+    AsyncStaticWebHandler &serveStatic(const char *uri, fs::FS &fs, const char *path, const char *cacheControl = nullptr);
+    void onNotFound(ArRequestHandlerFunction fn) { _notFound = fn; }
+    AsyncWebHandler &addHandler(AsyncWebHandler *handler) { _handlers.push_back(handler); return *handler; }
+
+    // host side: run a request through the handlers, like the TCP side would
+    std::unique_ptr<AsyncWebServerRequest> handle(const char *url, WebRequestMethodComposite method = HTTP_GET,
+                                                  const std::vector<AsyncWebHeader> &headers = {});
+    AsyncWebSocket *websocket();                  // first websocket handler added
+    static AsyncWebServer *instance() { return _instance; }
+
+  private:
+    static AsyncWebServer *_instance;
+    uint16_t _port;
+    bool _begun = false;
+    std::vector<AsyncWebHandler *> _handlers;
+    std::vector<std::unique_ptr<AsyncWebHandler>> _owned;
+    ArRequestHandlerFunction _notFound;
+};
+
+#endif
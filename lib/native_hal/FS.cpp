@@ -0,0 +1,174 @@
+#include "FS.h"
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <errno.h>
+#include <algorithm>
+
+namespace hal {
+  std::string fsRoot = ".pio/littlefs";
+  long fsSpace = -1;
+}
+
+fs::FS LittleFS;
+
+namespace fs {
+
+static std::string _host(const char *path) {
+  std::string p = path ? path : "";
+  if (p.empty() || p[0] != '/') p = "/" + p;
+  return hal::fsRoot + p;
+}
+
+// like LittleFS on the ESP8266, opening for writing creates missing directories
+static void _mkdirs(const std::string &hostPath) {
+  for (size_t i = hal::fsRoot.size() + 1; i < hostPath.size(); i++) {
+    if (hostPath[i] == '/') ::mkdir(hostPath.substr(0, i).c_str(), 0755);
+  }
+}
+
+int File::available() {
+  if (!_f) return 0;
+  long here = ftell(_f.get());
+  return (int)(size() - here);
+}
+
+int File::read() {
+  if (!_f) return -1;
+  int c = fgetc(_f.get());
+  return c == EOF ? -1 : c;
+}
+
+int File::peek() {
+  if (!_f) return -1;
+  int c = fgetc(_f.get());
+  if (c == EOF) return -1;
+  ungetc(c, _f.get());
+  return c;
+}
+
+String File::readString() {
+  String s;
+  char buf[256];
+  size_t n;
+  while ((n = readBytes(buf, sizeof(buf))) > 0) s.concat(buf, n);
+  return s;
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+  if (!_f) return false;
+  int whence = mode == SeekCur ? SEEK_CUR : mode == SeekEnd ? SEEK_END : SEEK_SET;
+  return fseek(_f.get(), pos, whence) == 0;
+}
+
+size_t File::size() const {
+  if (!_f) return 0;
+  fflush(_f.get());
+  struct stat st;
+  return fstat(fileno(_f.get()), &st) == 0 ? (size_t)st.st_size : 0;
+}
+
+size_t File::write(const uint8_t *buf, size_t len) {
+  if (!_f) return 0;
+  if (hal::fsSpace >= 0 && len > (size_t)hal::fsSpace) len = hal::fsSpace;   // FS full
+  size_t n = fwrite(buf, 1, len, _f.get());
+  if (hal::fsSpace >= 0) hal::fsSpace -= n;
+  return n;
+}
+
+bool File::truncate(uint32_t size) {
+  if (!_f) return false;
+  fflush(_f.get());
+  return ftruncate(fileno(_f.get()), size) == 0;
+}
+
+const char *File::name() const {
+  size_t slash = _path.rfind('/');
+  return _path.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+}
+
+size_t Dir::fileSize() const {
+  struct stat st;
+  return stat(_host((_path + "/" + _entries[_i]).c_str()).c_str(), &st) == 0 ? (size_t)st.st_size : 0;
+}
+
+bool Dir::isFile() const {
+  struct stat st;
+  return stat(_host((_path + "/" + _entries[_i]).c_str()).c_str(), &st) == 0 && S_ISREG(st.st_mode);
+}
+
+File Dir::openFile(const char *mode) const {
+  return LittleFS.open((_path + "/" + _entries[_i]).c_str(), mode);
+}
+
+bool FS::begin() {
+  for (size_t i = 1; i <= hal::fsRoot.size(); i++) {
+    if (i == hal::fsRoot.size() || hal::fsRoot[i] == '/') ::mkdir(hal::fsRoot.substr(0, i).c_str(), 0755);
+  }
+  struct stat st;
+  return stat(hal::fsRoot.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+bool FS::format() {
+  Dir d = openDir("/");
+  while (d.next()) remove((String("/") + d.fileName()).c_str());
+  return true;
+}
+
+bool FS::info(FSInfo &info) {
+  info.totalBytes = 1024 * 1024;       // 1 MB filesystem, as on a 4 MB NodeMCU layout
+  info.usedBytes = 0;
+  Dir d = openDir("/");
+  while (d.next()) info.usedBytes += d.fileSize();
+  info.blockSize = 8192;
+  info.pageSize = 256;
+  info.maxOpenFiles = 5;
+  info.maxPathLength = 32;
+  return true;
+}
+
+File FS::open(const char *path, const char *mode) {
+  std::string host = _host(path);
+  struct stat st;
+  if (stat(host.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) return File();
+  if (mode[0] != 'r') _mkdirs(host);
+  FILE *f = fopen(host.c_str(), mode);
+  if (!f) return File();
+  std::string p = path[0] == '/' ? path : std::string("/") + path;
+  return File(std::shared_ptr<FILE>(f, fclose), p);
+}
+
+bool FS::exists(const char *path) {
+  struct stat st;
+  return stat(_host(path).c_str(), &st) == 0;
+}
+
+Dir FS::openDir(const char *path) {
+  std::string p = path ? path : "/";
+  while (p.size() > 1 && p.back() == '/') p.pop_back();
+  std::vector<std::string> entries;
+  if (DIR *d = opendir(_host(p.c_str()).c_str())) {
+    while (struct dirent *e = readdir(d)) {
+      if (strcmp(e->d_name, ".") && strcmp(e->d_name, "..")) entries.push_back(e->d_name);
+    }
+    closedir(d);
+  }
+  std::sort(entries.begin(), entries.end());
+  return Dir(p == "/" ? "" : p, entries);
+}
+
+bool FS::remove(const char *path) { return ::unlink(_host(path).c_str()) == 0; }
+
+bool FS::rename(const char *from, const char *to) {
+  std::string dst = _host(to);
+  _mkdirs(dst);
+  return ::rename(_host(from).c_str(), dst.c_str()) == 0;
+}
+
+bool FS::mkdir(const char *path) {
+  return ::mkdir(_host(path).c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+bool FS::rmdir(const char *path) { return ::rmdir(_host(path).c_str()) == 0; }
+
+} // namespace fs
@@ -0,0 +1,113 @@
+#ifndef NATIVE_FS_H
+#define NATIVE_FS_H
+/*
+ * fs::FS / File / Dir over a host directory. Paths are absolute inside the
+ * filesystem ("/index.html") and map onto hal::fsRoot.
+ */
+#include <Arduino.h>
+#include <stdio.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+class File : public Print {
+  public:
+    File() {}
+    File(std::shared_ptr<FILE> f, const std::string &path) : _f(f), _path(path) {}
+
+    explicit operator bool() const { return (bool)_f; }
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *buf, size_t len) override;
+    using Print::write;
+
+    int available();
+    int read();
+    int peek();
+    size_t read(uint8_t *buf, size_t len) { return _f ? fread(buf, 1, len, _f.get()) : 0; }
+    size_t readBytes(char *buf, size_t len) { return read((uint8_t *)buf, len); }
+    String readString();
+
+    bool seek(uint32_t pos, SeekMode mode = SeekSet);
+    size_t position() const { return _f ? (size_t)ftell(_f.get()) : 0; }
+    size_t size() const;
+    void flush() { if (_f) fflush(_f.get()); }
+    bool truncate(uint32_t size);
+    void close() { _f.reset(); }
+
+    const char *name() const;
+    const char *fullName() const { return _path.c_str(); }
+    bool isFile() const { return (bool)_f; }
+    bool isDirectory() const { return false; }
+
+  private:
+    std::shared_ptr<FILE> _f;
+    std::string _path;
+};
+
+class Dir {
+  public:
+    Dir() {}
+    Dir(const std::string &path, std::vector<std::string> entries) : _path(path), _entries(entries) {}
+
+    bool next() { return ++_i < (int)_entries.size(); }
+    String fileName() const { return String(_entries[_i].c_str()); }
+    size_t fileSize() const;
+    bool isFile() const;
+    bool isDirectory() const { return !isFile(); }
+    File openFile(const char *mode) const;
+    bool rewind() { _i = -1; return true; }
+
+  private:
+    std::string _path;
+    std::vector<std::string> _entries;
+    int _i = -1;
+};
+
+struct FSInfo {
+  size_t totalBytes;
+  size_t usedBytes;
+  size_t blockSize;
+  size_t pageSize;
+  size_t maxOpenFiles;
+  size_t maxPathLength;
+};
+
+class FS {
+  public:
+    bool begin();
+    void end() {}
+    bool format();
+    bool info(FSInfo &info);
+
+    File open(const char *path, const char *mode = "r");
+    File open(const String &path, const char *mode = "r") { return open(path.c_str(), mode); }
+    bool exists(const char *path);
+    bool exists(const String &path) { return exists(path.c_str()); }
+    Dir openDir(const char *path);
+    Dir openDir(const String &path) { return openDir(path.c_str()); }
+    bool remove(const char *path);
+    bool remove(const String &path) { return remove(path.c_str()); }
+    bool rename(const char *from, const char *to);
+    bool rename(const String &from, const String &to) { return rename(from.c_str(), to.c_str()); }
+    bool mkdir(const char *path);
+    bool mkdir(const String &path) { return mkdir(path.c_str()); }
+    bool rmdir(const char *path);
+};
+
+} // namespace fs
+
+using fs::FS;
+using fs::File;
+using fs::Dir;
+using fs::FSInfo;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef NATIVE_IPADDRESS_H
+#define NATIVE_IPADDRESS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "WString.h"
+
+class IPAddress {
+  public:
+    IPAddress() : _b{0, 0, 0, 0} {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : _b{a, b, c, d} {}
+
+    uint8_t operator[](int i) const { return _b[i]; }
+    bool operator==(const IPAddress &o) const { return memcmp(_b, o._b, 4) == 0; }
+
+    String toString() const {
+      char buf[16];
+      snprintf(buf, sizeof(buf), "%u.%u.%u.%u", _b[0], _b[1], _b[2], _b[3]);
+      return String(buf);
+    }
+
+  private:
+    uint8_t _b[4];
+};
+
+#endif
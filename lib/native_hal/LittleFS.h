@@ -0,0 +1,7 @@
+#ifndef NATIVE_LITTLEFS_H
+#define NATIVE_LITTLEFS_H
+#include "FS.h"
+
+extern fs::FS LittleFS;
+
+#endif
@@ -0,0 +1,63 @@
+#include "OneWire.h"
+
+OneWire *OneWire::_instance = nullptr;
+
+float FakeDS18B20::read() {
+  if (readyAt_us && hal::now_us() >= readyAt_us) {
+    scratchpad = pending;
+    readyAt_us = 0;
+  }
+  return scratchpad;
+}
+
+bool FakeDS18B20::converting() const {
+  return readyAt_us && hal::now_us() < readyAt_us;
+}
+
+FakeDS18B20 *OneWire::attach(float temperature) {
+  if (_count >= MAX_DEVICES) return nullptr;
+
+  FakeDS18B20 &d = _devices[_count];
+  d.address[0] = 0x28;                    // DS18B20 family code
+  for (uint8_t i = 1; i < 7; i++) d.address[i] = (uint8_t)(0x10 * _pin + 0x11 * (_count + 1) + i);
+  d.address[7] = crc8(d.address, 7);
+  d.temperature = temperature;
+  d.connected = true;
+  d.scratchpad = 85.0f;
+  d.pending = 85.0f;
+  d.readyAt_us = 0;
+  _count++;
+  return &d;
+}
+
+FakeDS18B20 *OneWire::find(const uint8_t *address) {
+  for (size_t i = 0; i < _count; i++) {
+    if (memcmp(_devices[i].address, address, 8) == 0) return &_devices[i];
+  }
+  return nullptr;
+}
+
+void OneWire::convertAll(uint64_t conversion_us) {
+  for (size_t i = 0; i < _count; i++) {
+    FakeDS18B20 &d = _devices[i];
+    if (!d.connected) continue;
+    d.read();                               // retire a conversion that already completed
+    d.pending = d.temperature;
+    d.readyAt_us = hal::now_us() + conversion_us;
+  }
+}
+
+// Dallas/Maxim CRC8 (x^8 + x^5 + x^4 + 1), same as the real OneWire library
+uint8_t OneWire::crc8(const uint8_t *addr, uint8_t len) {
+  uint8_t crc = 0;
+  while (len--) {
+    uint8_t inbyte = *addr++;
+    for (uint8_t i = 8; i; i--) {
+      uint8_t mix = (crc ^ inbyte) & 0x01;
+      crc >>= 1;
+      if (mix) crc ^= 0x8C;
+      inbyte >>= 1;
+    }
+  }
+  return crc;
+}
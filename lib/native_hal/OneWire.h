@@ -0,0 +1,48 @@
+#ifndef NATIVE_ONEWIRE_H
+#define NATIVE_ONEWIRE_H
+/*
+ * Fake 1-wire bus for host builds: instead of bit-banging a pin it holds a
+ * handful of simulated DS18B20 devices whose temperature the host side sets.
+ * Conversion latency follows the virtual clock, like the real parts.
+ */
+#include <Arduino.h>
+
+struct FakeDS18B20 {
+  uint8_t address[8];
+  float temperature;      // what the die currently "feels"
+  bool connected;
+
+  float scratchpad;       // last completed conversion (85 °C at power-up, like the real part)
+  float pending;          // value latched when the running conversion completes
+  uint64_t readyAt_us;    // virtual time at which the running conversion completes
+
+  float read();           // scratchpad as seen by the master right now
+  bool converting() const;
+};
+
+class OneWire {
+  public:
+    static constexpr size_t MAX_DEVICES = 8;
+
+    explicit OneWire(uint8_t pin) : _pin(pin), _count(0) { if (!_instance) _instance = this; }
+    static OneWire *instance() { return _instance; }   // first bus the firmware created
+
+    // host side: plug a sensor on the bus ; ROM code is generated (family 0x28, valid CRC)
+    FakeDS18B20 *attach(float temperature);
+    size_t devices() const { return _count; }
+    FakeDS18B20 &device(size_t i) { return _devices[i]; }
+    FakeDS18B20 *find(const uint8_t *address);
+
+    // master side: start a conversion on every connected device
+    void convertAll(uint64_t conversion_us);
+
+    static uint8_t crc8(const uint8_t *addr, uint8_t len);
+
+  private:
+    static OneWire *_instance;
+    uint8_t _pin;
+    size_t _count;
+    FakeDS18B20 _devices[MAX_DEVICES];
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef NATIVE_TICKER_H
+#define NATIVE_TICKER_H
+/*
+ * Ticker on the virtual clock: callbacks fire from hal::advance_us(), i.e.
+ * while the firmware sits in delay(), as they would preempt it on the device.
+ */
+#include <Arduino.h>
+#include <functional>
+
+class Ticker : private hal::Timer {
+  public:
+    typedef std::function<void(void)> callback_function_t;
+
+    ~Ticker() { detach(); }
+
+    void attach(float seconds, callback_function_t cb) { _start((uint64_t)(seconds * 1e6), true, cb); }
+    void attach_ms(uint32_t ms, callback_function_t cb) { _start((uint64_t)ms * 1000, true, cb); }
+    void attach_us(uint32_t us, callback_function_t cb) { _start(us, true, cb); }
+    void once(float seconds, callback_function_t cb) { _start((uint64_t)(seconds * 1e6), false, cb); }
+    void once_ms(uint32_t ms, callback_function_t cb) { _start((uint64_t)ms * 1000, false, cb); }
+    void once_us(uint32_t us, callback_function_t cb) { _start(us, false, cb); }
+
+    template <typename TArg> void attach_ms(uint32_t ms, void (*cb)(TArg), TArg arg) {
+      attach_ms(ms, [cb, arg]() { cb(arg); });
+    }
+    template <typename TArg> void once_ms(uint32_t ms, void (*cb)(TArg), TArg arg) {
+      once_ms(ms, [cb, arg]() { cb(arg); });
+    }
+
+    void detach() { hal::disarm(this); }
+    bool active() const { return armed; }
+
+  private:
+    uint64_t _period_us = 0;
+    bool _repeat = false;
+    callback_function_t _cb;
+
+    void _start(uint64_t period_us, bool repeat, callback_function_t cb) {
+      _period_us = period_us ? period_us : 1;
+      _repeat = repeat;
+      _cb = cb;
+      hal::arm(this, hal::now_us() + _period_us);
+    }
+
+    void fire() override {
+      if (_repeat) hal::arm(this, due_us + _period_us);   // drift-free, like the SDK timer
+      if (_cb) _cb();
+    }
+};
+
+#endif
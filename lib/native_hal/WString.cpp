@@ -0,0 +1,106 @@
+#include "WString.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <strings.h>
+
+static std::string _fmtInteger(unsigned long v, bool negative, unsigned char base) {
+  if (base < 2 || base > 36) base = 10;
+  char buf[8 * sizeof(long) + 2];
+  char *p = buf + sizeof(buf) - 1;
+  *p = '\0';
+  do {
+    unsigned digit = v % base;
+    *--p = (char)(digit < 10 ? '0' + digit : 'a' + digit - 10);
+    v /= base;
+  } while (v);
+  if (negative) *--p = '-';
+  return p;
+}
+
+String::String(int v, unsigned char base) : String((long)v, base) {}
+String::String(unsigned int v, unsigned char base) : String((unsigned long)v, base) {}
+
+String::String(long v, unsigned char base) {
+  // like the Arduino core, only base 10 gets a sign
+  if (base == 10 && v < 0) _s = _fmtInteger(-(unsigned long)v, true, base);
+  else _s = _fmtInteger((unsigned long)v, false, base);
+}
+
+String::String(unsigned long v, unsigned char base) : _s(_fmtInteger(v, false, base)) {}
+
+String::String(float v, unsigned char decimals) : String((double)v, decimals) {}
+
+String::String(double v, unsigned char decimals) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+  _s = buf;
+}
+
+bool String::equalsIgnoreCase(const String &s) const {
+  return _s.size() == s._s.size() && strcasecmp(_s.c_str(), s._s.c_str()) == 0;
+}
+
+bool String::startsWith(const String &prefix, unsigned int offset) const {
+  return offset + prefix._s.size() <= _s.size() && _s.compare(offset, prefix._s.size(), prefix._s) == 0;
+}
+
+bool String::endsWith(const String &suffix) const {
+  return suffix._s.size() <= _s.size() &&
+         _s.compare(_s.size() - suffix._s.size(), suffix._s.size(), suffix._s) == 0;
+}
+
+int String::indexOf(char c, unsigned int from) const {
+  size_t p = _s.find(c, from);
+  return p == std::string::npos ? -1 : (int)p;
+}
+
+int String::indexOf(const String &s, unsigned int from) const {
+  size_t p = _s.find(s._s, from);
+  return p == std::string::npos ? -1 : (int)p;
+}
+
+int String::lastIndexOf(char c) const {
+  size_t p = _s.rfind(c);
+  return p == std::string::npos ? -1 : (int)p;
+}
+
+int String::lastIndexOf(const String &s) const {
+  size_t p = _s.rfind(s._s);
+  return p == std::string::npos ? -1 : (int)p;
+}
+
+String String::substring(unsigned int from, unsigned int to) const {
+  if (from > to) { unsigned int t = from; from = to; to = t; }
+  if (from >= _s.size()) return String();
+  if (to > _s.size()) to = (unsigned int)_s.size();
+  return String(_s.substr(from, to - from));
+}
+
+void String::remove(unsigned int index, unsigned int count) {
+  if (index >= _s.size()) return;
+  _s.erase(index, count);
+}
+
+void String::replace(const String &find, const String &with) {
+  if (find._s.empty()) return;
+  size_t p = 0;
+  while ((p = _s.find(find._s, p)) != std::string::npos) {
+    _s.replace(p, find._s.size(), with._s);
+    p += with._s.size();
+  }
+}
+
+void String::toLowerCase() { for (auto &c : _s) c = (char)tolower((unsigned char)c); }
+void String::toUpperCase() { for (auto &c : _s) c = (char)toupper((unsigned char)c); }
+
+void String::trim() {
+  size_t b = 0, e = _s.size();
+  while (b < e && isspace((unsigned char)_s[b])) b++;
+  while (e > b && isspace((unsigned char)_s[e - 1])) e--;
+  _s = _s.substr(b, e - b);
+}
+
+long String::toInt() const { return atol(_s.c_str()); }
+float String::toFloat() const { return (float)atof(_s.c_str()); }
+double String::toDouble() const { return atof(_s.c_str()); }
@@ -0,0 +1,89 @@
+#ifndef NATIVE_WSTRING_H
+#define NATIVE_WSTRING_H
+/*
+ * Arduino String on top of std::string ; covers what the firmware and
+ * ArduinoJson use, with the same semantics (indexOf returns -1, substring
+ * clamps, toInt/toFloat stop at the first invalid character...).
+ */
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+
+class String {
+  public:
+    String() {}
+    String(const char *s) : _s(s ? s : "") {}
+    String(const char *s, size_t len) : _s(s, len) {}
+    String(const std::string &s) : _s(s) {}
+    explicit String(char c) : _s(1, c) {}
+    explicit String(int v, unsigned char base = 10);
+    explicit String(unsigned int v, unsigned char base = 10);
+    explicit String(long v, unsigned char base = 10);
+    explicit String(unsigned long v, unsigned char base = 10);
+    explicit String(float v, unsigned char decimals = 2);
+    explicit String(double v, unsigned char decimals = 2);
+
+    const char *c_str() const { return _s.c_str(); }
+    unsigned int length() const { return (unsigned int)_s.length(); }
+    bool isEmpty() const { return _s.empty(); }
+    bool reserve(unsigned int size) { _s.reserve(size); return true; }
+
+    bool concat(const String &s) { _s += s._s; return true; }
+    bool concat(const char *s) { if (s) _s += s; return true; }
+    bool concat(const char *s, unsigned int len) { if (s) _s.append(s, len); return true; }
+    bool concat(char c) { _s += c; return true; }
+    bool concat(int v) { return concat(String(v)); }
+    bool concat(unsigned int v) { return concat(String(v)); }
+    bool concat(long v) { return concat(String(v)); }
+    bool concat(unsigned long v) { return concat(String(v)); }
+    bool concat(float v) { return concat(String(v)); }
+    bool concat(double v) { return concat(String(v)); }
+
+    template <typename T> String &operator+=(const T &v) { concat(v); return *this; }
+
+    char charAt(unsigned int i) const { return i < _s.size() ? _s[i] : 0; }
+    void setCharAt(unsigned int i, char c) { if (i < _s.size()) _s[i] = c; }
+    char operator[](unsigned int i) const { return charAt(i); }
+    char &operator[](unsigned int i) { return _s[i]; }
+
+    int compareTo(const String &s) const { return _s.compare(s._s); }
+    bool equals(const String &s) const { return _s == s._s; }
+    bool equals(const char *s) const { return _s == (s ? s : ""); }
+    bool equalsIgnoreCase(const String &s) const;
+    bool startsWith(const String &prefix, unsigned int offset = 0) const;
+    bool endsWith(const String &suffix) const;
+
+    int indexOf(char c, unsigned int from = 0) const;
+    int indexOf(const String &s, unsigned int from = 0) const;
+    int lastIndexOf(char c) const;
+    int lastIndexOf(const String &s) const;
+    String substring(unsigned int from) const { return substring(from, length()); }
+    String substring(unsigned int from, unsigned int to) const;
+
+    void remove(unsigned int index) { remove(index, (unsigned int)-1); }
+    void remove(unsigned int index, unsigned int count);
+    void replace(const String &find, const String &with);
+    void toLowerCase();
+    void toUpperCase();
+    void trim();
+
+    long toInt() const;
+    float toFloat() const;
+    double toDouble() const;
+
+    friend bool operator==(const String &a, const String &b) { return a._s == b._s; }
+    friend bool operator==(const String &a, const char *b) { return a.equals(b); }
+    friend bool operator==(const char *a, const String &b) { return b.equals(a); }
+    friend bool operator!=(const String &a, const String &b) { return a._s != b._s; }
+    friend bool operator!=(const String &a, const char *b) { return !a.equals(b); }
+    friend bool operator<(const String &a, const String &b) { return a._s < b._s; }
+    friend bool operator>(const String &a, const String &b) { return a._s > b._s; }
+
+    template <typename T> friend String operator+(const String &a, const T &b) { String r(a); r.concat(b); return r; }
+    friend String operator+(const char *a, const String &b) { String r(a); r.concat(b); return r; }
+
+  private:
+    std::string _s;
+};
+
+#endif
@@ -0,0 +1,226 @@
+#include "Arduino.h"
+#include "EEPROM.h"
+#include "ESP8266WiFi.h"
+#include <stdio.h>
+#include <vector>
+
+HardwareSerial Serial;
+EspClass ESP;
+EEPROMClass EEPROM;
+ESP8266WiFiClass WiFi;
+
+namespace hal {
+
+bool quiet = false;
+
+static uint64_t _now_us = 0;
+static std::vector<Timer *> _timers;
+static std::vector<AdvanceHook> _advanceHooks;
+
+Timer::~Timer() { disarm(this); }
+
+uint64_t now_us() { return _now_us; }
+
+void arm(Timer *t, uint64_t due_us) {
+  t->due_us = due_us;
+  if (!t->armed) _timers.push_back(t);
+  t->armed = true;
+}
+
+void disarm(Timer *t) {
+  if (!t->armed) return;
+  t->armed = false;
+  _timers.erase(std::remove(_timers.begin(), _timers.end(), t), _timers.end());
+}
+
+void onAdvance(AdvanceHook hook) { _advanceHooks.push_back(hook); }
+
+static void _step(uint64_t to_us) {
+  // a timer callback may have delay()ed past the outer target: time never goes back
+  if (to_us <= _now_us) return;
+  uint64_t dt = to_us - _now_us;
+  _now_us = to_us;
+  for (auto &h : _advanceHooks) h(_now_us, dt);
+}
+
+void advance_us(uint64_t us) {
+  uint64_t target = _now_us + us;
+  for (;;) {
+    Timer *next = nullptr;
+    for (Timer *t : _timers) {
+      if (t->due_us <= target && (!next || t->due_us < next->due_us)) next = t;
+    }
+    if (!next) break;
+    _step(next->due_us > _now_us ? next->due_us : _now_us);
+    disarm(next);       // fire() re-arms periodic timers
+    next->fire();
+  }
+  _step(target);
+}
+
+// ---- GPIO ----
+
+struct Pin {
+  uint8_t mode = INPUT;
+  int level = LOW;
+  bool driven = false;            // level set from outside with setInput()
+  void (*isr)() = nullptr;
+  int isrMode = 0;
+};
+static Pin _pins[32];
+static std::vector<WriteHook> _writeHooks;
+static AnalogSource _analog;
+static bool _interrupts = true;
+
+static Pin *_pin(uint8_t pin) { return pin < 32 ? &_pins[pin] : nullptr; }
+
+int pinLevel(uint8_t pin) {
+  Pin *p = _pin(pin);
+  if (!p) return LOW;
+  if (p->mode == INPUT_PULLUP && !p->driven) return HIGH;
+  return p->level;
+}
+
+uint8_t pinModeOf(uint8_t pin) { Pin *p = _pin(pin); return p ? p->mode : INPUT; }
+
+void setInput(uint8_t pin, int level) {
+  Pin *p = _pin(pin);
+  if (!p) return;
+  int before = pinLevel(pin);
+  p->driven = true;
+  p->level = level ? HIGH : LOW;
+  int after = pinLevel(pin);
+  if (!p->isr || before == after) return;
+  if (p->isrMode == CHANGE || (p->isrMode == RISING && after) || (p->isrMode == FALLING && !after)) p->isr();
+}
+
+void onDigitalWrite(WriteHook hook) { _writeHooks.push_back(hook); }
+void setAnalogSource(AnalogSource source) { _analog = source; }
+bool interruptsEnabled() { return _interrupts; }
+
+} // namespace hal
+
+unsigned long millis() { return (unsigned long)(hal::now_us() / 1000); }
+unsigned long micros() { return (unsigned long)hal::now_us(); }
+void delay(unsigned long ms) { hal::advance(ms); }
+void delayMicroseconds(unsigned int us) { hal::advance_us(us); }
+void yield() {}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (hal::Pin *p = hal::_pin(pin)) p->mode = mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  hal::Pin *p = hal::_pin(pin);
+  if (!p) return;
+  int level = val ? HIGH : LOW;
+  bool changed = p->level != level;
+  p->level = level;
+  p->driven = false;
+  if (changed) for (auto &h : hal::_writeHooks) h(pin, level);
+}
+
+int digitalRead(uint8_t pin) { return hal::pinLevel(pin); }
+
+int analogRead(uint8_t pin) {
+  return hal::_analog ? hal::_analog(pin) : 0;
+}
+
+const hal::GpioOutputRegister GPOS = { HIGH }, GPOC = { LOW };
+
+void hal::GpioOutputRegister::operator=(uint32_t mask) const {
+  for (uint8_t pin = 0; pin < 16; pin++) {
+    if (mask & (1u << pin)) digitalWrite(pin, level);
+  }
+}
+
+void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val) {
+  for (uint8_t i = 0; i < 8; i++) {
+    digitalWrite(dataPin, bitOrder == LSBFIRST ? (val >> i) & 1 : (val >> (7 - i)) & 1);
+    digitalWrite(clockPin, HIGH);
+    digitalWrite(clockPin, LOW);
+  }
+}
+
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode) {
+  if (hal::Pin *p = hal::_pin(pin)) { p->isr = isr; p->isrMode = mode; }
+}
+
+void detachInterrupt(uint8_t pin) {
+  if (hal::Pin *p = hal::_pin(pin)) p->isr = nullptr;
+}
+
+void noInterrupts() { hal::_interrupts = false; }
+void interrupts() { hal::_interrupts = true; }
+
+// ---- timer1 ----
+
+namespace hal {
+
+struct Timer1 : Timer {
+  timercallback isr = nullptr;
+  bool enabled = false, loop = false;
+  uint32_t divider = 16;                // timer clock is 80 MHz / divider
+  uint32_t reload = 0;
+
+  uint64_t span_us(uint32_t ticks) const { return ((uint64_t)ticks * divider + 79) / 80; }
+
+  void fire() override {
+    if (loop && reload) arm(this, due_us + span_us(reload));
+    if (isr) isr();
+  }
+};
+static Timer1 _timer1;
+
+} // namespace hal
+
+void timer1_isr_init() {}
+void timer1_attachInterrupt(timercallback userFunc) { hal::_timer1.isr = userFunc; }
+void timer1_detachInterrupt() { hal::_timer1.isr = nullptr; }
+
+void timer1_enable(uint8_t divider, uint8_t int_type, uint8_t reload) {
+  (void)int_type;
+  static const uint32_t div[] = { 1, 16, 16, 256 };
+  hal::_timer1.divider = div[divider & 3];
+  hal::_timer1.loop = reload == TIM_LOOP;
+  hal::_timer1.enabled = true;
+}
+
+void timer1_disable() {
+  hal::_timer1.enabled = false;
+  hal::disarm(&hal::_timer1);
+}
+
+void timer1_write(uint32_t ticks) {
+  if (!hal::_timer1.enabled) return;
+  hal::_timer1.reload = ticks;
+  hal::arm(&hal::_timer1, hal::now_us() + hal::_timer1.span_us(ticks ? ticks : 1));
+}
+
+// ---- Serial ----
+
+size_t Print::write(const uint8_t *buf, size_t len) {
+  size_t n = 0;
+  while (len--) n += write(*buf++);
+  return n;
+}
+
+size_t Print::printf(const char *fmt, ...) {
+  char buf[512];
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+  if (n < 0) return 0;
+  return write((const uint8_t *)buf, (size_t)n < sizeof(buf) ? n : sizeof(buf) - 1);
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  if (!hal::quiet) fputc(c, stdout);
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buf, size_t len) {
+  if (!hal::quiet) fwrite(buf, 1, len, stdout);
+  return len;
+}
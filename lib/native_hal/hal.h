@@ -0,0 +1,58 @@
+#ifndef NATIVE_HAL_H
+#define NATIVE_HAL_H
+/*
+ * Host-side control of the simulated board: virtual clock, timers, GPIO
+ * levels and hooks for plant models. Firmware code never includes this
+ * directly ; simulators and the native driver do.
+ */
+#include <stdint.h>
+#include <functional>
+#include <string>
+
+namespace hal {
+  // ---- virtual clock ----
+  uint64_t now_us();                 // virtual time since boot
+  void advance_us(uint64_t us);      // move forward, firing timers and hooks on the way
+  inline void advance(unsigned long ms) { advance_us((uint64_t)ms * 1000); }
+
+  // ---- timers (Ticker, hardware timer) ----
+  struct Timer {
+    uint64_t due_us = 0;
+    bool armed = false;
+    virtual ~Timer();
+    virtual void fire() = 0;        // called with the clock set to due_us
+  };
+  void arm(Timer *t, uint64_t due_us);
+  void disarm(Timer *t);
+
+  // called with the time span covered by each clock step, for plant integration
+  typedef std::function<void(uint64_t now_us, uint64_t dt_us)> AdvanceHook;
+  void onAdvance(AdvanceHook hook);
+
+  // ---- GPIO ----
+  int pinLevel(uint8_t pin);                    // level as the board sees it
+  uint8_t pinModeOf(uint8_t pin);
+  void setInput(uint8_t pin, int level);        // drive an input from outside (fires attached ISRs)
+  typedef std::function<void(uint8_t pin, int level)> WriteHook;
+  void onDigitalWrite(WriteHook hook);
+  typedef std::function<int(uint8_t pin)> AnalogSource;
+  void setAnalogSource(AnalogSource source);
+  bool interruptsEnabled();
+
+  // ---- native driver (native_main.cpp) ----
+  extern bool quiet;                 // silence Serial/websocket echo on stdout
+  extern std::string fsRoot;         // host directory backing LittleFS
+  extern long fsSpace;               // bytes file writes may still add, then they come up short ; -1: no limit
+
+  // simulators register these from static constructors, before run()
+  typedef std::function<bool(const char *value)> OptionFn;
+  void addOption(const char *name, const char *help, OptionFn fn);
+  void onPowerUp(std::function<void()> fn);     // right before setup()
+  void onBoot(std::function<void()> fn);        // right after setup()
+  void onExit(std::function<void()> fn);        // when the run ends
+
+  int run(int argc, char **argv);    // setup(), then loop() on the virtual clock
+  void stop();                       // end the run after the current loop()
+}
+
+#endif
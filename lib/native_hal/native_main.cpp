@@ -0,0 +1,149 @@
+/*
+ * Native driver: boots the firmware on the virtual clock and keeps calling
+ * loop(), paced at --speed times real time (1000x by default, 0 = flat out).
+ *
+ *   program [--speed N] [--duration S] [--fs DIR] [--quiet] [--sensor CELSIUS]
+ *           [--input [T@]PIN=LEVEL] [--get [T@]URL] [--ws [T@]MESSAGE] [--ws-stall [T@]0|1]
+ *
+ * Each --sensor plugs a DS18B20 on the 1-wire bus before setup(). T is a
+ * virtual time in seconds ; without it the action happens right after
+ * setup(). --ws messages come from a console websocket client that is
+ * connected at boot and echoes every frame it receives ; --ws-stall 1 makes its
+ * link stop acknowledging (frames stay queued) until --ws-stall 0.
+ */
+#include "Arduino.h"
+#include "ESPAsyncWebServer.h"
+#include "OneWire.h"
+#include <stdio.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+namespace hal {
+
+struct Option {
+  std::string name, help;
+  OptionFn fn;
+};
+
+struct Action {
+  uint64_t at_us;
+  char kind;          // 'i'nput, 'g'et, 'w'ebsocket, 's'tall
+  std::string arg;
+};
+
+static std::vector<Option> &_options() { static std::vector<Option> o; return o; }
+static std::vector<std::function<void()>> &_powerUpHooks() { static std::vector<std::function<void()>> h; return h; }
+static std::vector<std::function<void()>> &_bootHooks() { static std::vector<std::function<void()>> h; return h; }
+static std::vector<std::function<void()>> &_exitHooks() { static std::vector<std::function<void()>> h; return h; }
+static bool _stop = false;
+
+void addOption(const char *name, const char *help, OptionFn fn) { _options().push_back({ name, help, fn }); }
+void onPowerUp(std::function<void()> fn) { _powerUpHooks().push_back(fn); }
+void onBoot(std::function<void()> fn) { _bootHooks().push_back(fn); }
+void onExit(std::function<void()> fn) { _exitHooks().push_back(fn); }
+void stop() { _stop = true; }
+
+static void _usage(const char *prog) {
+  fprintf(stderr, "usage: %s [--speed N] [--duration S] [--fs DIR] [--quiet] [--sensor CELSIUS]\n"
+                  "          [--input [T@]PIN=LEVEL] [--get [T@]URL] [--ws [T@]MESSAGE] [--ws-stall [T@]0|1]\n", prog);
+  for (auto &o : _options()) fprintf(stderr, "  --%-18s %s\n", o.name.c_str(), o.help.c_str());
+}
+
+static Action _action(char kind, const char *arg) {
+  Action a = { 0, kind, arg };
+  size_t at = a.arg.find('@');
+  if (at != std::string::npos && at > 0 && a.arg.find_first_not_of("0123456789.") >= at) {
+    a.at_us = (uint64_t)(atof(a.arg.substr(0, at).c_str()) * 1e6);
+    a.arg = a.arg.substr(at + 1);
+  }
+  return a;
+}
+
+static uint64_t _realNow_us() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int run(int argc, char **argv) {
+  double speed = 1000;
+  double duration = 0;
+  std::vector<Action> actions;
+
+  for (int i = 1; i < argc; i++) {
+    std::string opt = argv[i];
+    if (opt == "--quiet") { quiet = true; continue; }
+    if (opt.compare(0, 2, "--") || i + 1 >= argc) { _usage(argv[0]); return 2; }
+    const char *val = argv[++i];
+    opt = opt.substr(2);
+
+    if (opt == "speed") speed = atof(val);
+    else if (opt == "duration") duration = atof(val);
+    else if (opt == "fs") fsRoot = val;
+    else if (opt == "sensor" && OneWire::instance()) OneWire::instance()->attach((float)atof(val));
+    else if (opt == "input") actions.push_back(_action('i', val));
+    else if (opt == "get") actions.push_back(_action('g', val));
+    else if (opt == "ws") actions.push_back(_action('w', val));
+    else if (opt == "ws-stall") actions.push_back(_action('s', val));
+    else {
+      auto o = std::find_if(_options().begin(), _options().end(), [&](const Option &o) { return o.name == opt; });
+      if (o == _options().end() || !o->fn(val)) { _usage(argv[0]); return 2; }
+    }
+  }
+  std::stable_sort(actions.begin(), actions.end(), [](const Action &a, const Action &b) { return a.at_us < b.at_us; });
+
+  for (auto &h : _powerUpHooks()) h();
+  setup();
+  for (auto &h : _bootHooks()) h();
+
+  AsyncWebServer *server = AsyncWebServer::instance();
+  AsyncWebSocket *ws = server ? server->websocket() : nullptr;
+  AsyncWebSocketClient *console = ws ? ws->connect() : nullptr;
+
+  uint64_t boot_us = now_us();
+  uint64_t end_us = duration > 0 ? boot_us + (uint64_t)(duration * 1e6) : 0;
+  uint64_t realStart_us = _realNow_us();
+  size_t next = 0;
+
+  while (!_stop && (!end_us || now_us() < end_us)) {
+    for (; next < actions.size() && actions[next].at_us <= now_us() - boot_us; next++) {
+      const Action &a = actions[next];
+      if (a.kind == 'i') {
+        size_t eq = a.arg.find('=');
+        if (eq != std::string::npos) setInput((uint8_t)atoi(a.arg.c_str()), atoi(a.arg.c_str() + eq + 1));
+      } else if (a.kind == 'g' && server) {
+        server->handle(a.arg.c_str());
+      } else if (a.kind == 'w' && ws) {
+        ws->receive(console, a.arg.c_str());
+      } else if (a.kind == 's' && console) {
+        console->stall(atoi(a.arg.c_str()) != 0);
+      }
+    }
+
+    uint64_t before = now_us();
+    loop();
+    if (now_us() == before) advance(1);   // loop() did not sleep: account for its own run time
+
+    if (speed > 0) {
+      // keep virtual time at `speed` times real time
+      uint64_t due_us = realStart_us + (uint64_t)((now_us() - boot_us) / speed);
+      uint64_t real_us = _realNow_us();
+      if (due_us > real_us + 1000) {
+        struct timespec ts = { (time_t)((due_us - real_us) / 1000000), (long)((due_us - real_us) % 1000000) * 1000 };
+        nanosleep(&ts, nullptr);
+      }
+    }
+  }
+
+  for (auto &h : _exitHooks()) h();
+  fflush(stdout);
+  return 0;
+}
+
+} // namespace hal
+
+int main(int argc, char **argv) {
+  return hal::run(argc, argv);
+}
@@ -0,0 +1,91 @@
+/*
+ * The PS-VM-RD front end (src/psvmrd.h): a 74HCT595 decoded from its pins
+ * drives two 4051 muxes, MUX2 through MUX1 channel 4, into A0. Each channel
+ * carries a mains sine through the board's divider.
+ *
+ *   --voltage CH:V     V volts RMS on channel CH (0..7 MUX1, 8..15 MUX2), repeatable
+ *   --voltage-hz HZ    their frequency (default 50)
+ *   --adclog 1         at exit, print ADC reads, shift register latches, and reads
+ *                      taken before the muxes settled (these return the previous channel)
+ */
+#include <Arduino.h>
+#include <math.h>
+#include <stdio.h>
+
+namespace {
+
+const uint8_t SCLK_PIN = D5, SDI_PIN = D7, LATCH_PIN = D8;
+const uint8_t ROUTE = 4;                   // MUX1 channel fed by MUX2
+const double VOLTS_PER_ADC_VOLT = 875;     // divider: 1 V full scale at A0
+const uint64_t SETTLE_US = 2;
+
+struct MuxAdc {
+  bool enabled = false, log = false;
+  double rms[16] = {};
+  double hz = 50;
+
+  uint8_t shift = 0, latched = 0, previous = 0;
+  uint64_t latchedAt = 0;
+  unsigned long reads = 0, latches = 0, unsettled = 0;
+
+  static int channelOf(uint8_t state) {
+    return (state & 7) == ROUTE ? 8 + (state >> 3 & 7) : state & 7;
+  }
+
+  int read() {
+    reads++;
+    uint8_t state = latched;
+    if (hal::now_us() - latchedAt < SETTLE_US) {
+      unsettled++;
+      state = previous;
+    }
+    double v = rms[channelOf(state)] * M_SQRT2 * sin(2 * M_PI * hz * hal::now_us() * 1e-6);
+    long raw = lround(512 + v / VOLTS_PER_ADC_VOLT * 1023);
+    return raw < 0 ? 0 : raw > 1023 ? 1023 : (int)raw;
+  }
+
+  void write(uint8_t pin, int level) {
+    if (level != HIGH) return;
+    if (pin == SCLK_PIN) {
+      shift = shift << 1 | (hal::pinLevel(SDI_PIN) ? 1 : 0);
+    } else if (pin == LATCH_PIN) {
+      previous = latched;
+      latched = shift;
+      latchedAt = hal::now_us();
+      latches++;
+    }
+  }
+} adc;
+
+struct Registration {
+  Registration() {
+    hal::addOption("voltage", "CH:V volts RMS on a PS-VM-RD mux channel, repeatable", [](const char *v) {
+      const char *colon = strchr(v, ':');
+      int ch = atoi(v);
+      if (!colon || ch < 0 || ch > 15) return false;
+      adc.rms[ch] = atof(colon + 1);
+      adc.enabled = true;
+      return true;
+    });
+    hal::addOption("voltage-hz", "HZ frequency of the --voltage sines", [](const char *v) {
+      adc.hz = atof(v);
+      return adc.hz > 0;
+    });
+    hal::addOption("adclog", "1 to print ADC and mux statistics at exit", [](const char *v) {
+      adc.log = adc.enabled = atoi(v) != 0;
+      return true;
+    });
+
+    hal::onPowerUp([]() {
+      if (!adc.enabled) return;
+      hal::setAnalogSource([](uint8_t) { return adc.read(); });
+      hal::onDigitalWrite([](uint8_t pin, int level) { adc.write(pin, level); });
+    });
+
+    hal::onExit([]() {
+      if (adc.log) printf("adc reads=%lu latches=%lu unsettled=%lu\n", adc.reads, adc.latches, adc.unsettled);
+    });
+  }
+} registration;
+
+} // namespace
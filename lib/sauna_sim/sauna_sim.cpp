@@ -0,0 +1,346 @@
+/*
+ * Closes the loop between the native firmware and ThermalPlant: the relay
+ * pins energize heater elements, the door switch pin opens the door path, and
+ * the two simulated DS18B20s read the process probe and ambiant.
+ *
+ *   --plant 1          enable the model (plugs both sensors on the bus)
+ *   --heater PIN:W     element wiring, repeatable (default D3:1500, 1:3000, 3:1500)
+ *   --ambiant C        room temperature (default 20)
+ *   --setpoint C       applied after setup()
+ *   --gains KP:KI:KD   applied after setup()
+ *   --band C           settling band for the step metrics (default 1)
+ *   --trace S          print the plant state every S virtual seconds
+ *   --mains HZ         zero-crossing pulses on D6 (SMOOTH_TRIAC) ; elements then
+ *                      conduct from their gate edge to the next zero, for the
+ *                      sin^2 share of power that phase angle carries
+ *   --gatelog N        print the first N gate edges with their delay after the zero
+ *   --door T@open      door switch edge at virtual second T (open or closed), repeatable ;
+ *                      each opening prints how long the heaters took to go off
+ *                      ("-" if they were off, "never" if still on at exit)
+ *   --bounce N         N contact bounces (2N more edges, 300 us apart) after each --door
+ *
+ * At exit a single "bench ..." line reports the step response as seen by the
+ * process probe: rise time (10-90 %), overshoot, settling time, ripple over
+ * the last half hour, and energy used to first reach the setpoint.
+ */
+#include <Arduino.h>
+#include <OneWire.h>
+#include <PID_v1.h>
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+#include "thermal_plant.h"
+
+// firmware state (src/main.cpp)
+extern double Setpoint, Kp, Ki, Kd;
+extern PID myPID;
+
+namespace {
+
+const int RELAY_CLOSED_LEVEL = LOW;   // relays are active low, see RELAY_CLOSED
+const uint8_t DOOR_PIN = D4;          // DOOR_SW, high when open
+const uint8_t ZERO_CROSS_PIN = D6;    // ZERO_CROSS
+
+struct Heater {
+  uint8_t pin;
+  double watts;
+};
+
+struct Sim {
+  bool enabled = false;
+  ThermalPlant plant;
+  std::vector<Heater> heaters = { { D3, 1500 }, { 1, 3000 }, { 3, 1500 } };
+  bool defaultHeaters = true;
+
+  bool setSetpoint = false, setGains = false;
+  double setpoint = 0, kp = 0, ki = 0, kd = 0;
+  double band = 1.0;
+  double trace = 0;
+
+  FakeDS18B20 *probe = nullptr, *room = nullptr;
+
+  // mains: half-cycles start on a timer, elements latch until the next zero
+  struct ZeroCross : hal::Timer {
+    void fire() override;
+  } zeroCross;
+  double mainsHz = 0;
+  uint64_t halfCycle_us = 0, lastZero_us = 0;
+  bool conducting[ThermalPlant::MAX_HEATERS] = {};
+  long gateLog = 0;
+
+  // door switch edges at exact times, bounces included
+  struct DoorEdges : hal::Timer {
+    struct Edge {
+      uint64_t at_us;
+      int level;
+      bool first;           // the edge itself, not a bounce
+    };
+    std::vector<Edge> edges;    // after boot
+    uint64_t boot_us = 0;
+    size_t next = 0;
+    void fire() override;
+  } door;
+  int bounces = 0;
+  bool doorWaiting = false;     // opened with heaters on, not yet off
+  uint64_t doorOpened_us = 0;
+  void checkDoor();
+
+  // step response bookkeeping, one sample per virtual second
+  uint64_t boot_us = 0;
+  double carry = 0;             // seconds not yet sampled
+  double nextTrace = 0;
+  std::vector<float> samples;
+  double energyAtSetpoint = -1;
+
+  void advance(uint64_t now_us, uint64_t dt_us);
+  void report();
+} sim;
+
+bool energized(const Heater &h) {
+  return hal::pinModeOf(h.pin) == OUTPUT && hal::pinLevel(h.pin) == RELAY_CLOSED_LEVEL;
+}
+
+void Sim::ZeroCross::fire() {
+  sim.lastZero_us = due_us;
+  hal::arm(this, due_us + sim.halfCycle_us);
+  // whatever holds its gate keeps conducting, the rest turned off at the zero
+  for (size_t i = 0; i < sim.heaters.size(); i++) sim.conducting[i] = energized(sim.heaters[i]);
+  sim.checkDoor();
+  hal::setInput(ZERO_CROSS_PIN, LOW);
+  hal::setInput(ZERO_CROSS_PIN, HIGH);
+}
+
+// anything still heating: with mains, a TRIAC conducts until the next zero
+bool heating() {
+  for (size_t i = 0; i < sim.heaters.size(); i++) {
+    if (sim.mainsHz > 0 ? sim.conducting[i] : energized(sim.heaters[i])) return true;
+  }
+  return false;
+}
+
+void Sim::checkDoor() {
+  if (!doorWaiting || heating()) return;
+  doorWaiting = false;
+  printf("door t=%.6f open heaters_off_us=%llu\n", (doorOpened_us - door.boot_us) * 1e-6,
+         (unsigned long long)(hal::now_us() - doorOpened_us));
+}
+
+void Sim::DoorEdges::fire() {
+  const Edge &e = edges[next++];
+  if (e.first && e.level == HIGH) {
+    if (heating()) {
+      sim.doorWaiting = true;
+      sim.doorOpened_us = hal::now_us();
+    } else {
+      printf("door t=%.6f open heaters_off_us=-\n", (hal::now_us() - sim.door.boot_us) * 1e-6);
+    }
+  }
+  hal::setInput(DOOR_PIN, e.level);    // the ISR runs now, as on the board
+  if (next < edges.size()) hal::arm(this, boot_us + edges[next].at_us);
+}
+
+// mean of 2 sin^2 over the phase span [a, b] of a half-cycle: the power share it carries
+double mainsShare(double a, double b) {
+  if (b - a < 1e-9) return 1;
+  return 1 - (sin(2 * b) - sin(2 * a)) / (2 * (b - a));
+}
+
+void Sim::advance(uint64_t now_us, uint64_t dt_us) {
+  double on[ThermalPlant::MAX_HEATERS] = {};
+  double share = 1;
+  if (mainsHz > 0) {
+    // clock steps are split at every zero crossing, so the span is inside one half-cycle
+    double b = M_PI * (now_us - lastZero_us) / halfCycle_us;
+    double a = b - M_PI * dt_us / halfCycle_us;
+    share = mainsShare(a < 0 ? 0 : a, b);
+  }
+  for (size_t i = 0; i < heaters.size(); i++) {
+    bool conducts = mainsHz > 0 ? conducting[i] : energized(heaters[i]);
+    on[i] = conducts ? share : 0;
+  }
+
+  double dt = dt_us * 1e-6;
+  plant.step(dt, on, hal::pinLevel(DOOR_PIN) == HIGH);
+  probe->temperature = (float)plant.sensor();
+  room->temperature = (float)plant.ambiant();
+
+  if (!boot_us) return;     // setup() still running
+  double t = (now_us - boot_us) * 1e-6;
+
+  if (energyAtSetpoint < 0 && plant.sensor() >= Setpoint) energyAtSetpoint = plant.energy();
+  for (carry += dt; carry >= 1.0; carry -= 1.0) samples.push_back((float)plant.sensor());
+
+  if (trace > 0 && t >= nextTrace) {
+    printf("plant t=%.0f probe=%.2f air=%.2f stones=%.2f walls=%.2f power=%.0f door=%d\n",
+           t, plant.sensor(), plant.air(), plant.stones(), plant.walls(), plant.power(),
+           hal::pinLevel(DOOR_PIN) == HIGH);
+    nextTrace += trace;
+  }
+}
+
+void Sim::report() {
+  double sp = Setpoint;
+  size_t n = samples.size();
+  if (!n) return;
+  double t0 = samples[0];
+
+  // 10-90 % rise time
+  long t10 = -1, t90 = -1;
+  for (size_t i = 0; i < n; i++) {
+    if (t10 < 0 && samples[i] >= t0 + 0.1 * (sp - t0)) t10 = i;
+    if (t90 < 0 && samples[i] >= t0 + 0.9 * (sp - t0)) { t90 = i; break; }
+  }
+
+  // overshoot, once the setpoint was reached
+  long reached = -1;
+  double peak = -1e9;
+  for (size_t i = 0; i < n; i++) {
+    if (reached < 0 && samples[i] >= sp) reached = i;
+    if (reached >= 0 && samples[i] > peak) peak = samples[i];
+  }
+
+  // settling: from the last sample outside the band on
+  long lastOut = -1;
+  for (size_t i = 0; i < n; i++) {
+    if (fabs(samples[i] - sp) > band) lastOut = i;
+  }
+  long settling = lastOut + 1 < (long)n ? lastOut + 1 : -1;
+
+  // ripple: peak-to-peak over the last 30 min (or last quarter of a shorter run)
+  size_t window = n / 4 < 1800 ? n / 4 : 1800;
+  if (!window) window = n;
+  float lo = samples[n - window], hi = lo;
+  for (size_t i = n - window; i < n; i++) {
+    if (samples[i] < lo) lo = samples[i];
+    if (samples[i] > hi) hi = samples[i];
+  }
+
+  printf("bench setpoint=%.1f kp=%g ki=%g kd=%g", sp, myPID.GetKp(), myPID.GetKi(), myPID.GetKd());
+  if (t10 >= 0 && t90 >= 0) printf(" rise_s=%ld", t90 - t10); else printf(" rise_s=-");
+  if (reached >= 0) printf(" overshoot_c=%.2f", peak - sp); else printf(" overshoot_c=-");
+  if (settling >= 0) printf(" settling_s=%ld", settling); else printf(" settling_s=-");
+  printf(" ripple_c=%.2f", hi - lo);
+  if (energyAtSetpoint >= 0) printf(" kwh_to_setpoint=%.3f", energyAtSetpoint / 3.6e6); else printf(" kwh_to_setpoint=-");
+  printf(" kwh_total=%.3f duration_s=%lu\n", plant.energy() / 3.6e6, (unsigned long)n);
+}
+
+bool parseFlag(const char *v) { return atoi(v) != 0; }
+
+struct Registration {
+  Registration() {
+    hal::addOption("plant", "1 to simulate the cabin (plugs both sensors)", [](const char *v) {
+      sim.enabled = parseFlag(v);
+      return true;
+    });
+    hal::addOption("heater", "PIN:WATTS heater element on a relay pin, repeatable", [](const char *v) {
+      const char *colon = strchr(v, ':');
+      if (!colon) return false;
+      if (sim.defaultHeaters) { sim.heaters.clear(); sim.defaultHeaters = false; }
+      if (sim.heaters.size() >= ThermalPlant::MAX_HEATERS) return false;
+      sim.heaters.push_back({ (uint8_t)atoi(v), atof(colon + 1) });
+      return true;
+    });
+    hal::addOption("ambiant", "C room temperature", [](const char *v) {
+      sim.plant.params().ambiant = atof(v);
+      return true;
+    });
+    hal::addOption("setpoint", "C target temperature", [](const char *v) {
+      sim.setSetpoint = true;
+      sim.setpoint = atof(v);
+      return true;
+    });
+    hal::addOption("gains", "KP:KI:KD PID tunings", [](const char *v) {
+      sim.setGains = sscanf(v, "%lf:%lf:%lf", &sim.kp, &sim.ki, &sim.kd) == 3;
+      return sim.setGains;
+    });
+    hal::addOption("band", "C settling band", [](const char *v) {
+      sim.band = atof(v);
+      return sim.band > 0;
+    });
+    hal::addOption("trace", "S print the plant state every S seconds", [](const char *v) {
+      sim.trace = atof(v);
+      return true;
+    });
+    hal::addOption("mains", "HZ simulate the mains and its zero-crossing detector", [](const char *v) {
+      sim.mainsHz = atof(v);
+      return sim.mainsHz >= 0;
+    });
+    hal::addOption("gatelog", "N print the first N gate edges", [](const char *v) {
+      sim.gateLog = atol(v);
+      return true;
+    });
+    hal::addOption("door", "T@open|closed door switch edge at virtual second T, repeatable", [](const char *v) {
+      const char *at = strchr(v, '@');
+      if (!at || (strcmp(at + 1, "open") && strcmp(at + 1, "closed"))) return false;
+      sim.door.edges.push_back({ (uint64_t)(atof(v) * 1e6), strcmp(at + 1, "open") ? LOW : HIGH, true });
+      return true;
+    });
+    hal::addOption("bounce", "N contact bounces after each --door edge", [](const char *v) {
+      sim.bounces = atoi(v);
+      return sim.bounces >= 0;
+    });
+
+    hal::onPowerUp([]() {
+      if (!sim.enabled) return;
+      OneWire *bus = OneWire::instance();
+      if (!bus) return;
+      sim.plant.reset();
+      for (size_t i = 0; i < sim.heaters.size(); i++) sim.plant.setHeater(i, sim.heaters[i].watts);
+      sim.probe = bus->attach((float)sim.plant.sensor());   // sensor0: process
+      sim.room = bus->attach((float)sim.plant.ambiant());   // sensor1: ambiant
+      hal::onAdvance([](uint64_t now_us, uint64_t dt_us) { sim.advance(now_us, dt_us); });
+
+      if (sim.mainsHz > 0) {
+        sim.halfCycle_us = (uint64_t)(5e5 / sim.mainsHz + .5);
+        sim.lastZero_us = hal::now_us();
+        hal::arm(&sim.zeroCross, sim.lastZero_us + sim.halfCycle_us);
+        hal::onDigitalWrite([](uint8_t pin, int level) {
+          for (size_t i = 0; i < sim.heaters.size(); i++) {
+            if (sim.heaters[i].pin != pin || level != RELAY_CLOSED_LEVEL) continue;
+            sim.conducting[i] = true;     // a gate edge latches the element until the next zero
+            if (sim.gateLog > 0) {
+              sim.gateLog--;
+              printf("gate t=%.6f pin=%u after_zero_us=%llu\n", hal::now_us() * 1e-6, (unsigned)pin,
+                     (unsigned long long)(hal::now_us() - sim.lastZero_us));
+            }
+          }
+        });
+      }
+    });
+
+    hal::onBoot([]() {
+      if (!sim.door.edges.empty()) {
+        // each edge followed by its bounces
+        std::vector<Sim::DoorEdges::Edge> all;
+        std::stable_sort(sim.door.edges.begin(), sim.door.edges.end(),
+                         [](const Sim::DoorEdges::Edge &a, const Sim::DoorEdges::Edge &b) { return a.at_us < b.at_us; });
+        for (const auto &e : sim.door.edges) {
+          all.push_back(e);
+          for (int k = 1; k <= 2 * sim.bounces; k++) {
+            all.push_back({ all.back().at_us + 300, k % 2 ? !e.level : e.level, false });
+          }
+        }
+        sim.door.edges = all;
+        sim.door.boot_us = hal::now_us();
+        hal::arm(&sim.door, sim.door.boot_us + all[0].at_us);
+        hal::onDigitalWrite([](uint8_t, int) { sim.checkDoor(); });
+      }
+
+      if (!sim.probe) return;
+      if (sim.setSetpoint) Setpoint = sim.setpoint;
+      if (sim.setGains) {
+        Kp = sim.kp; Ki = sim.ki; Kd = sim.kd;
+        myPID.SetTunings(Kp, Ki, Kd);
+      }
+      sim.boot_us = hal::now_us();
+    });
+
+    hal::onExit([]() {
+      if (sim.doorWaiting) printf("door t=%.6f open heaters_off_us=never\n", (sim.doorOpened_us - sim.door.boot_us) * 1e-6);
+      if (sim.probe) sim.report();
+    });
+  }
+} registration;
+
+} // namespace
@@ -0,0 +1,59 @@
+#include "thermal_plant.h"
+
+ThermalPlant::ThermalPlant() : ThermalPlant(Params()) {}
+
+ThermalPlant::ThermalPlant(const Params &p) : _p(p), _heaters(0) {
+  for (size_t i = 0; i < MAX_HEATERS; i++) _watts[i] = 0;
+  reset();
+}
+
+void ThermalPlant::reset() {
+  for (size_t i = 0; i < MAX_HEATERS; i++) _tHeater[i] = _p.ambiant;
+  _tStones = _tAir = _tWalls = _tSensor = _p.ambiant;
+  _power = _energy = 0;
+}
+
+void ThermalPlant::setHeater(size_t i, double watts) {
+  if (i >= MAX_HEATERS) return;
+  _watts[i] = watts;
+  if (i >= _heaters) _heaters = i + 1;
+}
+
+void ThermalPlant::step(double dt, const double *level, bool doorOpen) {
+  // heater elements have the shortest time constant (~15 s) ; 0.1 s keeps Euler well inside stability
+  const double maxStep = 0.1;
+  _power = 0;
+  while (dt > 0) {
+    double h = dt < maxStep ? dt : maxStep;
+    _euler(h, level, doorOpen);
+    dt -= h;
+  }
+}
+
+void ThermalPlant::_euler(double dt, const double *level, bool doorOpen) {
+  double qStones = 0, qAir = 0;
+  double power = 0;
+
+  for (size_t i = 0; i < _heaters; i++) {
+    double p = level[i] * _watts[i];
+    double toStones = _p.gHeaterStones * (_tHeater[i] - _tStones);
+    double toAir = _p.gHeaterAir * (_tHeater[i] - _tAir);
+    _tHeater[i] += dt * (p - toStones - toAir) / _p.cHeater;
+    qStones += toStones;
+    qAir += toAir;
+    power += p;
+  }
+
+  double stonesToAir = _p.gStonesAir * (_tStones - _tAir);
+  double airToWalls = _p.gAirWalls * (_tAir - _tWalls);
+  double airToAmbiant = (_p.gAirAmbiant + (doorOpen ? _p.gDoorOpen : 0)) * (_tAir - _p.ambiant);
+  double wallsToAmbiant = _p.gWallsAmbiant * (_tWalls - _p.ambiant);
+
+  _tStones += dt * (qStones - stonesToAir) / _p.cStones;
+  _tAir += dt * (qAir + stonesToAir - airToWalls - airToAmbiant) / _p.cAir;
+  _tWalls += dt * (airToWalls - wallsToAmbiant) / _p.cWalls;
+  _tSensor += dt * (_tAir - _tSensor) / _p.sensorTau;
+
+  _power = power;
+  _energy += power * dt;
+}
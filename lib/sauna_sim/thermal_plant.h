@@ -0,0 +1,70 @@
+#ifndef THERMAL_PLANT_H
+#define THERMAL_PLANT_H
+/*
+ * Lumped-parameter thermal model of a sauna cabin.
+ *
+ * Nodes: one per heater element, the stones, the air and the walls ; ambiant
+ * is a fixed boundary. Heat flows through conductances between them, the door
+ * adds an extra air-to-ambiant path while open, and the process sensor sees
+ * the air through its own first-order lag. Integrated with explicit Euler in
+ * sub-steps short enough for the smallest time constant.
+ */
+#include <stddef.h>
+
+class ThermalPlant {
+  public:
+    static constexpr size_t MAX_HEATERS = 9;
+
+    struct Params {
+      // heat capacities [J/K]
+      double cHeater = 1500;    // per element (steel sheath + fins)
+      double cStones = 16000;   // ~20 kg of peridotite
+      double cAir = 9600;       // ~8 m3 of air
+      double cWalls = 90000;    // inner wood paneling that takes part in the transient
+
+      // conductances [W/K]
+      double gHeaterStones = 60;
+      double gHeaterAir = 30;
+      double gStonesAir = 40;
+      double gAirWalls = 60;
+      double gWallsAmbiant = 8;
+      double gAirAmbiant = 10;  // ventilation and leaks
+      double gDoorOpen = 150;   // extra while the door is open
+
+      double sensorTau = 30;    // [s] probe lag to air temperature
+      double ambiant = 20;      // [°C]
+    };
+
+    ThermalPlant();
+    explicit ThermalPlant(const Params &p);
+
+    void reset();             // everything at ambiant temperature
+    void setHeater(size_t i, double watts);    // rated power of element i (0 = absent)
+    size_t heaters() const { return _heaters; }
+
+    // advance by dt seconds, each element delivering a fraction (0..1) of its rated power
+    void step(double dt, const double *level, bool doorOpen);
+
+    double air() const { return _tAir; }
+    double stones() const { return _tStones; }
+    double walls() const { return _tWalls; }
+    double heater(size_t i) const { return _tHeater[i]; }
+    double sensor() const { return _tSensor; }
+    double ambiant() const { return _p.ambiant; }
+    double power() const { return _power; }          // [W] delivered during the last step
+    double energy() const { return _energy; }        // [J] since reset()
+
+    Params &params() { return _p; }
+
+  private:
+    Params _p;
+    size_t _heaters;
+    double _watts[MAX_HEATERS];
+    double _tHeater[MAX_HEATERS];
+    double _tStones, _tAir, _tWalls, _tSensor;
+    double _power, _energy;
+
+    void _euler(double dt, const double *level, bool doorOpen);
+};
+
+#endif
@@ -0,0 +1,63 @@
+#include "assets.h"
+
+static const char CACHE_IMMUTABLE[] = "public, max-age=31536000, immutable";
+static const char CACHE_REVALIDATE[] = "no-cache";
+
+size_t AssetHandler::begin(const char *manifest) {
+  _count = 0;
+  File f = _fs.open(manifest, "r");
+  if (!f) return 0;
+  String text = f.readString();
+  f.close();
+
+  int start = 0;
+  while (start < (int)text.length() && _count < MAX_ASSETS) {
+    int end = text.indexOf('\n', start);
+    if (end < 0) end = text.length();
+    int s1 = text.indexOf(' ', start);
+    int s2 = s1 < 0 ? -1 : text.indexOf(' ', s1 + 1);
+    int s3 = s2 < 0 ? -1 : text.indexOf(' ', s2 + 1);
+    if (s3 > 0 && s3 < end) {
+      Asset &a = _assets[_count++];
+      a.path = text.substring(start, s1);
+      a.etag = text.substring(s1 + 1, s2);
+      a.type = text.substring(s2 + 1, s3);
+      a.immutable = text.substring(s3 + 1, end) == "immutable";
+    }
+    start = end + 1;
+  }
+  return _count;
+}
+
+const AssetHandler::Asset *AssetHandler::_find(const String &url) const {
+  const char *path = url == "/" ? "/index.html" : url.c_str();
+  for (size_t i = 0; i < _count; i++) {
+    if (_assets[i].path == path) return &_assets[i];
+  }
+  return nullptr;
+}
+
+bool AssetHandler::canHandle(AsyncWebServerRequest *request) {
+  if (!(request->method() & (HTTP_GET | HTTP_HEAD)) || !_find(request->url())) return false;
+  request->addInterestingHeader("If-None-Match");   // the library drops the other headers
+  return true;
+}
+
+void AssetHandler::handleRequest(AsyncWebServerRequest *request) {
+  const Asset *a = _find(request->url());
+  if (!a) {
+    request->send(404);
+    return;
+  }
+
+  AsyncWebServerResponse *response;
+  AsyncWebHeader *match = request->getHeader("If-None-Match");
+  if (match && match->value().indexOf(a->etag) >= 0) {   // also W/"..." and lists
+    response = request->beginResponse(304);
+  } else {
+    response = request->beginResponse(_fs, a->path, a->type);
+  }
+  response->addHeader("ETag", a->etag);
+  response->addHeader("Cache-Control", a->immutable ? CACHE_IMMUTABLE : CACHE_REVALIDATE);
+  request->send(response);
+}
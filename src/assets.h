@@ -0,0 +1,48 @@
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <ESPAsyncWebServer.h>
+
+/*
+ * Web UI files listed in /assets.txt, which tools/build_assets.py writes next
+ * to them in the LittleFS image, served with their content hash as ETag:
+ *
+ *   immutable    hashed names (app.<hash>.js, images): cached for a year and
+ *                never asked for again, a new build links new names
+ *   revalidate   index.html and files kept under their own name: the browser
+ *                asks each time and a matching If-None-Match gets an empty 304
+ *
+ * A file stored as <path>.gz goes out with Content-Encoding: gzip (the library
+ * picks it). Anything not listed falls through to the next handler.
+ *
+ *   manifest line   <url> "<etag>" <content type> <immutable|revalidate>
+ */
+class AssetHandler : public AsyncWebHandler {
+  public:
+    static constexpr size_t MAX_ASSETS = 24;
+
+    explicit AssetHandler(fs::FS &fs) : _fs(fs), _count(0) {}
+
+    size_t begin(const char *manifest = "/assets.txt");   // entries loaded, 0 without a manifest
+
+    bool canHandle(AsyncWebServerRequest *request) override;
+    void handleRequest(AsyncWebServerRequest *request) override;
+
+  private:
+    struct Asset {
+      String path;
+      String etag;           // quoted
+      String type;
+      bool immutable;
+    };
+
+    fs::FS &_fs;
+    Asset _assets[MAX_ASSETS];
+    size_t _count;
+
+    const Asset *_find(const String &url) const;   // "/" is /index.html
+};
+
+#endif
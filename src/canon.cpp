@@ -1,83 +1,263 @@
 #include "canon.h"
-#include <ArduinoJson.h>
-
-size_t parseQueryString(const String &qs, KV out[], size_t maxItems, String &hmacOut) {
-  hmacOut = "";
-  size_t count = 0;
-  size_t start = 0;
-  while (start < qs.length()) {
-    int amp = qs.indexOf('&', start);
-    if (amp == -1) amp = qs.length();
-    String pair = qs.substring(start, amp);
-    int eq = pair.indexOf('=');
-    if (eq >= 0) {
-      String k = pair.substring(0, eq);
-      String v = pair.substring(eq+1);
-      if (k.equalsIgnoreCase("hmac")) {
-        hmacOut = v;
-      } else if (count < maxItems) {
-        out[count].key = k;
-        out[count].val = v;
-        count++;
-      }
-    }
-    start = (amp == (int)qs.length()) ? qs.length() : amp + 1;
+
+static bool isHmac(const char *k, size_t n) {
+  return n == 4 && (k[0] | 0x20) == 'h' && (k[1] | 0x20) == 'm' && (k[2] | 0x20) == 'a' && (k[3] | 0x20) == 'c';
+}
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static long hex4(const char *p) {
+  long v = 0;
+  for (int i = 0; i < 4; i++) {
+    int d = hexValue(p[i]);
+    if (d < 0) return -1;
+    v = v << 4 | d;
   }
-  return count;
+  return v;
 }
 
-size_t parseJsonToKVs(const String &json, KV out[], size_t maxItems, String &hmacOut) {
-  hmacOut = "";
-  StaticJsonDocument<1024> doc;
-  DeserializationError err = deserializeJson(doc, json);
-  if (err) return 0;
-
-  size_t count = 0;
-  for (JsonPair kv : doc.as<JsonObject>()) {
-    String k = String(kv.key().c_str());
-    if (k.equalsIgnoreCase("hmac")) {
-      hmacOut = kv.value().as<String>();
-    } else if (count < maxItems) {
-      if (kv.value().is<bool>()) {
-        out[count].val = kv.value().as<bool>() ? "true" : "false";
-      } else if (kv.value().is<long>() || kv.value().is<int>()) {
-        out[count].val = String(kv.value().as<long>());
-      } else if (kv.value().is<float>() || kv.value().is<double>()) {
-        char buf[32];
-        snprintf(buf, sizeof(buf), "%.6g", kv.value().as<double>());
-        out[count].val = buf;
-      } else {
-        out[count].val = kv.value().as<String>();
-      }
-      out[count].key = k;
-      count++;
+// p just after the opening quote ; the closing quote, or nullptr if the string is malformed
+static const char *scanString(const char *p, const char *end, bool &escaped) {
+  escaped = false;
+  for (; p < end; p++) {
+    if (*p == '"') return p;
+    if ((uint8_t)*p < 0x20) return nullptr;
+    if (*p != '\\') continue;
+    escaped = true;
+    if (++p == end) return nullptr;
+    if (*p == 'u') {
+      if (end - p < 5 || hex4(p + 1) < 0) return nullptr;
+      p += 4;
+    } else if (!*p || !strchr("\"\\/bfnrt", *p)) {
+      return nullptr;
     }
   }
-  return count;
+  return nullptr;
+}
+
+static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+static const char *skipSpace(const char *p, const char *end) {
+  while (p < end && isSpace(*p)) p++;
+  return p;
 }
 
-void sortKVs(KV arr[], size_t n) {
-  for (size_t i=0; i<n; i++) {
-    size_t min = i;
-    for (size_t j=i+1; j<n; j++) {
-      if (arr[j].key < arr[min].key) min = j;
+size_t Canon::unescape(const char *&p, const char *end, uint8_t out[4]) {
+  if (*p != '\\') {
+    out[0] = *p++;
+    return 1;
+  }
+  p++;
+  char c = *p++;
+  switch (c) {
+    case 'b': out[0] = '\b'; return 1;
+    case 'f': out[0] = '\f'; return 1;
+    case 'n': out[0] = '\n'; return 1;
+    case 'r': out[0] = '\r'; return 1;
+    case 't': out[0] = '\t'; return 1;
+    case 'u': break;
+    default: out[0] = c; return 1;
+  }
+  uint32_t cp = hex4(p);
+  p += 4;
+  if (cp >= 0xd800 && cp < 0xdc00) {
+    long low = end - p >= 6 && p[0] == '\\' && p[1] == 'u' ? hex4(p + 2) : -1;
+    if (low >= 0xdc00 && low < 0xe000) {
+      cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+      p += 6;
+    } else {
+      cp = 0xfffd;      // lone surrogate, as TextEncoder does
     }
-    if (min != i) {
-      KV tmp = arr[i];
-      arr[i] = arr[min];
-      arr[min] = tmp;
+  } else if (cp >= 0xdc00 && cp < 0xe000) {
+    cp = 0xfffd;
+  }
+  if (cp < 0x80) {
+    out[0] = cp;
+    return 1;
+  }
+  if (cp < 0x800) {
+    out[0] = 0xc0 | cp >> 6;
+    out[1] = 0x80 | (cp & 0x3f);
+    return 2;
+  }
+  if (cp < 0x10000) {
+    out[0] = 0xe0 | cp >> 12;
+    out[1] = 0x80 | (cp >> 6 & 0x3f);
+    out[2] = 0x80 | (cp & 0x3f);
+    return 3;
+  }
+  out[0] = 0xf0 | cp >> 18;
+  out[1] = 0x80 | (cp >> 12 & 0x3f);
+  out[2] = 0x80 | (cp >> 6 & 0x3f);
+  out[3] = 0x80 | (cp & 0x3f);
+  return 4;
+}
+
+// bytes of a field as they will be written
+struct CanonCursor {
+  const char *p, *end;
+  bool escaped;
+  uint8_t pending[4];
+  size_t n = 0, i = 0;
+
+  CanonCursor(const char *p, size_t len, bool escaped) : p(p), end(p + len), escaped(escaped) {}
+
+  int next() {
+    if (i < n) return pending[i++];
+    if (p == end) return -1;
+    if (!escaped) return (uint8_t)*p++;
+    n = Canon::unescape(p, end, pending);
+    i = 1;
+    return pending[0];
+  }
+};
+
+static int compareSpans(CanonCursor a, CanonCursor b) {
+  if (!a.escaped && !b.escaped) {
+    size_t la = a.end - a.p, lb = b.end - b.p;
+    int c = memcmp(a.p, b.p, la < lb ? la : lb);
+    return c ? c : (la > lb) - (la < lb);
+  }
+  for (;;) {
+    int x = a.next(), y = b.next();
+    if (x != y || x < 0) return x - y;
+  }
+}
+
+int Canon::compare(const Field &a, const Field &b) const {
+  int c = compareSpans(CanonCursor(_buf + a.key, a.keyLen, a.flags & KEY_ESCAPED),
+                       CanonCursor(_buf + b.key, b.keyLen, b.flags & KEY_ESCAPED));
+  if (c) return c;
+  return compareSpans(CanonCursor(_buf + a.val, a.valLen, a.flags & VAL_ESCAPED),
+                      CanonCursor(_buf + b.val, b.valLen, b.flags & VAL_ESCAPED));
+}
+
+void Canon::reset(const char *buf) {
+  _buf = buf;
+  _count = 0;
+  _hmac = _hmacLen = 0;
+}
+
+void Canon::add(const Field &f) {
+  if (_count == MAX_KV) return;
+  _order[_count] = _count;
+  _fields[_count++] = f;
+}
+
+// insertion sort of the indices: a few fields, mostly in order already
+void Canon::sort() {
+  for (size_t i = 1; i < _count; i++) {
+    uint8_t x = _order[i];
+    size_t j = i;
+    for (; j && compare(_fields[_order[j - 1]], _fields[x]) > 0; j--) {
+      _order[j] = _order[j - 1];
     }
+    _order[j] = x;
   }
 }
 
-String buildCanonical(KV arr[], size_t n) {
-  String out;
-  for (size_t i=0; i<n; i++) {
-    if (i > 0) out += "&";
-    out += arr[i].key;
-    out += "=";
-    out += arr[i].val;
+bool Canon::parseQuery(const char *qs, size_t len) {
+  reset(qs);
+  if (len > 0xffff) return false;
+  for (size_t start = 0; start < len;) {
+    const char *amp = (const char *)memchr(qs + start, '&', len - start);
+    size_t stop = amp ? amp - qs : len;
+    const char *eq = (const char *)memchr(qs + start, '=', stop - start);
+    if (eq) {
+      size_t k = eq - qs;
+      if (isHmac(qs + start, k - start)) {
+        _hmac = k + 1;
+        _hmacLen = stop - k - 1;
+      } else {
+        add({ (uint16_t)start, (uint16_t)(k - start), (uint16_t)(k + 1), (uint16_t)(stop - k - 1), 0 });
+      }
+    }
+    start = stop + 1;
   }
-  return out;
+  sort();
+  return true;
 }
 
+bool Canon::parseJson(const char *json, size_t len) {
+  reset(json);
+  if (len > 0xffff) return false;
+  const char *p = skipSpace(json, json + len), *end = json + len;
+  if (p == end || *p++ != '{') return false;
+  p = skipSpace(p, end);
+  bool empty = p < end && *p == '}';
+  if (empty) p++;
+
+  while (!empty) {
+    Field f = {};
+    bool escaped;
+
+    if (p == end || *p++ != '"') return false;
+    const char *q = scanString(p, end, escaped);
+    if (!q) return false;
+    f.key = p - json;
+    f.keyLen = q - p;
+    if (escaped) f.flags |= KEY_ESCAPED;
+    p = skipSpace(q + 1, end);
+    if (p == end || *p++ != ':') return false;
+    p = skipSpace(p, end);
+    if (p == end) return false;
+
+    if (*p == '"') {
+      q = scanString(++p, end, escaped);
+      if (!q) return false;
+      if (escaped) f.flags |= VAL_ESCAPED;
+      f.val = p - json;
+      f.valLen = q - p;
+      p = q + 1;
+    } else if (*p == '{' || *p == '[') {
+      // nested: as written, brackets balanced outside strings
+      const char *start = p;
+      int depth = 0;
+      do {
+        if (*p == '"') {
+          if (!(q = scanString(p + 1, end, escaped))) return false;
+          p = q;
+        } else if (*p == '{' || *p == '[') {
+          depth++;
+        } else if (*p == '}' || *p == ']') {
+          depth--;
+        }
+        p++;
+      } while (depth && p < end);
+      if (depth) return false;
+      f.val = start - json;
+      f.valLen = p - start;
+    } else {
+      // number, true, false, null
+      const char *start = p;
+      while (p < end && *p != ',' && *p != '}' && *p != '"' && !isSpace(*p)) p++;
+      if (p == start) return false;
+      f.val = start - json;
+      f.valLen = p - start;
+    }
+
+    if (!(f.flags & KEY_ESCAPED) && isHmac(json + f.key, f.keyLen)) {
+      _hmac = f.val;
+      _hmacLen = f.valLen;
+    } else {
+      add(f);
+    }
+
+    p = skipSpace(p, end);
+    if (p == end) return false;
+    if (*p == '}') {
+      p++;
+      break;
+    }
+    if (*p++ != ',') return false;
+    p = skipSpace(p, end);
+  }
+  if (skipSpace(p, end) != end) return false;
+  sort();
+  return true;
+}
@@ -3,24 +3,91 @@
 
 #include <Arduino.h>
 
-struct KV {
-  String key;
-  String val;
-};
-
 #define MAX_KV 32
 
-// Parse "a=1&b=2&hmac=..." → KV array (excluding hmac)
-size_t parseQueryString(const String &qs, KV out[], size_t maxItems, String &hmacOut);
+/*
+ * Canonical form of a flat set of parameters, as data/hmac.js signs them:
+ * the hmac field left out, the others sorted by key, "k1=v1&k2=v2".
+ *
+ * Nothing is copied: fields are (offset, length) views into the caller's
+ * buffer, which must outlive the Canon, and sorting moves one-byte indices.
+ * Nor is the canonical text ever built: write() streams it into anything with
+ * update(const uint8_t *, size_t), an HmacContext usually.
+ *
+ *   Canon canon;
+ *   if (canon.parseQuery(qs, len) && canon.hasHmac()) {
+ *     HmacContext ctx(key);
+ *     canon.write(ctx);
+ *     ...
+ *
+ * JSON values are taken as written (72.50 stays 72.50), strings unescaped ;
+ * keys sort by bytes, equal keys (query strings) by value.
+ */
+class Canon {
+  public:
+    // a=1&b=2&hmac=... ; pairs without '=' and those past MAX_KV are left out, the last hmac wins.
+    // False past 64 kB.
+    bool parseQuery(const char *qs, size_t len);
 
-// Parse JSON string → KV array (excluding hmac)
-size_t parseJsonToKVs(const String &json, KV out[], size_t maxItems, String &hmacOut);
+    // {"a":1,"b":"x","hmac":"..."} ; nested values are taken as written. False if malformed.
+    bool parseJson(const char *json, size_t len);
 
-// Sort KV array lexicographically by key
-void sortKVs(KV arr[], size_t n);
+    size_t size() const { return _count; }
+    bool hasHmac() const { return _hmacLen > 0; }
+    const char *hmac() const { return _buf + _hmac; }
+    size_t hmacLength() const { return _hmacLen; }
 
-// Build canonical "k1=v1&k2=v2" string
-String buildCanonical(KV arr[], size_t n);
+    template <class Sink>
+    void write(Sink &sink) const {
+      for (size_t i = 0; i < _count; i++) {
+        const Field &f = _fields[_order[i]];
+        if (i) sink.update((const uint8_t *)"&", 1);
+        emit(sink, f.key, f.keyLen, f.flags & KEY_ESCAPED);
+        sink.update((const uint8_t *)"=", 1);
+        emit(sink, f.val, f.valLen, f.flags & VAL_ESCAPED);
+      }
+    }
 
-#endif // CANON_H
+  private:
+    enum { KEY_ESCAPED = 1, VAL_ESCAPED = 2 };   // JSON strings with a backslash
+    struct Field {
+      uint16_t key, keyLen, val, valLen;
+      uint8_t flags;
+    };
+
+    void reset(const char *buf);
+    void add(const Field &f);
+    void sort();
+    int compare(const Field &a, const Field &b) const;
+
+    template <class Sink>
+    void emit(Sink &sink, uint16_t off, uint16_t len, bool escaped) const {
+      const char *p = _buf + off, *end = p + len;
+      if (!escaped) {
+        sink.update((const uint8_t *)p, len);
+        return;
+      }
+      uint8_t chunk[32];
+      size_t n = 0;
+      while (p < end) {
+        if (n > sizeof(chunk) - 4) {
+          sink.update(chunk, n);
+          n = 0;
+        }
+        n += unescape(p, end, chunk + n);
+      }
+      sink.update(chunk, n);
+    }
 
+    // one character of a checked JSON string, as UTF-8 ; returns its length
+    static size_t unescape(const char *&p, const char *end, uint8_t out[4]);
+    friend struct CanonCursor;
+
+    const char *_buf = nullptr;
+    Field _fields[MAX_KV];
+    uint8_t _order[MAX_KV];
+    size_t _count = 0;
+    uint16_t _hmac = 0, _hmacLen = 0;
+};
+
+#endif // CANON_H
@@ -0,0 +1,214 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include <Arduino.h>
+
+/*
+ * Websocket commands, parsed in place in the received frame: no copy, no
+ * String, no heap.
+ *
+ *   verb[:arg[:arg...]]        "enable", "target:72.5", "relay:2:pid"
+ *
+ * A Command holds views into the frame. Verbs live in a table sorted by name
+ * (checked at compile time with commandsSorted()), looked up by binary search
+ * together with their argument count:
+ *
+ *   static constexpr CommandVerb<Context *> COMMANDS[] = {
+ *     { "enable", 0, onEnable },
+ *     { "target", 1, onTarget },
+ *   };
+ *   static_assert(commandsSorted(COMMANDS), "COMMANDS must be sorted by verb");
+ *   ...
+ *   Command cmd;
+ *   if (cmd.parse(data, len)) dispatchCommand(COMMANDS, cmd, &context);
+ *
+ * Other transports (query string parameters, JSON) decode into a
+ * CommandBatch, whose commands point into its own fixed arena: name=value
+ * becomes name:value, so /set?relay=2:pid and "relay:2:pid" are the same
+ * command and run through the same table.
+ */
+class CommandArg {
+  public:
+    CommandArg() : _p(nullptr), _n(0) {}
+    CommandArg(const char *p, size_t n) : _p(p), _n(n) {}
+
+    const char *data() const { return _p; }
+    size_t length() const { return _n; }
+
+    bool equals(const char *s) const {
+      for (size_t i = 0; i < _n; i++, s++) {
+        if (*s != _p[i]) return false;
+      }
+      return !*s;
+    }
+
+    // <0: before s, 0: equal, >0: after s (byte order)
+    int compare(const char *s) const {
+      for (size_t i = 0; i < _n; i++, s++) {
+        if (!*s) return 1;
+        if ((uint8_t)_p[i] != (uint8_t)*s) return (uint8_t)_p[i] < (uint8_t)*s ? -1 : 1;
+      }
+      return *s ? -1 : 0;
+    }
+
+    // [-]digits[.digits] ; false on anything else, v untouched
+    bool toFloat(float &v) const {
+      size_t i = 0;
+      bool negative = _n && _p[0] == '-';
+      if (negative) i++;
+      uint32_t whole = 0, frac = 0, scale = 1;
+      size_t digits = 0;
+      for (; i < _n && _p[i] >= '0' && _p[i] <= '9'; i++, digits++) {
+        if (whole > 99999999) return false;
+        whole = whole * 10 + (_p[i] - '0');
+      }
+      if (i < _n && _p[i] == '.') {
+        for (i++; i < _n && _p[i] >= '0' && _p[i] <= '9'; i++, digits++) {
+          if (scale < 1000000) {
+            frac = frac * 10 + (_p[i] - '0');
+            scale *= 10;
+          }
+        }
+      }
+      if (i != _n || !digits) return false;
+      float x = whole + (float)frac / scale;
+      v = negative ? -x : x;
+      return true;
+    }
+
+    // digits only ; false on anything else or overflow, v untouched
+    bool toUInt(uint32_t &v) const {
+      if (!_n) return false;
+      uint32_t x = 0;
+      for (size_t i = 0; i < _n; i++) {
+        if (_p[i] < '0' || _p[i] > '9' || x > 429496728) return false;
+        x = x * 10 + (_p[i] - '0');
+      }
+      v = x;
+      return true;
+    }
+
+  private:
+    const char *_p;
+    size_t _n;
+};
+
+class Command {
+  public:
+    static constexpr size_t MAX_ARGS = 3;
+
+    // false when the frame has more arguments than MAX_ARGS or no verb
+    bool parse(const uint8_t *data, size_t len) {
+      const char *p = (const char *)data;
+      size_t start = 0;
+      _argc = 0;
+      for (size_t i = 0; i <= len; i++) {
+        if (i < len && p[i] != ':') continue;
+        CommandArg token(p + start, i - start);
+        if (!start) {
+          verb = token;
+        } else {
+          if (_argc == MAX_ARGS) return false;
+          _args[_argc++] = token;
+        }
+        start = i + 1;
+      }
+      return verb.length() > 0;
+    }
+
+    CommandArg verb;
+    size_t argc() const { return _argc; }
+    const CommandArg &arg(size_t i) const { return _args[i]; }
+
+  private:
+    CommandArg _args[MAX_ARGS];
+    size_t _argc = 0;
+};
+
+// a few commands copied out of whatever carried them ; not copyable, the commands point into it
+class CommandBatch {
+  public:
+    static constexpr size_t MAX_COMMANDS = 6;
+    static constexpr size_t ARENA_SIZE = 96;
+
+    CommandBatch() {}
+    CommandBatch(const CommandBatch &) = delete;
+    CommandBatch &operator=(const CommandBatch &) = delete;
+
+    // "verb[:arg...]"
+    bool add(const char *text, size_t len) { return add(text, len, nullptr, 0); }
+
+    // name=value ; an empty value means no argument
+    bool add(const char *name, size_t nameLen, const char *value, size_t valueLen) {
+      size_t len = nameLen + (valueLen ? 1 + valueLen : 0);
+      if (_count == MAX_COMMANDS || len > ARENA_SIZE - _used) return reject();
+      char *p = _arena + _used;
+      memcpy(p, name, nameLen);
+      if (valueLen) {
+        p[nameLen] = ':';
+        memcpy(p + nameLen + 1, value, valueLen);
+      }
+      if (!_commands[_count].parse((const uint8_t *)p, len)) return reject();
+      _used += len;
+      _count++;
+      return true;
+    }
+
+    size_t size() const { return _count; }
+    const Command &operator[](size_t i) const { return _commands[i]; }
+    // something did not fit or did not parse: the batch is incomplete
+    bool overflowed() const { return _overflow; }
+
+  private:
+    bool reject() {
+      _overflow = true;
+      return false;
+    }
+
+    Command _commands[MAX_COMMANDS];
+    char _arena[ARENA_SIZE];
+    size_t _count = 0, _used = 0;
+    bool _overflow = false;
+};
+
+template <class Context>
+struct CommandVerb {
+  const char *name;
+  uint8_t argc;                                   // exact count
+  bool (*run)(const Command &cmd, Context ctx);   // false: arguments rejected
+};
+
+constexpr int commandNameCompare(const char *a, const char *b) {
+  while (*a && *a == *b) {
+    a++;
+    b++;
+  }
+  return (uint8_t)*a - (uint8_t)*b;
+}
+
+template <class Context, size_t N>
+constexpr bool commandsSorted(const CommandVerb<Context> (&verbs)[N]) {
+  for (size_t i = 1; i < N; i++) {
+    if (commandNameCompare(verbs[i - 1].name, verbs[i].name) >= 0) return false;
+  }
+  return true;
+}
+
+// runs the matching verb ; false when there is none, the argument count is off or it refuses the arguments
+template <class Context, size_t N>
+bool dispatchCommand(const CommandVerb<Context> (&verbs)[N], const Command &cmd, Context ctx) {
+  size_t lo = 0, hi = N;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    int c = cmd.verb.compare(verbs[mid].name);
+    if (!c) {
+      if (cmd.argc() != verbs[mid].argc) return false;
+      return verbs[mid].run(cmd, ctx);
+    }
+    if (c < 0) hi = mid;
+    else lo = mid + 1;
+  }
+  return false;
+}
+
+#endif
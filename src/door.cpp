@@ -0,0 +1,61 @@
+#include "door.h"
+
+DoorSwitch *DoorSwitch::_instance = nullptr;
+
+DoorSwitch::DoorSwitch(uint8_t pin, int openLevel, uint32_t debounceUs)
+  : _pin(pin), _openLevel(openLevel), _debounceUs(debounceUs), _cutoff(nullptr),
+    _latest(0), _tripped(false), _lastCutoff(0), _maxCutoff(0), _lost(0),
+    _open(false), _settling(false), _firstEdge(0), _count(0) {}
+
+void DoorSwitch::begin(void (*cutoff)()) {
+  _instance = this;
+  _cutoff = cutoff;
+  _open = digitalRead(_pin) == _openLevel;
+  if (_open) _trip(micros());
+  attachInterrupt(digitalPinToInterrupt(_pin), _isr, CHANGE);
+}
+
+bool DoorSwitch::poll(Event &e) {
+  uint32_t at;
+  while (_edges.pop(at)) {
+    if (!_settling) {
+      _firstEdge = at;
+      _count = 0;
+    }
+    _settling = true;
+    if (_count < 255) _count++;
+  }
+  if (!_settling || micros() - _latest < _debounceUs) return false;
+
+  // quiet for long enough: the pin says where it settled
+  noInterrupts();
+  bool quiet = _edges.empty();
+  bool open = digitalRead(_pin) == _openLevel;
+  if (quiet && !open) _tripped = false;    // armed again
+  interrupts();
+  if (!quiet) return false;                // an edge came in meanwhile
+  _settling = false;
+  if (open == _open) return false;         // a glitch, or bounced back
+  _open = open;
+  e = { open, _firstEdge, _count };
+  return true;
+}
+
+void IRAM_ATTR DoorSwitch::_isr() {
+  if (_instance) _instance->_onEdge();
+}
+
+void IRAM_ATTR DoorSwitch::_onEdge() {
+  uint32_t now = micros();
+  if (!_tripped && digitalRead(_pin) == _openLevel) _trip(now);
+  _latest = now;
+  if (!_edges.push(now)) _lost++;
+}
+
+void IRAM_ATTR DoorSwitch::_trip(uint32_t since) {
+  _tripped = true;
+  if (_cutoff) _cutoff();
+  uint32_t took = micros() - since;
+  _lastCutoff = took;
+  if (took > _maxCutoff) _maxCutoff = took;
+}
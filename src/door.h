@@ -0,0 +1,62 @@
+#ifndef DOOR_H
+#define DOOR_H
+
+#include <Arduino.h>
+#include "spsc_ring.h"
+
+/*
+ * Door switch on an edge interrupt.
+ *
+ * The first edge that reads open calls the cutoff right away, from the ISR:
+ * the heaters do not wait for loop(). Edges are queued with their time (see
+ * spsc_ring.h) ; poll() debounces them in loop() and reports each settled
+ * change once. The cutoff is armed again when the door has settled closed.
+ *
+ * The cutoff runs in interrupt context: IRAM_ATTR, no allocation, no Ticker.
+ * Its latency is timed from the ISR entry, so the few microseconds the CPU
+ * takes to get there are not in it.
+ */
+class DoorSwitch {
+  public:
+    struct Event {
+      bool open;
+      uint32_t at;              // micros() of the first edge
+      uint8_t edges;            // how many it took to settle: contact bounce, wear
+    };
+
+    DoorSwitch(uint8_t pin, int openLevel = HIGH, uint32_t debounceUs = 10000);
+
+    void begin(void (*cutoff)());         // pin must already be an input ; cuts now if open
+    bool poll(Event &e);                  // loop(): the next settled change, if any
+
+    bool isOpen() const { return _open; }         // settled
+    bool tripped() const { return _tripped; }     // cut off, not yet settled closed
+    uint32_t lastCutoffUs() const { return _lastCutoff; }
+    uint32_t maxCutoffUs() const { return _maxCutoff; }
+    unsigned long lostEdges() const { return _lost; }   // queue full: poll() reads the pin anyway
+
+  private:
+    uint8_t _pin;
+    int _openLevel;
+    uint32_t _debounceUs;
+    void (*_cutoff)();
+
+    SpscRing<uint32_t, 16> _edges;       // micros() of each edge
+    volatile uint32_t _latest;            // of the last one, even when the queue was full
+    volatile bool _tripped;
+    volatile uint32_t _lastCutoff, _maxCutoff;
+    volatile unsigned long _lost;
+
+    // loop() side
+    bool _open;
+    bool _settling;               // edges seen since the last settled state
+    uint32_t _firstEdge;
+    uint8_t _count;
+
+    static DoorSwitch *_instance;
+    static void IRAM_ATTR _isr();
+    void IRAM_ATTR _onEdge();
+    void IRAM_ATTR _trip(uint32_t since);
+};
+
+#endif
@@ -0,0 +1,354 @@
+#include "flashlog.h"
+
+static const uint32_t SEGMENT_MAGIC = 0x31474c53;   // "SLG1"
+static const uint32_t INDEX_MAGIC = 0x31584953;     // "SIX1"
+
+FlashLog::FlashLog(fs::FS &fs, const char *dir, uint8_t segments, uint16_t segmentRecords, Clock clock)
+  : _fs(fs), _dir(dir), _clock(clock), _segments(segments < 2 ? 2 : segments > MAX_SEGMENTS ? MAX_SEGMENTS : segments),
+    _capacity(!segmentRecords ? 1 : segmentRecords > MAX_INDEX * INDEX_STRIDE ? MAX_INDEX * INDEX_STRIDE : segmentRecords),
+    _minutes(*this), _ready(false),
+    _seq(0), _firstSeq(0), _count(0), _base(0), _uptimeMs(0), _millisAt(0), _oldest(0xffffffff),
+    _batched(0), _batchedAt(0) {}
+
+bool FlashLog::begin() {
+  // newest and oldest segments still there
+  bool any = false;
+  uint32_t newest = 0, newestTime = 0, oldest = 0, oldestTime = 0;
+  for (uint8_t slot = 0; slot < _segments; slot++) {
+    fs::File f = _fs.open(_path(slot), "r");
+    uint32_t seq, first;
+    if (!f || !_header(f, seq, first) || seq % _segments != slot) continue;
+    if (!any || seq > newest) {
+      newest = seq;
+      newestTime = first;
+    }
+    if (!any || seq < oldest) {
+      oldest = seq;
+      oldestTime = first;
+    }
+    any = true;
+  }
+
+  // never behind the newest segment, even with no record in it yet (power cut
+  // right after its header, or a full FS)
+  uint32_t last = newestTime;
+  if (any) {
+    fs::File f = _fs.open(_path(newest), "r+");
+    size_t size = f.size();
+    _count = _records(f);
+    if (_count < _capacity && size != HEADER_SIZE + _count * RECORD_SIZE) {
+      f.truncate(HEADER_SIZE + _count * RECORD_SIZE);   // torn append
+    }
+
+    // the clock resumes after the last record that reads back fine
+    for (size_t i = _count; i > 0; i--) {
+      uint8_t buf[RECORD_SIZE];
+      Record r;
+      f.seek(HEADER_SIZE + (i - 1) * RECORD_SIZE);
+      if (f.read(buf, RECORD_SIZE) == RECORD_SIZE && _decode(buf, r)) {
+        if (r.time + 1 > last) last = r.time + 1;
+        break;
+      }
+    }
+    for (size_t i = 0; i < _count && _count < _capacity; i += INDEX_STRIDE) {
+      _time(f, i, _index[i / INDEX_STRIDE]);
+    }
+    f.close();
+
+    _seq = newest;
+    _firstSeq = oldest;
+    _oldest = oldestTime;
+    if (_count >= _capacity) {
+      _seq++;
+      _count = 0;
+    }
+  }
+
+  _base = last;
+  _uptimeMs = 0;
+  _millisAt = _clock();
+  _ready = true;
+  event(BOOT);
+  return any;
+}
+
+// 32-bit millis() wraps after 49.7 days: poll() folds it into a 64-bit count
+// long before, so the clock only goes forward
+uint32_t FlashLog::now() const {
+  return _base + (uint32_t)((_uptimeMs + (uint32_t)(_clock() - _millisAt)) / 1000);
+}
+
+void FlashLog::sample(const HistoryBucket &b) {
+  if (!b.valid) return;   // gaps are what is not there
+  uint32_t t = now();
+  uint32_t lag = t - b.start;
+  Record r = { t, SAMPLE, 0, { (int16_t)b.avg, (int16_t)b.min, (int16_t)b.max, (int16_t)(lag > 32767 ? 32767 : lag) } };
+  _append(r);
+}
+
+void FlashLog::event(Event e, int16_t value) {
+  Record r = { now(), EVENT, e, { value, 0, 0, 0 } };
+  _append(r);
+}
+
+void FlashLog::poll() {
+  uint32_t ms = _clock();
+  _uptimeMs += (uint32_t)(ms - _millisAt);
+  _millisAt = ms;
+  if (_batched && now() - _batchedAt >= FLUSH_S) flush();
+}
+
+void FlashLog::_append(const Record &r) {
+  if (!_ready) return;
+  if (!_batched) _batchedAt = r.time;
+  _batch[_batched++] = r;
+  if (_batched == BATCH) flush();
+}
+
+void FlashLog::flush() {
+  size_t i = 0;
+  while (i < _batched) {
+    if (!_count && !_startSegment(_seq, _batch[i].time)) break;
+
+    size_t n = _batched - i;
+    if (n > _capacity - _count) n = _capacity - _count;
+    uint8_t buf[BATCH * RECORD_SIZE];
+    for (size_t k = 0; k < n; k++) {
+      _encode(_batch[i + k], buf + k * RECORD_SIZE);
+      if ((_count + k) % INDEX_STRIDE == 0) _index[(_count + k) / INDEX_STRIDE] = _batch[i + k].time;
+    }
+
+    fs::File f = _fs.open(_path(_seq), "a");
+    if (!f) break;
+    size_t bytes = f.write(buf, n * RECORD_SIZE);
+    size_t written = bytes / RECORD_SIZE;
+    // a partial record would shift every later append off its slot
+    if (bytes % RECORD_SIZE) f.truncate(HEADER_SIZE + (_count + written) * RECORD_SIZE);
+    f.close();
+    _count += written;
+    i += written;
+    if (written < n) break;   // FS full: keep the rest for later
+
+    if (_count >= _capacity) {
+      _seal();
+      _seq++;
+      _count = 0;
+    }
+  }
+
+  // what did not make it stays batched
+  memmove(_batch, _batch + i, (_batched - i) * sizeof(Record));
+  _batched -= i;
+  if (_batched) _batchedAt = now();
+}
+
+bool FlashLog::_startSegment(uint32_t seq, uint32_t firstTime) {
+  // reopening the slot for writing drops the segment it held: the only erase
+  fs::File f = _fs.open(_path(seq), "w");
+  if (!f) return false;
+  uint8_t h[HEADER_SIZE];
+  uint32_t fields[3] = { SEGMENT_MAGIC, seq, firstTime };
+  for (size_t k = 0; k < 12; k++) h[k] = fields[k / 4] >> (8 * (k % 4));
+  h[12] = _capacity & 0xff;
+  h[13] = _capacity >> 8;
+  uint16_t crc = _crc16(h, 14);
+  h[14] = crc & 0xff;
+  h[15] = crc >> 8;
+  bool ok = f.write(h, HEADER_SIZE) == HEADER_SIZE;
+  f.close();
+
+  if (seq - _firstSeq >= _segments) {
+    _firstSeq = seq - _segments + 1;
+    fs::File o = _fs.open(_path(_firstSeq), "r");
+    uint32_t s, t;
+    if (o && _header(o, s, t)) _oldest = t;
+  } else if (_oldest == 0xffffffff) {
+    _oldest = firstTime;
+  }
+  return ok;
+}
+
+void FlashLog::_seal() {
+  size_t entries = (_capacity + INDEX_STRIDE - 1) / INDEX_STRIDE;
+  uint8_t footer[4 * MAX_INDEX + 8];
+  size_t p = 0;
+  for (size_t k = 0; k < entries; k++) {
+    for (size_t b = 0; b < 4; b++) footer[p++] = _index[k] >> (8 * b);
+  }
+  uint16_t crc = _crc16(footer, p);
+  for (size_t b = 0; b < 4; b++) footer[p++] = INDEX_MAGIC >> (8 * b);
+  footer[p++] = entries & 0xff;
+  footer[p++] = entries >> 8;
+  footer[p++] = crc & 0xff;
+  footer[p++] = crc >> 8;
+
+  fs::File f = _fs.open(_path(_seq), "a");
+  if (f) f.write(footer, p);   // without it, readers fall back to a binary search
+}
+
+bool FlashLog::_time(fs::File &f, size_t i, uint32_t &t) {
+  uint8_t b[4];
+  if (!f.seek(HEADER_SIZE + i * RECORD_SIZE) || f.read(b, 4) != 4) return false;
+  t = b[0] | b[1] << 8 | b[2] << 16 | (uint32_t)b[3] << 24;
+  return true;
+}
+
+size_t FlashLog::_seek(fs::File &f, size_t count, uint32_t from) const {
+  size_t lo = 0, hi = count;
+
+  // sealed: the footer narrows it down to one stride
+  size_t entries = (_capacity + INDEX_STRIDE - 1) / INDEX_STRIDE;
+  size_t at = HEADER_SIZE + _capacity * RECORD_SIZE;
+  uint8_t footer[4 * MAX_INDEX + 8];
+  if (count == _capacity && f.size() == at + 4 * entries + 8 && f.seek(at)
+      && f.read(footer, 4 * entries + 8) == 4 * entries + 8) {
+    const uint8_t *t = footer + 4 * entries;
+    uint32_t magic = t[0] | t[1] << 8 | t[2] << 16 | (uint32_t)t[3] << 24;
+    if (magic == INDEX_MAGIC && (size_t)(t[4] | t[5] << 8) == entries
+        && _crc16(footer, 4 * entries) == (uint16_t)(t[6] | t[7] << 8)) {
+      size_t k = 0;
+      while (k + 1 < entries && (uint32_t)(footer[4 * (k + 1)] | footer[4 * (k + 1) + 1] << 8
+             | footer[4 * (k + 1) + 2] << 16 | (uint32_t)footer[4 * (k + 1) + 3] << 24) < from) k++;
+      lo = k * INDEX_STRIDE;
+      if (lo + INDEX_STRIDE < hi) hi = lo + INDEX_STRIDE;
+    }
+  }
+
+  // records are in time order
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    uint32_t t;
+    if (!_time(f, mid, t)) break;
+    if (t < from) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+// ---- reading ----
+
+FlashLog::Reader::Reader(const FlashLog &log, uint32_t from, uint32_t to, Type type)
+  : _log(log), _from(from), _to(to), _type(type), _seq(log._firstSeq), _i(0), _count(0),
+    _batch(0), _inBatch(false) {
+  // last segment starting at or before `from`
+  for (uint32_t seq = log._firstSeq + 1; seq <= log._seq; seq++) {
+    fs::File f = log._fs.open(log._path(seq), "r");
+    uint32_t s, first;
+    if (!f || !log._header(f, s, first) || s != seq || first > from) break;
+    _seq = seq;
+  }
+  if (_open(_seq)) _i = log._seek(_f, _count, from);
+  if (_f) _f.seek(HEADER_SIZE + _i * RECORD_SIZE);
+}
+
+bool FlashLog::Reader::_open(uint32_t seq) {
+  _f = _log._fs.open(_log._path(seq), "r");
+  uint32_t s, first;
+  if (!_f || !_log._header(_f, s, first) || s != seq) {
+    _f = fs::File();
+    _count = 0;
+    return false;
+  }
+  _count = _log._records(_f);
+  _i = 0;
+  _f.seek(HEADER_SIZE);
+  return true;
+}
+
+bool FlashLog::Reader::next(Record &r) {
+  while (!_inBatch) {
+    if (_f && _i < _count) {
+      uint8_t buf[RECORD_SIZE];
+      _i++;
+      if (_f.read(buf, RECORD_SIZE) != RECORD_SIZE) {
+        _i = _count;
+        continue;
+      }
+      if (!_decode(buf, r) || r.time < _from) continue;
+      if (r.time >= _to) return false;
+      if (r.type == _type) return true;
+      continue;
+    }
+    if (_seq < _log._seq) {
+      _open(++_seq);
+      continue;
+    }
+    _f = fs::File();
+    _inBatch = true;
+  }
+
+  while (_batch < _log._batched) {
+    r = _log._batch[_batch++];
+    if (r.time < _from) continue;
+    if (r.time >= _to) return false;
+    if (r.type == _type) return true;
+  }
+  return false;
+}
+
+void FlashLog::Minutes::read(uint32_t from, uint32_t to, Visitor &v) const {
+  // records are stamped when the minute closed, `lag` seconds after it started
+  _log.read(from, 0xffffffff, SAMPLE, [&](const Record &r) {
+    uint32_t start = r.time - (uint16_t)r.v[3];
+    if (start < from) return true;
+    if (start >= to) return false;
+    HistoryBucket b = { start, true, r.v[0], r.v[1], r.v[2] };
+    return v.visit(b);
+  });
+}
+
+String FlashLog::_path(uint32_t seq) const {
+  return _dir + "/" + String((unsigned long)(seq % _segments)) + ".seg";
+}
+
+bool FlashLog::_header(fs::File &f, uint32_t &seq, uint32_t &firstTime) const {
+  uint8_t h[HEADER_SIZE];
+  f.seek(0);
+  if (f.read(h, HEADER_SIZE) != HEADER_SIZE) return false;
+  if (_crc16(h, 14) != (uint16_t)(h[14] | h[15] << 8)) return false;
+  uint32_t fields[3] = { 0, 0, 0 };
+  for (size_t k = 0; k < 12; k++) fields[k / 4] |= (uint32_t)h[k] << (8 * (k % 4));
+  if (fields[0] != SEGMENT_MAGIC || (uint16_t)(h[12] | h[13] << 8) != _capacity) return false;
+  seq = fields[1];
+  firstTime = fields[2];
+  return true;
+}
+
+size_t FlashLog::_records(const fs::File &f) const {
+  size_t size = f.size();
+  if (size < HEADER_SIZE) return 0;
+  size_t n = (size - HEADER_SIZE) / RECORD_SIZE;
+  return n > _capacity ? _capacity : n;   // past capacity: the index footer
+}
+
+void FlashLog::_encode(const Record &r, uint8_t *out) {
+  for (size_t k = 0; k < 4; k++) out[k] = r.time >> (8 * k);
+  out[4] = r.type;
+  out[5] = r.code;
+  for (size_t k = 0; k < 4; k++) {
+    out[6 + 2 * k] = (uint16_t)r.v[k] & 0xff;
+    out[7 + 2 * k] = (uint16_t)r.v[k] >> 8;
+  }
+  uint16_t crc = _crc16(out, 14);
+  out[14] = crc & 0xff;
+  out[15] = crc >> 8;
+}
+
+bool FlashLog::_decode(const uint8_t *in, Record &r) {
+  if (_crc16(in, 14) != (uint16_t)(in[14] | in[15] << 8)) return false;
+  r.time = 0;
+  for (size_t k = 0; k < 4; k++) r.time |= (uint32_t)in[k] << (8 * k);
+  r.type = in[4];
+  r.code = in[5];
+  for (size_t k = 0; k < 4; k++) r.v[k] = (int16_t)(in[6 + 2 * k] | in[7 + 2 * k] << 8);
+  return true;
+}
+
+// CRC-16/CCITT-FALSE
+uint16_t FlashLog::_crc16(const uint8_t *p, size_t n, uint16_t crc) {
+  while (n--) {
+    crc ^= (uint16_t)*p++ << 8;
+    for (uint8_t b = 0; b < 8; b++) crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
@@ -0,0 +1,151 @@
+#ifndef FLASHLOG_H
+#define FLASHLOG_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include "history.h"
+
+/*
+ * Append-only log on LittleFS: minute history buckets and events, kept over
+ * reboots (the EEPROM only holds settings).
+ *
+ * Records are 16 bytes with their own CRC, in a rotating set of segment
+ * files (/log/0.seg ... ; 8 x 2048 records: 11 days of minutes). A full
+ * segment is sealed with a footer indexing every INDEX_STRIDE-th record's
+ * time, so a reader seeks by time with one footer read ; in the segment being
+ * written, fixed-size records allow a binary search instead.
+ *
+ * Flash wear: LittleFS rewrites the tail block of a file on every append,
+ * so records are batched in RAM and appended a flash page (BATCH records)
+ * at a time, or after FLUSH_S at the latest. A power cut loses at most that.
+ * A segment is only ever erased as a whole, when the rotation comes back to it.
+ *
+ * Time is the log clock: seconds that resume from the last record at boot,
+ * so it never goes backwards even without wall time (downtime is not
+ * counted ; a BOOT event marks each restart). History and /history use it.
+ *
+ *   record   u32 time, u8 type, u8 code, i16 a, b, c, d, u16 crc16 (little endian)
+ *   SAMPLE   a, b, c: avg, min, max [1/16 °C] of the minute that started d s before time
+ *   EVENT    code: Event, a: value
+ *   segment  16 byte header (magic, seq, first time, capacity, crc), records,
+ *            then once sealed: u32 time per index entry, u32 magic, u16 count, u16 crc
+ */
+class FlashLog {
+  public:
+    enum Type : uint8_t { SAMPLE = 1, EVENT = 2 };
+    enum Event : uint8_t {
+      BOOT,           // a: 0
+      ENABLED,        // a: 1 enabled, 0 disabled
+      TARGET,         // a: setpoint [1/16 °C]
+      DOOR,           // a: 1 open, 0 closed
+    };
+
+    struct Record {
+      uint32_t time;
+      uint8_t type;
+      uint8_t code;
+      int16_t v[4];
+    };
+
+    static constexpr size_t RECORD_SIZE = 16;
+    static constexpr size_t HEADER_SIZE = 16;
+    static constexpr size_t INDEX_STRIDE = 64;
+    static constexpr size_t MAX_INDEX = 64;           // segments up to 4096 records
+    static constexpr size_t BATCH = 16;               // 256 bytes: one flash page
+    static constexpr uint32_t FLUSH_S = 1800;
+    static constexpr uint8_t MAX_SEGMENTS = 32;
+
+    typedef unsigned long (*Clock)();
+
+    FlashLog(fs::FS &fs, const char *dir = "/log", uint8_t segments = 8, uint16_t segmentRecords = 2048,
+             Clock clock = millis);
+
+    bool begin();                                     // once the FS is mounted
+    uint32_t now() const;                             // log clock [s]
+
+    void sample(const HistoryBucket &b);              // a closed minute
+    void event(Event e, int16_t value = 0);
+    void poll();                                      // from a task: flushes an old batch, carries the clock over millis() wraps
+    void flush();
+
+    // records of one type with time in [from, to), oldest first, the unwritten batch last ;
+    // f(const Record &) returns false to stop
+    template <class F>
+    void read(uint32_t from, uint32_t to, Type type, F f) const {
+      Reader r(*this, from, to, type);
+      Record rec;
+      while (r.next(rec)) {
+        if (!f(rec)) return;
+      }
+    }
+
+    // minute buckets for HistoryStream
+    class Minutes : public HistorySource {
+      public:
+        explicit Minutes(const FlashLog &log) : _log(log) {}
+        uint32_t periodS() const override { return 60; }
+        uint8_t unitShift() const override { return 0; }
+        void read(uint32_t from, uint32_t to, Visitor &v) const override;
+      private:
+        const FlashLog &_log;
+    };
+
+    const Minutes &minutes() const { return _minutes; }
+    uint32_t oldest() const { return _oldest; }        // time of the first record kept
+    bool ready() const { return _ready; }
+
+  private:
+    // segment by segment, seeking to `from` in the first one
+    class Reader {
+      public:
+        Reader(const FlashLog &log, uint32_t from, uint32_t to, Type type);
+        bool next(Record &r);
+      private:
+        const FlashLog &_log;
+        uint32_t _from, _to;
+        Type _type;
+        uint32_t _seq;         // segment being read
+        size_t _i;             // next record in it
+        size_t _count;         // records in it
+        size_t _batch;         // next batched record, once past the segments
+        bool _inBatch;
+        fs::File _f;
+        bool _open(uint32_t seq);
+    };
+
+    fs::FS &_fs;
+    String _dir;
+    Clock _clock;
+    uint8_t _segments;
+    uint16_t _capacity;
+    Minutes _minutes;
+    bool _ready;
+
+    uint32_t _seq;            // segment being appended to
+    uint32_t _firstSeq;       // oldest segment kept
+    size_t _count;            // records already in it
+    uint32_t _base;           // log clock at begin()
+    uint64_t _uptimeMs;       // since begin(), up to _millisAt
+    uint32_t _millisAt;
+    uint32_t _oldest;
+    uint32_t _index[MAX_INDEX];  // of the segment being appended to, footer once sealed
+
+    Record _batch[BATCH];
+    size_t _batched;
+    uint32_t _batchedAt;      // log clock of the first batched record
+
+    void _append(const Record &r);
+    bool _startSegment(uint32_t seq, uint32_t firstTime);
+    void _seal();
+    String _path(uint32_t seq) const;
+    bool _header(fs::File &f, uint32_t &seq, uint32_t &firstTime) const;
+    size_t _records(const fs::File &f) const;
+    size_t _seek(fs::File &f, size_t count, uint32_t from) const;   // first record at or after from
+    static bool _time(fs::File &f, size_t i, uint32_t &t);
+
+    static void _encode(const Record &r, uint8_t *out);
+    static bool _decode(const uint8_t *in, Record &r);
+    static uint16_t _crc16(const uint8_t *p, size_t n, uint16_t crc = 0xffff);
+};
+
+#endif
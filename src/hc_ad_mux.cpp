@@ -2,6 +2,26 @@
 
 uint8_t HC4051::_srState = 0;
 
+// 74HCT595 write, MSB first: straight to the GPIO set/clear registers for
+// GPIO0..15, about 30 register stores instead of 26 digitalWrite() calls
+static void writeShiftRegister(uint8_t latchPin, uint8_t clockPin, uint8_t dataPin, uint8_t value) {
+  if (latchPin > 15 || clockPin > 15 || dataPin > 15) {
+    digitalWrite(latchPin, LOW);
+    shiftOut(dataPin, clockPin, MSBFIRST, value);
+    digitalWrite(latchPin, HIGH);
+    return;
+  }
+  const uint32_t latch = 1u << latchPin, clock = 1u << clockPin, data = 1u << dataPin;
+  GPOC = latch;
+  for (uint8_t bit = 0x80; bit; bit >>= 1) {
+    if (value & bit) GPOS = data;
+    else GPOC = data;
+    GPOS = clock;
+    GPOC = clock;
+  }
+  GPOS = latch;
+}
+
 HC4051::HC4051(uint8_t muxIndex, uint8_t latchPin, uint8_t clockPin, uint8_t dataPin) {
   _muxIndex = muxIndex;
   _latchPin = latchPin;
@@ -14,21 +34,21 @@ HC4051::HC4051(uint8_t muxIndex, uint8_t latchPin, uint8_t clockPin, uint8_t dat
 }
 
 void HC4051::_updateShiftRegister() {
-  digitalWrite(_latchPin, LOW);
-  shiftOut(_dataPin, _clockPin, MSBFIRST, _srState);
-  digitalWrite(_latchPin, HIGH);
+  writeShiftRegister(_latchPin, _clockPin, _dataPin, _srState);
 }
 
-void HC4051::select(uint8_t channel) {
-  if (channel >= 8) return;
-
+void HC4051::_set(uint8_t channel) {
   uint8_t base = (_muxIndex == 0) ? 0 : 3;
 
   // clear bits
   _srState &= ~(0b111 << base);
   // set new bits
   _srState |= ((channel & 0x07) << base);
+}
 
+void HC4051::select(uint8_t channel) {
+  if (channel >= 8) return;
+  _set(channel);
   _updateShiftRegister();
 }
 
@@ -44,9 +64,68 @@ int MUXSystem::readMux1(uint8_t channel) {
 
 int MUXSystem::readMux2(uint8_t channel) {
   if (channel >= 8) return -1;
-  _mux2.select(channel);
+  _mux2._set(channel);                    // both in one write
   _mux1.select(_mux2_to_mux1_channel);
   delayMicroseconds(5);
   return analogRead(_analogPin);
 }
 
+MuxScanner::MuxScanner(uint8_t analogPin, uint8_t latchPin, uint8_t clockPin, uint8_t dataPin, uint8_t mux2_to_mux1_channel)
+  : _analogPin(analogPin), _latchPin(latchPin), _clockPin(clockPin), _dataPin(dataPin), _route(mux2_to_mux1_channel) {}
+
+// position of a 3-bit address in the Gray sequence 0 1 3 2 6 7 5 4
+static uint8_t grayRank(uint8_t address) {
+  return address ^ (address >> 1) ^ (address >> 2);
+}
+
+static uint8_t scanKey(int channel) {
+  return (channel >= 8 ? 8 : 0) | grayRank(channel & 7);
+}
+
+void MuxScanner::begin(const int *channels, size_t count) {
+  pinMode(_latchPin, OUTPUT);
+  pinMode(_clockPin, OUTPUT);
+  pinMode(_dataPin, OUTPUT);
+
+  _count = 0;
+  for (size_t i = 0; i < count && _count < MAX_CHANNELS; i++) {
+    if (channels[i] < 0 || channels[i] > 15) continue;
+    // insertion by scan order
+    size_t j = _count++;
+    for (; j && scanKey(channels[_indexes[j - 1]]) > scanKey(channels[i]); j--) {
+      _indexes[j] = _indexes[j - 1];
+    }
+    _indexes[j] = i;
+  }
+
+  // MUX1 in bits 0-2, MUX2 in bits 3-5 (see HC4051) ; while a MUX1 channel is
+  // read, MUX2 already sits on the next MUX2 channel of the scan
+  for (size_t step = 0; step < _count; step++) {
+    int channel = channels[_indexes[step]];
+    uint8_t mux2 = 0;
+    for (size_t k = 0; k < _count; k++) {
+      int next = channels[_indexes[(step + k) % _count]];
+      if (next >= 8) {
+        mux2 = next & 7;
+        break;
+      }
+    }
+    _states[step] = channel >= 8 ? (_route | mux2 << 3) : (channel | mux2 << 3);
+  }
+
+  _step = 0;
+  if (_count) _write(_states[0]);
+}
+
+int MuxScanner::sample(size_t &index) {
+  int raw = analogRead(_analogPin);
+  index = _indexes[_step];
+  if (++_step >= _count) _step = 0;
+  if (_states[_step] != _state) _write(_states[_step]);
+  return raw;
+}
+
+void MuxScanner::_write(uint8_t state) {
+  _state = state;
+  writeShiftRegister(_latchPin, _clockPin, _dataPin, state);
+}
@@ -17,7 +17,9 @@ class HC4051 {
     uint8_t _dataPin;
 
     static uint8_t _srState; // shared shift register state
+    void _set(uint8_t channel);   // in _srState only
     void _updateShiftRegister();
+    friend class MUXSystem;
 };
 
 class MUXSystem {
@@ -36,5 +38,34 @@ class MUXSystem {
     uint8_t _mux2_to_mux1_channel;
 };
 
-#endif
+// Continuous scan of a channel list through both muxes, for a sampling timer:
+// each sample() reads the channel selected by the call before and selects the
+// next, so the muxes settle between samples instead of in a busy wait, with a
+// single shift register write that sets both at once. Channels are visited
+// MUX1 first then MUX2, each in Gray code order (one address bit changes per
+// step), and MUX2 is set up for its first channel while MUX1 is being read.
+//
+//   scanner.begin(channels, n);             // 0..7: MUX1, 8..15: MUX2
+//   ...
+//   size_t i;
+//   int raw = scanner.sample(i);            // raw is channels[i]
+class MuxScanner {
+  public:
+    static constexpr size_t MAX_CHANNELS = 16;
+
+    MuxScanner(uint8_t analogPin, uint8_t latchPin, uint8_t clockPin, uint8_t dataPin, uint8_t mux2_to_mux1_channel);
 
+    void begin(const int *channels, size_t count);
+    int sample(size_t &index);
+
+  private:
+    void _write(uint8_t state);
+
+    uint8_t _analogPin, _latchPin, _clockPin, _dataPin, _route;
+    uint8_t _states[MAX_CHANNELS];     // shift register byte for each step
+    uint8_t _indexes[MAX_CHANNELS];    // and its channel, as an index into begin()'s list
+    size_t _count = 0, _step = 0;
+    uint8_t _state = 0;
+};
+
+#endif
@@ -0,0 +1,240 @@
+#include "history.h"
+#include <DallasTemperature.h>
+
+HistoryTier::HistoryTier(int8_t *delta, uint8_t *spread, size_t capacity, uint32_t periodS, uint8_t unitShift)
+  : _delta(delta), _spread(spread), _cap(capacity), _period(periodS ? periodS : 1), _shift(unitShift), _sink(nullptr),
+    _head(0), _size(0), _valid(0), _base(0), _last(0), _newest(0),
+    _open(false), _start(0), _sum(0), _min(0), _max(0), _n(0) {}
+
+void HistoryTier::sample(uint32_t nowS, bool valid, int32_t v16) {
+  uint32_t start = nowS - nowS % _period;
+  if (!_open) {
+    _open = true;
+    _start = start;
+  } else if (start != _start) {
+    _close();
+    // periods without a single call (stalled loop): gaps, no more than the ring holds
+    uint32_t missing = (start - _start) / _period - 1;
+    if (missing > _cap) missing = _cap;
+    for (uint32_t k = missing; k > 0; k--) _push(start - k * _period, false, 0, 0, 0);
+    _start = start;
+  }
+
+  if (!valid) return;
+  if (!_n || v16 < _min) _min = v16;
+  if (!_n || v16 > _max) _max = v16;
+  _sum += v16;
+  _n++;
+}
+
+void HistoryTier::_close() {
+  if (_n) {
+    HistoryBucket b = { _start, true, _roundDiv(_sum, _n), _min, _max };
+    _push(_start, true, _units(b.avg), _units(b.min), _units(b.max));
+    if (_sink) _sink(b);
+  } else {
+    _push(_start, false, 0, 0, 0);
+  }
+  _sum = _n = 0;
+}
+
+void HistoryTier::_push(uint32_t start, bool valid, int32_t avg, int32_t min, int32_t max) {
+  size_t i;
+  if (_size == _cap) {
+    i = _head;
+    if (_delta[i] != GAP) {
+      _base += _delta[i];
+      _valid--;
+    }
+    _head = (_head + 1) % _cap;
+  } else {
+    i = (_head + _size++) % _cap;
+  }
+  _newest = start;
+
+  if (!valid) {
+    _delta[i] = GAP;
+    return;
+  }
+
+  int32_t d = 0;
+  if (!_valid) {
+    // nothing to be relative to: the ring only holds gaps
+    _base = _last = avg;
+  } else {
+    d = avg - _last;
+    if (d > 127) d = 127;
+    if (d < -127) d = -127;
+    _last += d;
+  }
+  _delta[i] = d;
+  _valid++;
+
+  if (_spread) {
+    int32_t below = _last - min, above = max - _last;
+    _spread[2 * i] = below < 0 ? 0 : below > 255 ? 255 : below;
+    _spread[2 * i + 1] = above < 0 ? 0 : above > 255 ? 255 : above;
+  }
+}
+
+History::History()
+  : _tiers{ { _delta0, nullptr, sizeof(_delta0), 1, 0 },
+            { _delta1, _spread1, sizeof(_delta1), 60, 0 },
+            { _delta2, _spread2, sizeof(_delta2), 900, 2 } } {}
+
+void History::sample(uint32_t nowS, float celsius) {
+  bool valid = !isnan(celsius) && celsius != DEVICE_DISCONNECTED_C;
+  int32_t v16 = valid ? (int32_t)lroundf(celsius * 16) : 0;
+  for (auto &t : _tiers) t.sample(nowS, valid, v16);
+}
+
+const HistoryTier *History::tierFor(uint32_t periodS) const {
+  for (auto &t : _tiers) {
+    if (t.periodS() == periodS) return &t;
+  }
+  return nullptr;
+}
+
+const HistoryTier *History::finestSince(uint32_t from) const {
+  for (auto &t : _tiers) {
+    if (t.oldest() <= from) return &t;
+  }
+  return nullptr;
+}
+
+// ---- export ----
+
+static size_t putUint(uint8_t *out, uint32_t v) {
+  char digits[10];
+  size_t n = 0, p = 0;
+  do {
+    digits[n++] = '0' + v % 10;
+    v /= 10;
+  } while (v);
+  while (n) out[p++] = digits[--n];
+  return p;
+}
+
+// 1/16 °C as °C with 2 decimals, no printf
+static size_t putCelsius(uint8_t *out, int32_t v16) {
+  size_t p = 0;
+  if (v16 < 0) {
+    out[p++] = '-';
+    v16 = -v16;
+  }
+  uint32_t c = ((uint32_t)v16 * 100 + 8) / 16;
+  p += putUint(out + p, c / 100);
+  out[p++] = '.';
+  out[p++] = '0' + c / 10 % 10;
+  out[p++] = '0' + c % 10;
+  return p;
+}
+
+static size_t putLe(uint8_t *out, uint32_t v, size_t bytes) {
+  for (size_t i = 0; i < bytes; i++) out[i] = v >> (8 * i);
+  return bytes;
+}
+
+static const size_t MAX_HEADER = 40;   // CSV: "# now=4294967295,res=900\nt,avg,min,max\n"
+static const size_t MAX_ROW = 40;      // CSV: 10 + 3 x 8 + separators
+
+// lambdas as HistorySource visitors
+template <class F>
+struct Visit : HistorySource::Visitor {
+  F f;
+  explicit Visit(F f) : f(f) {}
+  bool visit(const HistoryBucket &b) override { return f(b); }
+};
+
+template <class F>
+static void readFrom(const HistorySource &source, uint32_t from, uint32_t to, F f) {
+  Visit<F> v(f);
+  source.read(from, to, v);
+}
+
+HistoryStream::HistoryStream(const HistorySource &source, uint32_t from, uint32_t to, uint32_t nowS, Format format)
+  : _source(source), _next(from), _to(to), _now(nowS), _format(format), _header(false), _done(false) {
+  // binary rows carry no time: start at the first bucket actually there
+  readFrom(source, from, to, [this](const HistoryBucket &b) { _next = b.start; return false; });
+}
+
+size_t HistoryStream::fill(uint8_t *buf, size_t maxLen) {
+  if (_done) return 0;
+  uint8_t row[MAX_ROW > MAX_HEADER ? MAX_ROW : MAX_HEADER];
+  size_t p = 0;
+
+  if (!_header) {
+    size_t n = _writeHeader(row);
+    if (n > maxLen) return 0;
+    memcpy(buf, row, n);
+    p = n;
+    _header = true;
+  }
+
+  bool more = false;
+  readFrom(_source, _next, _to, [&](const HistoryBucket &b) {
+    // binary rows are implicitly timed: fill in what the source does not have
+    while (_format == BINARY && _next < b.start) {
+      HistoryBucket gap = { _next, false, 0, 0, 0 };
+      if (p + _writeRow(row, gap) > maxLen) {
+        more = true;
+        return false;
+      }
+      p += _writeRow(buf + p, gap);
+      _next += _source.periodS();
+    }
+    size_t n = _writeRow(row, b);
+    if (p + n > maxLen) {
+      more = true;
+      return false;
+    }
+    memcpy(buf + p, row, n);
+    p += n;
+    _next = b.start + _source.periodS();
+    return true;
+  });
+  if (!more) _done = true;
+  return p;
+}
+
+size_t HistoryStream::_writeHeader(uint8_t *out) const {
+  size_t p = 0;
+  if (_format == BINARY) {
+    out[p++] = VERSION;
+    out[p++] = _source.unitShift();
+    p += putLe(out + p, _now, 4);
+    p += putLe(out + p, _source.periodS(), 4);
+    p += putLe(out + p, _next, 4);
+    return p;
+  }
+  memcpy(out + p, "# now=", 6);
+  p += 6;
+  p += putUint(out + p, _now);
+  memcpy(out + p, ",res=", 5);
+  p += 5;
+  p += putUint(out + p, _source.periodS());
+  memcpy(out + p, "\nt,avg,min,max\n", 15);
+  return p + 15;
+}
+
+size_t HistoryStream::_writeRow(uint8_t *out, const HistoryBucket &b) const {
+  size_t p = 0;
+  if (_format == BINARY) {
+    int32_t avg = b.avg < -32767 ? -32767 : b.avg > 32767 ? 32767 : b.avg;
+    uint8_t shift = _source.unitShift();
+    int32_t below = (b.avg - b.min) >> shift, above = (b.max - b.avg) >> shift;
+    p += putLe(out + p, b.valid ? (uint16_t)avg : 0x8000, 2);
+    out[p++] = !b.valid || below < 0 ? 0 : below > 255 ? 255 : below;
+    out[p++] = !b.valid || above < 0 ? 0 : above > 255 ? 255 : above;
+    return p;
+  }
+  p += putUint(out + p, b.start);
+  out[p++] = ',';
+  if (b.valid) p += putCelsius(out + p, b.avg);
+  out[p++] = ',';
+  if (b.valid) p += putCelsius(out + p, b.min);
+  out[p++] = ',';
+  if (b.valid) p += putCelsius(out + p, b.max);
+  out[p++] = '\n';
+  return p;
+}
@@ -0,0 +1,166 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <Arduino.h>
+
+/*
+ * Temperature history in fixed RAM, at three resolutions:
+ *
+ *   1 s                for 10 min     600 B
+ *   1 min  avg/min/max for 24 h      4320 B
+ *   15 min avg/min/max for a week    2016 B
+ *
+ * Each tier keeps one signed byte per bucket, the average's difference to the
+ * previous bucket, and for the coarser tiers how far the min and max were
+ * below and above that average (one byte each). Units are 1/16 °C (DS18B20
+ * resolution) or 1/4 °C for the weekly tier. A step larger than a byte holds
+ * is spread over the following buckets: fast swings are slew-limited, never
+ * lost. Buckets without a single valid sample are gaps.
+ *
+ * Time is in seconds since boot.
+ */
+struct HistoryBucket {
+  uint32_t start;                   // [s]
+  bool valid;                       // false: no sample in this bucket
+  int32_t avg, min, max;            // [1/16 °C]
+};
+
+// where HistoryStream reads buckets from: a RAM tier, or the flash log (flashlog.h)
+class HistorySource {
+  public:
+    struct Visitor {
+      virtual bool visit(const HistoryBucket &b) = 0;   // false to stop
+    };
+    virtual ~HistorySource() {}
+    virtual uint32_t periodS() const = 0;
+    virtual uint8_t unitShift() const = 0;              // of min/max below/above the average
+    virtual void read(uint32_t from, uint32_t to, Visitor &v) const = 0;  // starts in [from, to)
+};
+
+class HistoryTier : public HistorySource {
+  public:
+    static constexpr int8_t GAP = -128;
+    typedef void (*Sink)(const HistoryBucket &b);
+
+    // spread: 2 bytes per bucket for min/max, nullptr for averages only
+    HistoryTier(int8_t *delta, uint8_t *spread, size_t capacity, uint32_t periodS, uint8_t unitShift);
+
+    void sample(uint32_t nowS, bool valid, int32_t v16);  // a bucket closes with the first sample past it
+    void onClose(Sink s) { _sink = s; }                   // gets each non-gap bucket, unrounded
+
+    uint32_t periodS() const override { return _period; }
+    uint8_t unitShift() const override { return _shift; }
+    bool hasSpread() const { return _spread != nullptr; }
+    size_t capacity() const { return _cap; }
+    bool wrapped() const { return _size == _cap; }
+    uint32_t oldest() const { return _size ? _newest - (_size - 1) * _period : _open ? _start : 0xffffffff; }
+
+    void read(uint32_t from, uint32_t to, Visitor &v) const override {
+      forEach(from, to, [&v](const HistoryBucket &b) { return v.visit(b); });
+    }
+
+    // buckets starting in [from, to), oldest first, the one still filling last ;
+    // f(const HistoryBucket &) returns false to stop
+    template <class F>
+    void forEach(uint32_t from, uint32_t to, F f) const {
+      int32_t v = _base;
+      for (size_t k = 0; k < _size; k++) {
+        size_t i = (_head + k) % _cap;
+        uint32_t start = _newest - (_size - 1 - k) * _period;
+        if (_delta[i] != GAP) v += _delta[i];
+        if (start < from) continue;
+        if (start >= to) return;
+        HistoryBucket b = { start, _delta[i] != GAP, v << _shift, v << _shift, v << _shift };
+        if (_spread) {
+          b.min = (v - _spread[2 * i]) << _shift;
+          b.max = (v + _spread[2 * i + 1]) << _shift;
+        }
+        if (!f(b)) return;
+      }
+      if (_open && _n && _start >= from && _start < to) {
+        HistoryBucket b = { _start, true, _roundDiv(_sum, _n), _min, _max };
+        f(b);
+      }
+    }
+
+  private:
+    int8_t *_delta;
+    uint8_t *_spread;
+    size_t _cap;
+    uint32_t _period;
+    uint8_t _shift;
+    Sink _sink;
+
+    // ring
+    size_t _head, _size;              // oldest bucket, bucket count
+    size_t _valid;                    // non-gap buckets in the ring
+    int32_t _base;                    // value before the oldest bucket [tier units]
+    int32_t _last;                    // value of the newest non-gap bucket
+    uint32_t _newest;                 // start of the newest bucket
+
+    // bucket being filled
+    bool _open;
+    uint32_t _start;
+    int32_t _sum, _min, _max;
+    uint16_t _n;
+
+    void _close();
+    void _push(uint32_t start, bool valid, int32_t avg, int32_t min, int32_t max);
+    int32_t _units(int32_t v16) const { return (v16 + ((1 << _shift) >> 1)) >> _shift; }
+    static int32_t _roundDiv(int32_t a, int32_t b) { return a >= 0 ? (a + b / 2) / b : (a - b / 2) / b; }
+};
+
+class History {
+  public:
+    static constexpr size_t TIERS = 3;
+
+    History();
+
+    void sample(uint32_t nowS, float celsius);   // each reading ; NaN or DEVICE_DISCONNECTED_C: none
+
+    const HistoryTier &tier(size_t i) const { return _tiers[i < TIERS ? i : TIERS - 1]; }
+    HistoryTier &tier(size_t i) { return _tiers[i < TIERS ? i : TIERS - 1]; }
+    const HistoryTier *tierFor(uint32_t periodS) const;  // nullptr if no tier has that resolution
+    const HistoryTier *finestSince(uint32_t from) const; // finest tier still holding `from`, if any
+
+  private:
+    int8_t _delta0[600];
+    int8_t _delta1[1440];
+    uint8_t _spread1[2 * 1440];
+    int8_t _delta2[672];
+    uint8_t _spread2[2 * 672];
+    HistoryTier _tiers[TIERS];
+};
+
+/*
+ * /history body, produced a piece at a time for a chunked response so that a
+ * day of buckets never sits in RAM as text. Whole rows only.
+ *
+ *   CSV      "# now=<s>,res=<s>" then "t,avg,min,max", °C, empty fields for gaps
+ *   BINARY   u8 version (1), u8 spread shift, u32 now, u32 res, u32 first start,
+ *            then per bucket i16 avg [1/16 °C] (-32768: gap), u8 below, u8 above
+ *            the average [1/16 °C << spread shift] ; little endian, buckets are
+ *            contiguous from the first start (missing ones sent as gaps)
+ */
+class HistoryStream {
+  public:
+    enum Format : uint8_t { CSV, BINARY };
+    static constexpr uint8_t VERSION = 1;
+
+    HistoryStream(const HistorySource &source, uint32_t from, uint32_t to, uint32_t nowS, Format format);
+
+    size_t fill(uint8_t *buf, size_t maxLen);   // 0 once done() or when not even a row fits
+    bool done() const { return _done; }
+
+  private:
+    const HistorySource &_source;
+    uint32_t _next, _to, _now;
+    Format _format;
+    bool _header;
+    bool _done;
+
+    size_t _writeHeader(uint8_t *out) const;
+    size_t _writeRow(uint8_t *out, const HistoryBucket &b) const;
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "hmac.h"
+#include "canon.h"
 
 void bin_to_hex_lower(const uint8_t *in, size_t len, char *out) {
   static const char hex[] = "0123456789abcdef";
@@ -9,25 +10,99 @@ void bin_to_hex_lower(const uint8_t *in, size_t len, char *out) {
   out[len*2] = '\0';
 }
 
-String compute_hmac_hex(const char *secret, const String &message) {
-  uint8_t mac[SHA256_HASH_SIZE];
-  hmac_sha256((const uint8_t*)secret, strlen(secret),
-              (const uint8_t*)message.c_str(), message.length(),
-              mac);
-  char hexbuf[SHA256_HASH_SIZE*2 + 1];
-  bin_to_hex_lower(mac, SHA256_HASH_SIZE, hexbuf);
-  return String(hexbuf);
-}
-
-bool hex_equals_ci(const String &a, const String &b) {
-  if (a.length() != b.length()) return false;
-  for (size_t i=0;i<a.length();i++) {
-    char ca = a.charAt(i);
-    char cb = b.charAt(i);
-    if (ca >= 'A' && ca <= 'F') ca = ca - 'A' + 'a';
-    if (cb >= 'A' && cb <= 'F') cb = cb - 'A' + 'a';
-    if (ca != cb) return false;
+static int hex_digit(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+bool hex_to_bin(const char *hex, size_t hexLen, uint8_t *out) {
+  if (hexLen % 2) return false;
+  for (size_t i=0;i<hexLen/2;i++) {
+    int hi = hex_digit(hex[2*i]), lo = hex_digit(hex[2*i+1]);
+    if (hi < 0 || lo < 0) return false;
+    out[i] = hi << 4 | lo;
   }
   return true;
 }
 
+bool digest_equals(const uint8_t *a, const uint8_t *b, size_t len) {
+  uint8_t diff = 0;
+  for (size_t i=0;i<len;i++) diff |= a[i] ^ b[i];
+  return !diff;
+}
+
+// ---- keyed contexts ----
+
+void HmacKey::begin(const uint8_t *key, size_t len) {
+  uint8_t block[SHA256_BLOCK_SIZE] = { 0 };
+  if (len > SHA256_BLOCK_SIZE) {
+    sha256_ctx t;
+    sha256_init(&t);
+    sha256_update(&t, key, len);
+    sha256_final(&t, block);
+  } else {
+    memcpy(block, key, len);
+  }
+
+  for (size_t i=0;i<SHA256_BLOCK_SIZE;i++) block[i] ^= 0x36;
+  sha256_init(&_inner);
+  sha256_update(&_inner, block, SHA256_BLOCK_SIZE);
+  for (size_t i=0;i<SHA256_BLOCK_SIZE;i++) block[i] ^= 0x36 ^ 0x5c;
+  sha256_init(&_outer);
+  sha256_update(&_outer, block, SHA256_BLOCK_SIZE);
+  memset(block, 0, sizeof(block));
+}
+
+void HmacContext::final(uint8_t mac[SHA256_HASH_SIZE]) {
+  uint8_t inner[SHA256_HASH_SIZE];
+  sha256_final(&_ctx, inner);
+  sha256_ctx outer = _key._outer;
+  sha256_update(&outer, inner, SHA256_HASH_SIZE);
+  sha256_final(&outer, mac);
+}
+
+bool verifyFrameHMAC(const HmacKey &key, const uint8_t *frame, size_t len) {
+  static const char FIELD[] = ",\"hmac:";
+  const size_t head = sizeof(FIELD) - 1;
+  const size_t field = head + 2 * SHA256_HASH_SIZE + 1;   // then the hex digits and '"'
+
+  size_t pos = 0;
+  for (;; pos++) {
+    if (pos + field > len) return false;
+    if (!memcmp(frame + pos, FIELD, head)) break;
+  }
+  uint8_t provided[SHA256_HASH_SIZE];
+  if (frame[pos + field - 1] != '"' ||
+      !hex_to_bin((const char *)frame + pos + head, 2 * SHA256_HASH_SIZE, provided)) return false;
+
+  uint8_t mac[SHA256_HASH_SIZE];
+  HmacContext ctx(key);
+  ctx.update(frame, pos);
+  ctx.update(frame + pos + field, len - pos - field);
+  ctx.final(mac);
+  return digest_equals(mac, provided, SHA256_HASH_SIZE);
+}
+
+static bool verifyCanonHMAC(const HmacKey &key, const Canon &canon) {
+  uint8_t provided[SHA256_HASH_SIZE];
+  if (canon.hmacLength() != 2 * SHA256_HASH_SIZE ||
+      !hex_to_bin(canon.hmac(), canon.hmacLength(), provided)) return false;
+
+  uint8_t mac[SHA256_HASH_SIZE];
+  HmacContext ctx(key);
+  canon.write(ctx);
+  ctx.final(mac);
+  return digest_equals(mac, provided, SHA256_HASH_SIZE);
+}
+
+bool verifyJsonHMAC(const HmacKey &key, const char *json, size_t len) {
+  Canon canon;
+  return canon.parseJson(json, len) && verifyCanonHMAC(key, canon);
+}
+
+bool verifyQueryHMAC(const HmacKey &key, const char *qs, size_t len) {
+  Canon canon;
+  return canon.parseQuery(qs, len) && verifyCanonHMAC(key, canon);
+}
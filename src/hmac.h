@@ -4,30 +4,59 @@
 #include <Arduino.h>
 #include "sha256.h"
 
+// ---- Keyed contexts ----
+
+// A fixed key's HMAC-SHA256 inner and outer midstates, computed once: a
+// message then costs its own blocks plus one for the outer hash, instead of
+// two more compressions to re-derive the pads on every call.
+class HmacKey {
+  public:
+    HmacKey() {}
+    explicit HmacKey(const char *secret) { begin(secret); }
+
+    void begin(const uint8_t *key, size_t len);
+    void begin(const char *secret) { begin((const uint8_t *)secret, strlen(secret)); }
+
+  private:
+    sha256_ctx _inner, _outer;     // after the ipad / opad block
+    friend class HmacContext;
+};
+
+// one message, fed in as many pieces as needed
+class HmacContext {
+  public:
+    explicit HmacContext(const HmacKey &key) : _key(key), _ctx(key._inner) {}
+    void update(const uint8_t *data, size_t len) { sha256_update(&_ctx, data, len); }
+    void final(uint8_t mac[SHA256_HASH_SIZE]);
+
+  private:
+    const HmacKey &_key;
+    sha256_ctx _ctx;
+};
+
+// Websocket frame as client.py signs it, ["cmd",...,"hmac:<64 hex>"]: the MAC
+// covers the frame without its ,"hmac:..." element, which is skipped in place.
+// False without that element, with bad hex or a wrong MAC.
+bool verifyFrameHMAC(const HmacKey &key, const uint8_t *frame, size_t len);
+
 // ---- Low-level helpers ----
 
 // Convert binary to lowercase hex string (out buffer must be 2*len+1)
 void bin_to_hex_lower(const uint8_t *in, size_t len, char *out);
 
-// Compute HMAC-SHA256(secret, message), return lowercase hex string
-String compute_hmac_hex(const char *secret, const String &message);
+// Hex (either case) to bytes, out holds hexLen/2 ; false on an odd length or a non-hex digit
+bool hex_to_bin(const char *hex, size_t hexLen, uint8_t *out);
 
-// Case-insensitive hex comparison (constant-time)
-bool hex_equals_ci(const String &a, const String &b);
+// Constant-time comparison: the time taken does not depend on where a and b differ
+bool digest_equals(const uint8_t *a, const uint8_t *b, size_t len);
 
 // ---- Verification helpers ----
 
-// Verify HMAC for a JSON string ({"a":1,"b":2,"hmac":"..."})
-bool verifyJsonHMAC(const String &json, const char *secret);
-
-// Verify HMAC for a query string (a=1&b=2&hmac=...)
-bool verifyQueryHMAC(const String &qs, const char *secret);
+// Verify HMAC for a JSON string ({"a":1,"b":2,"hmac":"..."}) over its canonical form (canon.h)
+bool verifyJsonHMAC(const HmacKey &key, const char *json, size_t len);
 
-// If AsyncWebServer is used: verify GET/POST params
-#ifdef ASYNCWEBSERVER_H_INCLUDED
-#include <ESPAsyncWebServer.h>
-bool verifyRequestHMAC(AsyncWebServerRequest *request, const char *secret);
-#endif
+// Verify HMAC for a query string (a=1&b=2&hmac=...) over its canonical form (canon.h)
+bool verifyQueryHMAC(const HmacKey &key, const char *qs, size_t len);
 
 #endif // HMAC_H
 
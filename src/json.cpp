@@ -1,122 +1,200 @@
 #include <Arduino.h>
 
-// TODO: more precision in floats! (at least 2 decimals, possibly configurable)
-// TODO: return true/false instead of 1.000 or 0.000 when applicable
+/*
+ * Flat JSON object builder over a fixed buffer: no heap, no snprintf.
+ *
+ * Numbers are printed in fixed point (3 decimals by default, per call
+ * otherwise) from float: one single-precision multiply, then 32-bit integer
+ * arithmetic unless the scaled value needs more. Bools as true/false. A field
+ * that does not fit is never written in part: with a sink set, the frame
+ * built so far is handed over and the field opens a new frame ; without one
+ * the field is dropped and overflowed() tells.
+ */
 class JsonBuilder {
 public:
-  JsonBuilder() { clear(); }
+  typedef void (*Sink)(const char *frame, size_t len);
+  static constexpr size_t CAPACITY = 384;
+  static constexpr uint8_t MAX_DECIMALS = 6;
+
+  JsonBuilder() : sink(nullptr) { clear(); }
+
+  // where frames go when a field would not fit (sendJson() in main.cpp)
+  void onOverflow(Sink s) { sink = s; }
 
   void clear() {
-    pos = snprintf(buffer, sizeof(buffer), "{");
+    buffer[0] = '{';
+    pos = 1;
     first = true;
+    overflow = false;
+  }
+
+  // --- Single numeric, bool or enum ---
+  template <typename T>
+  typename std::enable_if<std::is_floating_point<T>::value>::type
+  addValue(const char *key, T value, uint8_t decimals = 3) {
+    field(key, [&]() { return putFixed(value, decimals); });
   }
 
-  // --- Single numeric or enum ---
   template <typename T>
-  typename std::enable_if<std::is_arithmetic<T>::value || std::is_enum<T>::value>::type
+  typename std::enable_if<(std::is_integral<T>::value && !std::is_same<T, bool>::value) || std::is_enum<T>::value>::type
   addValue(const char *key, T value) {
-    if (!first) pos += snprintf(buffer + pos, sizeof(buffer) - pos, ",");
-    pos += snprintf(buffer + pos, sizeof(buffer) - pos,
-                    "\"%s\":%.3f", key, static_cast<double>(value));
-    first = false;
+    field(key, [&]() { return putInt((long long)value); });
+  }
+
+  void addValue(const char *key, bool value) {
+    field(key, [&]() { return putRaw(value ? "true" : "false"); });
   }
 
   // --- Single string ---
   void addValue(const char *key, const char *value) {
-    if (!first) pos += snprintf(buffer + pos, sizeof(buffer) - pos, ",");
-    pos += snprintf(buffer + pos, sizeof(buffer) - pos,
-                    "\"%s\":\"%s\"", key, value);
-    first = false;
+    field(key, [&]() { return putString(value); });
   }
   void addValue(const char *key, const String &value) { addValue(key, value.c_str()); }
 
-  // --- Array of numeric/enums ---
+  // --- Array of numeric/bools/enums ---
   template <typename T, size_t N>
-  void addValue(const char *key, T (&arr)[N]) {
-    if (!first) pos += snprintf(buffer + pos, sizeof(buffer) - pos, ",");
-    pos += snprintf(buffer + pos, sizeof(buffer) - pos, "\"%s\":[", key);
-    for (size_t i = 0; i < N; i++) {
-      pos += snprintf(buffer + pos, sizeof(buffer) - pos,
-                      (i < N - 1) ? "%d," : "%d", static_cast<int>(arr[i]));
-    }
-    pos += snprintf(buffer + pos, sizeof(buffer) - pos, "]");
-    first = false;
+  void addValue(const char *key, T (&arr)[N], uint8_t decimals = 3) {
+    addValue(key, (const T *)arr, N, decimals);
+  }
+
+  template <typename T>
+  void addValue(const char *key, const T *arr, size_t count, uint8_t decimals = 3) {
+    field(key, [&]() {
+      if (!put('[')) return false;
+      for (size_t i = 0; i < count; i++) {
+        if (i && !put(',')) return false;
+        if (!putAny(arr[i], decimals)) return false;
+      }
+      return put(']');
+    });
   }
 
   // --- Array of floats from function pointer ---
-  void addValue(const char *key, size_t count, float (*func)(size_t)) {
-    if (!first) pos += snprintf(buffer + pos, sizeof(buffer) - pos, ",");
-    pos += snprintf(buffer + pos, sizeof(buffer) - pos, "\"%s\":[", key);
-    for (size_t i = 0; i < count; i++) {
-      float val = func(i);
-      pos += snprintf(buffer + pos, sizeof(buffer) - pos,
-                      (i < count - 1) ? "%.2f," : "%.2f", val);
-    }
-    pos += snprintf(buffer + pos, sizeof(buffer) - pos, "]");
-    first = false;
+  void addValue(const char *key, size_t count, float (*func)(size_t), uint8_t decimals = 2) {
+    field(key, [&]() {
+      if (!put('[')) return false;
+      for (size_t i = 0; i < count; i++) {
+        if (i && !put(',')) return false;
+        if (!putFixed(func(i), decimals)) return false;
+      }
+      return put(']');
+    });
   }
 
   const char* finish() {
-    snprintf(buffer + pos, sizeof(buffer) - pos, "}");
+    buffer[pos] = '}';
+    buffer[pos + 1] = '\0';
     return buffer;
   }
 
+  size_t length() const { return pos + 1; }   // of the finished frame
+
   bool hasValues() const {
     return !first;  // false if nothing added yet
   }
 
+  bool overflowed() const { return overflow; }
+
 private:
-  char buffer[256];
+  char buffer[CAPACITY];
   size_t pos;
   bool first;
-};
+  bool overflow;
+  Sink sink;
+
+  // writes stop 2 bytes short of the end: room for the closing '}' and '\0'
+  bool put(char c) {
+    if (pos >= CAPACITY - 2) return false;
+    buffer[pos++] = c;
+    return true;
+  }
 
+  bool putRaw(const char *s) {
+    while (*s) {
+      if (!put(*s++)) return false;
+    }
+    return true;
+  }
 
+  bool putString(const char *s) {
+    if (!put('"')) return false;
+    for (; *s; s++) {
+      if ((*s == '"' || *s == '\\') && !put('\\')) return false;
+      if (!put((unsigned char)*s < 0x20 ? ' ' : *s)) return false;
+    }
+    return put('"');
+  }
 
-/*
- * Allows the use of a json string as it it were a set of POST/GET parameters
- */
-#include <ArduinoJson.h>
-#include <ESPAsyncWebServer.h>
+  // in the type it is given: uint32_t keeps to 32-bit division, much cheaper
+  // than 64-bit on the ESP8266
+  template <typename U>
+  bool putUint(U v, uint8_t minDigits = 1) {
+    char digits[20];
+    uint8_t n = 0;
+    do {
+      digits[n++] = '0' + v % 10;
+      v /= 10;
+    } while (v || n < minDigits);
+    while (n) {
+      if (!put(digits[--n])) return false;
+    }
+    return true;
+  }
 
-class MockParam : public AsyncWebParameter {
-public:
-    MockParam(const String &name, const String &value)
-        : AsyncWebParameter(name, value) {}
-};
+  bool putInt(long long v) {
+    unsigned long long u = v < 0 ? -(unsigned long long)v : v;
+    if (v < 0 && !put('-')) return false;
+    return u <= 0xffffffffULL ? putUint((uint32_t)u) : putUint(u);
+  }
 
-class MockRequest {
-public:
-    AsyncWebSocketClient *client = nullptr;
-    struct Param {
-        String name;
-        String value;
-    };
-    std::vector<Param> params;
-
-    bool hasParam(const String &name) const {
-	Serial.println("hasParam() ?");
-        for (auto &p : params)
-	{
-	    Serial.printf("hasParam(): %s\n",p.name);
-            if (p.name == name) return true;
-	}
-        return false;
+  bool putFixed(float v, uint8_t decimals) {
+    static const uint32_t scales[MAX_DECIMALS + 1] = { 1, 10, 100, 1000, 10000, 100000, 1000000 };
+    if (decimals > MAX_DECIMALS) decimals = MAX_DECIMALS;
+    // NaN, infinities and what would not fit 64 bits scaled: not representable in JSON anyway
+    if (!(v > -1e12f && v < 1e12f)) return putRaw("null");
+
+    uint32_t scale = scales[decimals];
+    float a = (v < 0 ? -v : v) * scale + .5f;
+    if (a < 4294967296.0f) {
+      // telemetry values always land here: one float multiply, then 32-bit integers
+      uint32_t m = (uint32_t)a;
+      if (v < 0 && m && !put('-')) return false;
+      if (!putUint(m / scale)) return false;
+      if (!decimals) return true;
+      return put('.') && putUint(m % scale, decimals);
     }
+    unsigned long long m = (unsigned long long)a;
+    if (v < 0 && !put('-')) return false;
+    if (!putUint(m / scale)) return false;
+    if (!decimals) return true;
+    return put('.') && putUint((uint32_t)(m % scale), decimals);
+  }
 
-    MockParam* getParam(const String &name) const {
-        for (auto &p : params)
-            if (p.name == name)
-                return new MockParam(p.name, p.value);
-        return nullptr;
-    }
+  template <typename T>
+  typename std::enable_if<std::is_floating_point<T>::value, bool>::type
+  putAny(T v, uint8_t decimals) { return putFixed(v, decimals); }
 
-    void send(int code, const String &type, const String &content) {
-      // TODO: there are some things we may want to broadcast...
-      if (client) {
-          client->text(content);
-      } else {
-          Serial.printf("[MockRequest] send(%d): %s\n", code, content.c_str());
+  template <typename T>
+  typename std::enable_if<!std::is_floating_point<T>::value, bool>::type
+  putAny(T v, uint8_t) {
+    if (std::is_same<T, bool>::value) return putRaw(v ? "true" : "false");
+    return putInt((long long)v);
+  }
+
+  // "key":<value> as a whole or not at all
+  template <typename W>
+  void field(const char *key, W writeValue) {
+    for (;;) {
+      size_t mark = pos;
+      if ((first || put(',')) && put('"') && putRaw(key) && put('"') && put(':') && writeValue()) {
+        first = false;
+        return;
       }
+      pos = mark;
+      if (!sink || first) break;       // alone in its frame and still too big
+      sink(finish(), length());
+      clear();
     }
+    overflow = true;
+  }
 };
@@ -3,8 +3,5 @@
 
 #include <Arduino.h>
 
-bool verifyJsonHMAC(const String &json, const char *secret);
-bool verifyQueryHMAC(const String &qs, const char *secret);
-
 #endif
 
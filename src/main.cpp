@@ -20,8 +20,20 @@
 #include <LittleFS.h>
 #include <network.h>
 #include "hmac.h"
-#include "canon.h"
 #include "json.h"
+#include "tempsensors.h"
+#include "scheduler.h"
+#include "stager.h"
+#include "ssr_window.h"
+#include "sigma_delta.h"
+#include "triac.h"
+#include "telemetry.h"
+#include "telemetry_frame.h"
+#include "history.h"
+#include "flashlog.h"
+#include "assets.h"
+#include "commands.h"
+#include "door.h"
 #include <ArduinoJson.h>
 
 #define RELAY_OPEN HIGH
@@ -29,20 +41,31 @@
 
 // for HMAC verification
 const char *secret = "my_secret_seed";
+HmacKey hmacKey(secret);   // midstates of the secret, for every signed message
 
 // this will enable serial debugging output ; number is index of prefered relay in relayPins (MUST NOT be on RX or TX)
 #define SINGLEPHASE_TESTMODE 0
 
 // do we have a PS-VM-RD unit attached?
 #define FEATURES_PSVMRD
+// scan it at 1 kHz instead of 250 Hz (not yet confirmed to leave WiFi enough time)
+//#define PSVMRD_FAST_SCAN
 
 // are we using slow electromechanical relays?
 //#define ELECTROMECHANICAL
 // should we use some time-window-based PWM (NOT for electromechanical relays!)
 #define STAGED_SSRs
-// do we have fast (cycle-precision with zero-passing detection) TRIAC phase control? TODO
+// with STAGED_SSRs: spread on-cycles evenly over mains cycles (sigma-delta) rather than one pulse per window
+//#define SIGMADELTA_SSRs
+// with SIGMADELTA_SSRs: a zero-crossing detector on ZERO_CROSS paces the cycles (whole cycles, no DC)
+//#define SIGMADELTA_ZERO_CROSS
+// do we have fast (cycle-precision with zero-passing detection) TRIAC phase control?
 //#define SMOOTH_TRIAC
 
+#if defined(STAGED_SSRs) || defined(SMOOTH_TRIAC)
+#define MODULATED_OUTPUTS // outputs follow relayDutyCycles through relayOutput
+#endif
+
 
 #define TEMP_ABSMAX 125 // target temperature may NEVER be set above this point
 #define TEMP_ERROR -127.0
@@ -62,6 +85,9 @@ constexpr size_t RELAY_COUNT = 1;
 //#define RAON		D2
 #define RELAY1 		D3
 #define	DOOR_SW		D4	// NOTE: when on D4, door MUST be open for flashing!!
+#if defined(SMOOTH_TRIAC) || defined(SIGMADELTA_ZERO_CROSS)
+#define ZERO_CROSS	D6	// zero-crossing detector (SDO of the PS-VM-RD header is not used)
+#endif
 
 #ifndef SINGLEPHASE_TESTMODE
 // on TX/RX
@@ -78,9 +104,12 @@ constexpr size_t RELAY_COUNT = 1;
 OneWire oneWire(ONE_WIRE_BUS);
 DallasTemperature sensors(&oneWire);
 DeviceAddress sensor0, sensor1;
+AsyncTempSensors tempReader(sensors, sensor0, sensor1);
 
 AsyncWebServer server(80);
 AsyncWebSocket ws("/ws");
+// web UI built by tools/build_assets.py: gzipped, hashed names, ETags (see assets.h)
+AssetHandler assets(LittleFS);
 
 // PID setup
 double Setpoint = 75.0, Input = 0, Output = 0, Ambiant = 0;
@@ -95,18 +124,40 @@ PID myPID(&Input, &Output, &Setpoint, Kp, Ki, Kd, DIRECT);
 // Time-proportional control
 #ifdef STAGED_SSRs
 const unsigned long windowSize = 10000; // 10 seconds
-unsigned long windowStartTime = 0;
 #endif
+#ifdef SIGMADELTA_SSRs
+const unsigned long mainsCycle = 20;    // [ms] 50 Hz ; free-running unless SIGMADELTA_ZERO_CROSS
+#endif
+#ifdef SMOOTH_TRIAC
+const unsigned int mainsFrequency = 50; // [Hz]
+#endif
+
 
+// Control loop: cooperative tasks with their own cadence (see startTasks())
+Scheduler sched;
+const unsigned long LOOP_IDLE_MAX = 5; // [ms] longest loop() may sleep between task runs
+void startTasks();
+void sendJson(const char *frame, size_t len);
 
 // Relay control
 bool enabled = false;
 bool door_is_open;
-unsigned long lastSend = 0;
 #ifndef SINGLEPHASE_TESTMODE
 const int relayPins[RELAY_COUNT] = { RELAY1, RELAY2, RELAY3 };
+constexpr float relayWatts[RELAY_COUNT] = { 1500, 3000, 1500 };  // [W] only the ratios matter
 #else
 const int relayPins[RELAY_COUNT] = { RELAY1 };
+constexpr float relayWatts[RELAY_COUNT] = { 1500 };
+#endif
+constexpr auto relayStages = makeStagingTable(relayWatts);
+#if defined(SMOOTH_TRIAC)
+TriacPhaseControl relayOutput(relayPins, RELAY_COUNT, ZERO_CROSS, mainsFrequency, RELAY_CLOSED);  // owns the relay pins
+#elif defined(SIGMADELTA_SSRs) && defined(SIGMADELTA_ZERO_CROSS)
+SsrSigmaDelta relayOutput(relayPins, RELAY_COUNT, mainsCycle, RELAY_CLOSED, ZERO_CROSS);  // owns the relay pins
+#elif defined(SIGMADELTA_SSRs)
+SsrSigmaDelta relayOutput(relayPins, RELAY_COUNT, mainsCycle, RELAY_CLOSED);  // owns the relay pins
+#elif defined(STAGED_SSRs)
+SsrWindow relayOutput(relayPins, RELAY_COUNT, windowSize, RELAY_CLOSED);      // owns the relay pins
 #endif
 enum RelayModes { RELAY_OFF, RELAY_PID, RELAY_ON };
 RelayModes relayModes[RELAY_COUNT] = {};
@@ -123,31 +174,64 @@ RelayStates lastRelayStates[RELAY_COUNT] = {};
     #endif
   #endif
 #else
-  unsigned long relayDutyCycles[RELAY_COUNT] = {};
+  float relayDutyCycles[RELAY_COUNT] = {};
   #ifdef STAGED_SSRs
     #ifdef SMOOTH_TRIAC
       "only one of ELECTROMECHANICAL, STAGED_SSRs or SMOOTH_TRIAC may be enabled"
     #endif
   #endif
 #endif
+#if defined(SIGMADELTA_SSRs) && !defined(STAGED_SSRs)
+  "SIGMADELTA_SSRs only changes how STAGED_SSRs modulates"
+#endif
 
-#include <json.cpp>
-JsonBuilder jb;
+// Door: opening it cuts every output from the switch interrupt (see door.h)
+const unsigned long DOOR_HOLDOFF_MS = 5000; // heating stays off this long after the door closed
+const bool DOOR_AUTO_RESUME = true;         // false: opening the door disables, until "enable"
+DoorSwitch door(DOOR_SW, HIGH);             // high when open (pull-up, the switch grounds it)
+bool doorHold = false;                      // door open or in its hold-off: no heating
+unsigned long doorClosedAt;
+
+void IRAM_ATTR doorCutoff() {
+#ifdef MODULATED_OUTPUTS
+  relayOutput.cutoff();
+#else
+  for (size_t i = 0; i < RELAY_COUNT; i++) {
+    digitalWrite(relayPins[i], RELAY_OPEN);
+  }
+#endif
+}
 
+// also true between the interrupt and doorTask()
+bool heatingHeld() {
+  return doorHold || door.tripped();
+}
 
-// Helper to strip "hmac" field from JSON and return the remaining JSON
-bool strip_hmac_field(String &json, String &provided_hmacHex) {
-    int hmacPos = json.indexOf("\"hmac:");
-    if (hmacPos < 0) return false;  // no hmac field found
+#include <json.cpp>
+TelemetryFrame broadcast;  // whatever is set within a tick goes out as one frame (flushTask)
+TelemetryFrame latest;     // every field as last set: what a client that fell behind is owed
+FrameClients wsClients;    // JSON or binary, and outbound queue state, per websocket client
+JsonBuilder jb;            // broadcast frames rendered for JSON clients
+AsyncWebSocketClient *jbClient;   // the client jb is being rendered for (sendJson)
+bool jbSplit;                     // jb overflowed: what is left in it is only a tail
+JsonBuilder reply;         // answers to a single client
+
+// telemetry is sent on change only, with a full keyframe every 30 s
+Telemetry telemetry(30000);
+Deadband tPid(.05), tTemp(.1), tAmbiant(.2);
+#ifdef MODULATED_OUTPUTS
+DeadbandArray<RELAY_COUNT> tDutyCycles(.05);
+#endif
+#ifdef FEATURES_PSVMRD
+DeadbandArray<NUM_CHANNELS> tVoltages(2.);
+#endif
+
+// sauna temperature, 1 s / 1 min / 15 min resolution (see history.h), served on /history
+History history;
+// minutes and events kept over reboots (see flashlog.h) ; its clock is the history's
+FlashLog flashLog(LittleFS);
 
-    // Extract HMAC value
-    provided_hmacHex = json.substring(hmacPos + 6, hmacPos + 70);
-    //Serial.print("provided_hmacHex: ");
-    //Serial.println(provided_hmacHex);
 
-    json.remove(hmacPos-1, 72);
-    return true;
-}
 
 /*
 void saveValueToEEPROM(int save_where, double val) {
@@ -170,168 +254,209 @@ void loadRelayModes() {
   // TODO
 }
 
-void process_validated_request(AsyncWebServerRequest *request)
-{
-    if (request->hasParam("target")) {
-      String val = request->getParam("target")->value();
-      double newTarget = val.toFloat();
-      if (newTarget > 0 && newTarget < TEMP_ABSMAX) {
-        Setpoint = newTarget;
-	      jb.addValue( "target", Setpoint);
-        ws.textAll(jb.finish());
-        request->send(200, "text/plain", "Target set to " + String(Setpoint,1));
-        Serial.println("New Setpoint: " + String(Setpoint));
-      } else {
-        request->send(400, "text/plain", "Invalid value");
-      }
-      if (request->hasParam("save")) EEPROM.put(ADDR_SETPOINT, Setpoint);
-    }
-    if (request->hasParam("relay")) {
-      String msg = request->getParam("relay")->value(); // <-- declare msg here
+// ---- commands (see commands.h) ----
+// from the websocket (plain or signed JSON) and /set alike ; value changes are
+// broadcast with the next flush, queries answered to the sender only
+
+struct CommandContext {
+  enum { SETPOINT = 1, RELAY_MODES = 2 };
+  uint8_t changed = 0;   // what "save" writes to EEPROM
+  bool save = false;
+};
+
+bool cmdEnable(const Command &, CommandContext *) {
+  enabled = true;
+  broadcast.set(TelemetryFrame::ENABLED, true);
+  flashLog.event(FlashLog::ENABLED, 1);
+  return true;
+}
 
-      size_t r = msg.substring(6, 7).toInt() - 1;
-      String mode = msg.substring(8);
+bool cmdDisable(const Command &, CommandContext *) {
+  enabled = false;
+  broadcast.set(TelemetryFrame::ENABLED, false);
+  flashLog.event(FlashLog::ENABLED, 0);
+  return true;
+}
 
-      if (r >= 0 && r < RELAY_COUNT) {
-        if (mode == "on") relayModes[r] = RELAY_ON;
-        else if (mode == "off") relayModes[r] = RELAY_OFF;
-        else if (mode == "pid") relayModes[r] = RELAY_PID;
+// target:<°C>
+bool cmdTarget(const Command &cmd, CommandContext *ctx) {
+  float t;
+  if (!cmd.arg(0).toFloat(t) || t <= 0 || t >= TEMP_ABSMAX) return false;
+  Setpoint = t;
+  broadcast.set(TelemetryFrame::TARGET, Setpoint);
+  flashLog.event(FlashLog::TARGET, lround(Setpoint * 16));
+  ctx->changed |= CommandContext::SETPOINT;
+  return true;
+}
 
-        if (request->hasParam("save")) EEPROM.put(ADDR_RELAYMODES, relayModes);
+// relay:<1..RELAY_COUNT>:on|off|pid
+bool cmdRelay(const Command &cmd, CommandContext *ctx) {
+  uint32_t r;
+  if (!cmd.arg(0).toUInt(r) || r < 1 || r > RELAY_COUNT) return false;
+  const CommandArg &mode = cmd.arg(1);
+  if (mode.equals("on")) relayModes[r - 1] = RELAY_ON;
+  else if (mode.equals("off")) relayModes[r - 1] = RELAY_OFF;
+  else if (mode.equals("pid")) relayModes[r - 1] = RELAY_PID;
+  else return false;
+  broadcast.set(TelemetryFrame::RELAY_MODES, relayModes);
+  ctx->changed |= CommandContext::RELAY_MODES;
+  return true;
+}
 
-        jb.addValue("relayModes", relayModes);
-        ws.textAll(jb.finish());
-      }
-    }
-    if (request->hasParam("save")) EEPROM.commit();
+// persist what this batch changes, whatever the order
+bool cmdSave(const Command &, CommandContext *ctx) {
+  ctx->save = true;
+  return true;
+}
+
+bool cmdEnabled(const Command &, CommandContext *) { reply.addValue("enabled", enabled); return true; }
+bool cmdAmbiant(const Command &, CommandContext *) { reply.addValue("ambiant", Ambiant, 2); return true; }
+bool cmdTemp(const Command &, CommandContext *) { reply.addValue("temp", Input, 2); return true; }
+bool cmdDoor(const Command &, CommandContext *) { reply.addValue("door", door_is_open ? "open" : "closed"); return true; }
+
+bool cmdRelays(const Command &, CommandContext *) {
+  reply.addValue("relayModes", relayModes);
+#ifdef MODULATED_OUTPUTS
+  reply.addValue("relayDutyCycles", relayDutyCycles);
+#else
+  reply.addValue("relayStates", relayStates);
+#endif
+  return true;
 }
 
+#ifdef FEATURES_PSVMRD
+bool cmdVoltages(const Command &, CommandContext *) {
+  getVoltages(volts);
+  reply.addValue("voltages", volts, 1);
+  return true;
+}
+#endif
+
+//                                                 verb   args  handler
+static constexpr CommandVerb<CommandContext *> COMMANDS[] = {
+  { "ambiant",  0, cmdAmbiant },
+  { "disable",  0, cmdDisable },
+  { "door",     0, cmdDoor },
+  { "enable",   0, cmdEnable },
+  { "enabled",  0, cmdEnabled },
+  { "relay",    2, cmdRelay },
+  { "relays",   0, cmdRelays },
+  { "save",     0, cmdSave },
+  { "target",   1, cmdTarget },
+  { "temp",     0, cmdTemp },
+#ifdef FEATURES_PSVMRD
+  { "voltages", 0, cmdVoltages },
+#endif
+};
+static_assert(commandsSorted(COMMANDS), "COMMANDS must be sorted by verb");
+
+// false when a command is unknown or refused (the others still run) or the batch was cut short
+void saveCommanded(const CommandContext &ctx) {
+  if (ctx.save && ctx.changed) {
+    if (ctx.changed & CommandContext::SETPOINT) EEPROM.put(ADDR_SETPOINT, Setpoint);
+    if (ctx.changed & CommandContext::RELAY_MODES) EEPROM.put(ADDR_RELAYMODES, relayModes);
+    EEPROM.commit();
+  }
+}
+
+bool runCommands(const CommandBatch &batch) {
+  CommandContext ctx;
+  bool ok = !batch.overflowed();
+  for (size_t i = 0; i < batch.size(); i++) {
+    ok &= dispatchCommand(COMMANDS, batch[i], &ctx);
+  }
+  saveCommanded(ctx);
+  return ok;
+}
+
+// a plain websocket frame: parsed in place, nothing copied
+bool runCommand(const Command &cmd) {
+  CommandContext ctx;
+  bool ok = dispatchCommand(COMMANDS, cmd, &ctx);
+  saveCommanded(ctx);
+  return ok;
+}
+
+// /set?target=72.5&relay=2:pid&save: the parameters, in order, as name:value
+void addCommands(CommandBatch &batch, AsyncWebServerRequest *request) {
+  for (size_t i = 0; i < request->params(); i++) {
+    const AsyncWebParameter *p = request->getParam(i);
+    batch.add(p->name().c_str(), p->name().length(), p->value().c_str(), p->value().length());
+  }
+}
+
+#ifdef SINGLEPHASE_TESTMODE
+// ["target:72.5","relay:2:pid","hmac:…"], as signed by client.py
+void addCommands(CommandBatch &batch, JsonArrayConst commands) {
+  for (JsonVariantConst v : commands) {
+    const char *text = v.as<const char *>();
+    if (!text) text = "";    // not a command: fails the batch
+    if (strncmp(text, "hmac:", 5)) batch.add(text, strlen(text));
+  }
+}
+#endif
 
 void handleWebSocketMessage(void *arg, uint8_t *data, size_t len, AsyncWebSocketClient *client) {
   AwsFrameInfo *info = (AwsFrameInfo*)arg;
   if (info->final && info->index == 0 && info->len == len && info->opcode == WS_TEXT) {
-    String msg;
-    for (size_t i = 0; i < len; i++) {
-      msg += (char)data[i];
+    // points into the frame, valid for this call
+    Command cmd;
+    bool parsed = cmd.parse(data, len);
+
+    // frame format negotiation, right after connecting (see telemetry_frame.h): not a command
+    if (parsed && cmd.verb.equals("proto")) {
+      bool binary = cmd.argc() == 1 && cmd.arg(0).equals("bin1");   // anything else, e.g. a later version: JSON
+      if (!wsClients.setBinary(client->id(), binary)) binary = false;   // not registered: say what it gets
+      reply.addValue("proto", binary ? "bin1" : "json");
+      client->text(reply.finish(), reply.length());
+      reply.clear();
+      telemetry.requestKeyframe();
+      return;
     }
-#ifdef SINGLEPHASE_TESTMODE
-    Serial.println("Received WebSocket message: " + msg);
-
-    // Step 1 & 2: Extract HMAC and remove it
-    String provided_hmacHex;
-    if (!strip_hmac_field(msg, provided_hmacHex)) { return; }
-
-    //Serial.println("Extracted HMAC: " + provided_hmacHex);
-    //Serial.println("JSON without HMAC: " + msg);
 
-    // Step 3: Canonicalize and recompute new HMAC
-    /*
-    KV kvs[MAX_KV];
-    String dummy;
-    size_t n = parseJsonToKVs(msg, kvs, MAX_KV, dummy);
-    sortKVs(kvs, n);
-    String canonical = buildCanonical(kvs, n);
-    */
-
-    String recomputed_hmac = compute_hmac_hex(secret, msg);
-    //Serial.println("Recomputed HMAC: " + recomputed_hmac);
+#ifdef SINGLEPHASE_TESTMODE
+    Serial.print("Received WebSocket message: ");
+    Serial.write(data, len);
+    Serial.println();
 
-    // Step 4: Compare
-    if (!hex_equals_ci(provided_hmacHex, recomputed_hmac)) {
+    // signed by client.py: checked in place, against the key's precomputed midstates
+    if (!verifyFrameHMAC(hmacKey, data, len)) {
       Serial.println("❌ HMAC verification FAILED");
-    } else {
-      //Serial.println("✅ HMAC verified successfully");
       return;
     }
 
     StaticJsonDocument<256> doc;
-    if (deserializeJson(doc, msg)) {
+    if (deserializeJson(doc, (const char *)data, len)) {
         Serial.println("❌ JSON parse error");
         return;
     }
-
-    MockRequest request;
-    request.client = client;
-    for (JsonPair kv : doc.as<JsonObject>()) {
-        request.params.push_back({ kv.key().c_str(), kv.value().as<String>() });
-    }
-
-    // Call existing parser for WS message
-    process_validated_request(reinterpret_cast<AsyncWebServerRequest*>(&request));
-
-#endif
-    // broadcast value changes
-    if (msg == "enable") {
-      enabled = true;
-      jb.addValue("enabled", true);
-      ws.textAll(jb.finish());
-
-    } else if (msg == "disable") {
-      enabled = false;
-      jb.addValue("enabled", false);
-      jb.addValue("pid", 0); // kinda dirty hack for code simplicity
-      ws.textAll(jb.finish());
-
-    } else if (msg.startsWith("target:")) {
-      Setpoint = msg.substring(7).toFloat();
-      jb.addValue("target", Setpoint);
-      ws.textAll(jb.finish());
-
-    } else if (msg.startsWith("relay:")) {
-      size_t r = msg.substring(6,7).toInt() - 1; // relay index 0..2
-      String mode = msg.substring(8);
-      if (r >= 0 && r < RELAY_COUNT) {
-        if (mode == "on") relayModes[r] = RELAY_ON;
-        else if (mode == "off") relayModes[r] = RELAY_OFF;
-        else if (mode == "pid") relayModes[r] = RELAY_PID;
-      }
-      jb.addValue("relayModes", relayModes);
-      ws.textAll(jb.finish());
-
-    } else if (msg == "enabled") {
-      jb.addValue("enabled:", enabled ? "true" : "false");
-      client->text(jb.finish());
-
-    } else if (msg == "ambiant") {
-      jb.addValue("ambiant", Ambiant);
-      client->text(jb.finish());
-
-    } else if (msg == "temp") {
-      jb.addValue("temp", Input);
-      client->text(jb.finish());
-
-    } else if (msg == "door") {
-      jb.addValue("door", door_is_open ? "open" : "closed");
-      client->text(jb.finish());
-
-    } else if (msg == "relays") {
-      jb.addValue("relayModes", relayModes);
-#ifdef STAGED_SSRs
-      jb.addValue("relayDutyCycles", relayDutyCycles);
+    CommandBatch batch;
+    addCommands(batch, doc.as<JsonArrayConst>());
+    runCommands(batch);
 #else
-      jb.addValue("relayStates", relayStates);
-#endif
-      client->text(jb.finish());
-
-#ifdef FEATURES_PSVMRD
-    } else if (msg == "voltages") {
-      getVoltages(volts);
-      jb.addValue("voltages", volts);
-      client->text(jb.finish());
+    if (parsed) runCommand(cmd);
 #endif
-    }
-    jb.clear();
+    if (reply.hasValues()) client->text(reply.finish(), reply.length());
+    reply.clear();
   }
 }
 
 void onEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type,
              void *arg, uint8_t *data, size_t len) {
   if (type == WS_EVT_CONNECT) {
+    // no slot left: refuse it rather than keep it connected without telemetry
+    if (!wsClients.add(client->id())) {
+      client->close();
+      return;
+    }
     IPAddress ip = client->remoteIP();
 //#ifdef SINGLEPHASE_TESTMODE
     //Serial.printf("Client connected: #%u from %s\n", client->id(), ip.toString().c_str());
 //#endif
-    jb.addValue("client", ip.toString().c_str());
+    broadcast.set(TelemetryFrame::CLIENT, ip);
+    telemetry.requestKeyframe();  // the newcomer gets the full picture at the next tick
+  } else if (type == WS_EVT_DISCONNECT) {
+    wsClients.remove(client->id());
   } else if (type == WS_EVT_DATA) {
     handleWebSocketMessage(arg, data, len, client);
   }
@@ -359,6 +484,12 @@ void setup() {
   }
 #endif
   memcpy(lastRelayStates, relayStates, sizeof(relayStates));
+#ifdef MODULATED_OUTPUTS
+  relayOutput.begin();
+#endif
+  door.begin(doorCutoff);
+  door_is_open = doorHold = door.isOpen();
+  doorClosedAt = millis() - DOOR_HOLDOFF_MS;
 
   // load saved parameters from EEPROM
   loadSetpoint();
@@ -367,31 +498,11 @@ void setup() {
   /*
   Serial.println("HMAC verification demo");
 
-  // Received JSON string (includes HMAC)
-  String incoming = "{\"target\":75,\"enabled\":true,\"hmac\":\"b1af1bf40a497e3724dbbcf2481ab91ff1ae485d904fc3713cf284db4bd8c4c7\"}";
-
-  // Step 1 & 2: Extract HMAC and remove it
-  String received_hmac;
-  String json_no_hmac = strip_hmac_field(incoming, received_hmac);
+  // Received JSON string (includes HMAC), signed over its canonical form "enabled=true&target=75"
+  const char *incoming = "{\"target\":75,\"enabled\":true,\"hmac\":\"b1af1bf40a497e3724dbbcf2481ab91ff1ae485d904fc3713cf284db4bd8c4c7\"}";
+  Serial.println("Received JSON: " + String(incoming));
 
-  Serial.println("Received JSON: " + incoming);
-  Serial.println("JSON without HMAC: " + json_no_hmac);
-
-  // Step 3: Canonicalize and recompute new HMAC
-  KV kvs[MAX_KV];
-  String dummy;
-  size_t n = parseJsonToKVs(json_no_hmac, kvs, MAX_KV, dummy);
-  sortKVs(kvs, n);
-  String canonical = buildCanonical(kvs, n);
-
-  String recomputed_hmac = compute_hmac_hex(secret, canonical);
-
-  Serial.println("Canonical: " + canonical);
-  Serial.println("Extracted HMAC:  " + received_hmac);
-  Serial.println("Recomputed HMAC: " + recomputed_hmac);
-
-  // Step 4: Compare
-  if (hex_equals_ci(received_hmac, recomputed_hmac)) {
+  if (verifyJsonHMAC(hmacKey, incoming, strlen(incoming))) {
     Serial.println("✅ HMAC verified successfully");
   } else {
     Serial.println("❌ HMAC verification FAILED");
@@ -429,11 +540,13 @@ void setup() {
     Serial.println();
 #endif
   }
+  tempReader.begin();   // first conversion starts now, loop() collects it
 
   if (!LittleFS.begin()) {
 #ifdef SINGLEPHASE_TESTMODE
     Serial.println("Failed to mount LittleFS");
 #endif
+    startTasks(); // no web UI, but keep controlling
     return;
   } else {
 #ifdef SINGLEPHASE_TESTMODE
@@ -447,6 +560,8 @@ void setup() {
       Serial.println(" bytes)");
     }
 #endif
+    flashLog.begin();
+    history.tier(1).onClose([](const HistoryBucket &b) { flashLog.sample(b); });
   }
 
   /*if (!LittleFS.exists("/index.html")) {
@@ -522,9 +637,11 @@ void setup() {
 
 
   myPID.SetMode(AUTOMATIC);
-  myPID.SetOutputLimits(0, 1); // 3 relays, but non-uniform power outputs
+  myPID.SetOutputLimits(0, 1); // fraction of the power left to the PID, see relayWatts
 
-  server.serveStatic("/", LittleFS, "/").setDefaultFile("index.html");
+  assets.begin();
+  server.addHandler(&assets);
+  server.serveStatic("/", LittleFS, "/").setDefaultFile("index.html");   // files not in /assets.txt
   /*
   server.on("/", HTTP_GET, [](AsyncWebServerRequest *request){
     Serial.println("Request received for /");
@@ -540,6 +657,8 @@ void setup() {
 
   ws.onEvent(onEvent);
   server.addHandler(&ws);
+  // a frame that fills up goes out as is, the rest follows in the next one
+  jb.onOverflow(sendJson);
 
   server.onNotFound([](AsyncWebServerRequest *request){
     //if(LittleFS.exists("/404.html")){
@@ -552,15 +671,15 @@ void setup() {
   server.on("/enable", HTTP_GET, [](AsyncWebServerRequest *request){
     enabled = true;
     request->send(200, "text/plain", "Sauna enabled");
-    jb.addValue("enabled", true);
-    ws.textAll(jb.finish());
+    broadcast.set(TelemetryFrame::ENABLED, true);
+    flashLog.event(FlashLog::ENABLED, 1);
   });
   
   server.on("/disable", HTTP_GET, [](AsyncWebServerRequest *request){
     enabled = false;
     request->send(200, "text/plain", "Sauna disabled");
-    jb.addValue("enabled", false);
-    ws.textAll(jb.finish());
+    broadcast.set(TelemetryFrame::ENABLED, false);
+    flashLog.event(FlashLog::ENABLED, 0);
   });
   
   server.on("/status.json", HTTP_GET, [](AsyncWebServerRequest *request){
@@ -570,6 +689,8 @@ void setup() {
     msg += ",\n\t\"ambiant\":" + String(Ambiant, 2);
     msg += ",\n\t\"enabled\":" + String(enabled ? "true" : "false");
     msg += ",\n\t\"door\":" + String(door_is_open ? "\"open\"" : "\"closed\"");
+    // door switch edge to outputs cut, last and worst since boot
+    msg += ",\n\t\"doorCutoffUs\":[" + String(door.lastCutoffUs()) + "," + String(door.maxCutoffUs()) + "]";
   
     // relayModes
     msg += ",\n\t\"relayModes\":[";
@@ -596,6 +717,12 @@ void setup() {
     msg += "]";
 #endif
   
+#ifdef SMOOTH_TRIAC
+    // from the zero-crossing detector, 0 without mains
+    uint32_t halfCycle = relayOutput.measuredHalfCycleUs();
+    msg += ",\n\t\"mainsHz\":" + String(halfCycle ? 500000.0f / halfCycle : 0.0f, 2);
+#endif
+  
 #ifdef FEATURES_PSVMRD
     msg += ",\n\t\"voltages\":[";
     for (size_t i = 0; i < NUM_CHANNELS; i++) {
@@ -613,35 +740,84 @@ void setup() {
 #endif
   });
 
-  // simple GET handler: /set?temp=75
-  server.on("/set", HTTP_GET, [](AsyncWebServerRequest *request){
-    // TODO use hmac validation if required!!! current state is worse than a backdoor XD
-/*
-    // HMAC start
-    std::vector<std::pair<String,String>> kvs;
-    String hmacHex;
-
-    for (size_t i=0; i<request->params(); i++) {
-      const AsyncWebParameter* p = request->getParam(i);
-      if (p->name() == "hmac") {
-        hmacHex = p->value();
-      } else {
-        kvs.push_back({ p->name(), p->value() });
+  // websocket clients: outbound queue depth now and deepest seen by a flush,
+  // telemetry frames merged into a later one, slow clients closed since boot
+  server.on("/clients.json", HTTP_GET, [](AsyncWebServerRequest *request){
+    uint32_t ids[FrameClients::MAX], dropped[FrameClients::MAX];
+    uint16_t queue[FrameClients::MAX], maxQueue[FrameClients::MAX];
+    bool binary[FrameClients::MAX];
+    size_t n = wsClients.count();
+    for (size_t i = 0; i < n; i++) {
+      ids[i] = wsClients.id(i);
+      binary[i] = wsClients.binary(i);
+      AsyncWebSocketClient *client = ws.client(ids[i]);
+      queue[i] = client ? client->queueLen() : 0;
+      maxQueue[i] = wsClients.maxQueue(i);
+      dropped[i] = wsClients.dropped(i);
+    }
+    reply.addValue("ids", ids, n, 0);
+    reply.addValue("binary", binary, n, 0);
+    reply.addValue("queue", queue, n, 0);
+    reply.addValue("maxQueue", maxQueue, n, 0);
+    reply.addValue("dropped", dropped, n, 0);
+    reply.addValue("evicted", wsClients.evicted());
+    request->send(200, "application/json", reply.finish());
+    reply.clear();
+  });
+
+  // /history?from=-3600&to=0&res=60&format=csv|bin
+  // from, to: log clock (flashlog.h), or seconds before now if negative ; res: 1, 60 or 900,
+  // by default the finest one still holding `from` ; minutes RAM no longer holds come from flash
+  server.on("/history", HTTP_GET, [](AsyncWebServerRequest *request){
+    uint32_t now = flashLog.now();
+    auto when = [&](const char *name, long dflt) -> uint32_t {
+      long t = request->hasParam(name) ? request->getParam(name)->value().toInt() : dflt;
+      if (t < 0) t += now;
+      return t < 0 ? 0 : t;
+    };
+    uint32_t from = when("from", 0);
+    uint32_t to = when("to", (long)now + 1);
+
+    const HistoryTier *tier = history.finestSince(from);
+    if (request->hasParam("res")) {
+      tier = history.tierFor(request->getParam("res")->value().toInt());
+      if (!tier) {
+        request->send(400, "text/plain", "res must be 1, 60 or 900");
+        return;
       }
     }
-    Serial.println(hmacHex);
-    //Serial.println(kvs);
-    if (verifyJsonHMAC(kvs, hmacHex, secret)) {
-      request->send(200, "text/plain", "OK - HMAC valid");
-    } else {
-      request->send(403, "text/plain", "Invalid HMAC");
-      return;
+    const HistorySource *source = tier;
+    if ((!tier || (tier->periodS() == 60 && tier->oldest() > from)) && flashLog.ready()) {
+      source = &flashLog.minutes();
+    } else if (!tier) {
+      source = &history.tier(History::TIERS - 1);
     }
-    */
-    // HMAC end
+    bool binary = request->hasParam("format") && request->getParam("format")->value() == "bin";
+
+    // released with the response
+    std::shared_ptr<HistoryStream> stream(new HistoryStream(*source, from, to, now,
+                                          binary ? HistoryStream::BINARY : HistoryStream::CSV));
+    request->send(request->beginChunkedResponse(binary ? "application/octet-stream" : "text/csv",
+      [stream](uint8_t *buffer, size_t maxLen, size_t /*index*/) -> size_t {
+        size_t n = stream->fill(buffer, maxLen);
+        return n || stream->done() ? n : RESPONSE_TRY_AGAIN;
+      }));
+  });
 
-    // do whatever is required (HTTP_GET)
-    process_validated_request(request);
+  // /set?target=75[&relay=2:pid][&save]: the websocket commands as parameters
+  server.on("/set", HTTP_GET, [](AsyncWebServerRequest *request){
+    // TODO use hmac validation if required!!! current state is worse than a backdoor XD
+    CommandBatch batch;
+    addCommands(batch, request);
+    if (!runCommands(batch)) {
+      reply.clear();
+      request->send(400, "text/plain", "Invalid command");
+    } else if (reply.hasValues()) {
+      request->send(200, "application/json", reply.finish());
+    } else {
+      request->send(200, "text/plain", "OK");
+    }
+    reply.clear();
   });
 
   server.begin();
@@ -651,86 +827,99 @@ void setup() {
 #endif
 
 #ifdef FEATURES_PSVMRD
-  sampler.attach_ms(1000 / SAMPLE_RATE_HZ, sampleADC);
+  beginSampling(LittleFS);   // with /psvmrd.cal
 #endif
-}
 
-void loop() {
-  if (door_is_open != digitalRead(DOOR_SW)){
-    door_is_open = digitalRead(DOOR_SW);
-    jb.addValue("door", door_is_open ? "open" : "closed");
-  }
+  startTasks();
+}
 
-  sensors.requestTemperatures();
-  Input = sensors.getTempC(sensor0);
-  Ambiant = sensors.getTempC(sensor1);
+// ---- control tasks, cadence is set in startTasks() ----
 
-#ifdef STAGED_SSRs
-  for (size_t i = 0; i < RELAY_COUNT; i++) {
-    relayDutyCycles[i] = 0;
+void doorTask() {
+  DoorSwitch::Event e;
+  while (door.poll(e)) {
+    door_is_open = e.open;
+    broadcast.set(TelemetryFrame::DOOR, door_is_open);
+    flashLog.event(FlashLog::DOOR, door_is_open);
+#ifdef SINGLEPHASE_TESTMODE
+    if (e.open) Serial.printf("door open after %u edges, outputs cut in %u us\n", e.edges, (unsigned)door.lastCutoffUs());
+    else Serial.printf("door closed after %u edges\n", e.edges);
+#endif
+    if (!e.open) {
+      doorClosedAt = millis();
+    } else if (!DOOR_AUTO_RESUME && enabled) {
+      enabled = false;
+      broadcast.set(TelemetryFrame::ENABLED, false);
+      flashLog.event(FlashLog::ENABLED, 0);
+    }
   }
+
+  doorHold = door_is_open || millis() - doorClosedAt < DOOR_HOLDOFF_MS;
+#ifdef MODULATED_OUTPUTS
+  // outputs back in the hands of relayTask(), unless the door opened again just now
+  noInterrupts();
+  if (!doorHold && !door.tripped()) relayOutput.resume();
+  interrupts();
 #endif
+}
 
-  if (enabled && !door_is_open && Input != DEVICE_DISCONNECTED_C) {
+void pidTask() {
+  if (enabled && !heatingHeld() && Input != DEVICE_DISCONNECTED_C) {
     myPID.Compute();
 #ifdef SINGLEPHASE_TESTMODE
     Serial.printf("Temp: %.2f °C, Target: %.2f °C, PID Output: %.2f\n", Input, Setpoint, Output);
 #endif
+  }
+}
 
-#ifndef STAGED_SSRs
-    // Apply relay states
-    // TODO dynamic based on RELAY_COUNT and a (new) relayWatts list
-#ifndef SINGLEPHASE_TESTMODE
+void sensorTask() {
+  // non-blocking: only true once a conversion started earlier has completed
+  if (tempReader.poll()) {
+    Input = tempReader.value(0);
+    Ambiant = tempReader.value(1);
+    history.sample(flashLog.now(), Input);
+    // one PID step per new reading, as when the loop was paced by the blocking read
+    sched.once("pid", 0, pidTask);
+  }
+}
+
+// outputs left to the PID, one bit per relay
+uint32_t pidRelays() {
+  uint32_t mask = 0;
+  for (size_t i = 0; i < RELAY_COUNT; i++) {
+    if (relayModes[i] == RELAY_PID) mask |= 1UL << i;
+  }
+  return mask;
+}
+
+void relayTask() {
+#ifdef MODULATED_OUTPUTS
+  for (size_t i = 0; i < RELAY_COUNT; i++) {
+    relayDutyCycles[i] = 0;
+  }
+#endif
+
+  if (enabled && !heatingHeld() && Input != DEVICE_DISCONNECTED_C) {
+#ifndef MODULATED_OUTPUTS
+    // Apply relay states: no PWM on these, the modulated output is rounded to on/off
+    float stage[RELAY_COUNT];
+    relayStages.allocate(Output, pidRelays(), stage);
     for (size_t i = 0; i < RELAY_COUNT; i++) {
 	    digitalWrite(relayPins[i], (relayModes[i] == RELAY_ON) ? RELAY_CLOSED :
-		    (relayModes[i] == RELAY_PID && Output >= i ? RELAY_CLOSED : RELAY_OPEN));
+		    (relayModes[i] == RELAY_PID && stage[i] >= .5 ? RELAY_CLOSED : RELAY_OPEN));
     }
-#else
-	  digitalWrite(relayPins[SINGLEPHASE_TESTMODE], (relayModes[SINGLEPHASE_TESTMODE] == RELAY_ON) ? RELAY_CLOSED :
-		  (relayModes[SINGLEPHASE_TESTMODE] == RELAY_PID && Output >= 1 ? RELAY_CLOSED : RELAY_OPEN));
-#endif
+    if (door.tripped()) doorCutoff();   // the door opened during the writes: microseconds, no relay pulls in that fast
     if (memcmp(relayStates, lastRelayStates, sizeof(relayStates)) != 0) {
       memcpy(lastRelayStates, relayStates, sizeof(relayStates));
-      jb.addValue("relayStates", relayStates);
+      broadcast.set(TelemetryFrame::RELAY_STATES, relayStates);
     }
 
 #else
-    //Serial.println("#def STAGED_SSRs");
-    unsigned long now = millis();
-    if (now - windowStartTime > windowSize) {
-      windowStartTime = now; // reset window
-    }
-
-    // Stage SSRs ; NOTE: this is hardcoded for relative power levels [1,2,1]
-    // TODO dynamic based on RELAY_COUNT and a (new) relayWatts list
-    if (Output <= .25) {
-      // Stage 1: SSR1 PWM only
-      relayDutyCycles[0] = 4*Output;
-    } else if (Output <= .75) {
-      // Stage 2: SSR1 full, SSR2 PWM
-      relayDutyCycles[0] = 1.;
-#ifndef SINGLEPHASE_TESTMODE
-      relayDutyCycles[1] = 2*(Output-.25);
-#endif
-    } else {
-      // Stage 3: SSR1 + SSR2 full, SSR3 PWM
-      relayDutyCycles[0] = 1.;
-#ifndef SINGLEPHASE_TESTMODE
-      relayDutyCycles[1] = 1.;
-      relayDutyCycles[2] = 4*(Output-.75);
-#endif
-    }
-
-    // Apply relay states
-#ifndef SINGLEPHASE_TESTMODE
+    // Stage outputs: whole outputs on, largest first, a single one modulated (see stager.h)
+    relayStages.allocate(Output, pidRelays(), relayDutyCycles);
     for (size_t i = 0; i < RELAY_COUNT; i++) {
-	    digitalWrite(relayPins[i], (relayModes[i] == RELAY_ON) ? RELAY_CLOSED :
-		    (relayModes[i] == RELAY_PID && (now - windowStartTime) < relayDutyCycles[i]*windowSize ? RELAY_CLOSED : RELAY_OPEN));
+      if (relayModes[i] == RELAY_ON) relayDutyCycles[i] = 1.;
     }
-#else
-	  digitalWrite(relayPins[SINGLEPHASE_TESTMODE], (relayModes[SINGLEPHASE_TESTMODE] == RELAY_ON) ? RELAY_CLOSED :
-		  (relayModes[SINGLEPHASE_TESTMODE] == RELAY_PID && (now - windowStartTime) < relayDutyCycles[SINGLEPHASE_TESTMODE]*windowSize ? RELAY_CLOSED : RELAY_OPEN));
-#endif
 #endif
 
   } else {
@@ -740,31 +929,118 @@ void loop() {
     }
 #endif
     Output = 0;
+#ifndef MODULATED_OUTPUTS
     for (size_t i = 0; i < RELAY_COUNT; i++) {
       digitalWrite(relayPins[i], RELAY_OPEN);
     }
+#endif
   }
 
-  if (millis() - lastSend > 5000) {
-    if (enabled) jb.addValue("pid", Output);
-    jb.addValue("temp", Input);
-    jb.addValue("ambiant", Ambiant);
-#ifdef STAGED_SSRs
-    jb.addValue("relayDutyCycles", relayDutyCycles);
+#ifdef MODULATED_OUTPUTS
+  // edges come from timers (ssr_window.h, sigma_delta.h, triac.h), zero duty opens at once
+  relayOutput.publish(relayDutyCycles);
+#endif
+}
+
+void flashLogTask() {
+  flashLog.poll();
+}
+
+void telemetryTask() {
+  telemetry.beginTick();
+  bool key = telemetry.keyframe();
+
+  // shown as 0 while disabled ; through tPid either way, so it knows what the UI shows
+  float pid = enabled ? Output : 0;
+  if (tPid.update(pid, key)) broadcast.set(TelemetryFrame::PID, pid);
+  if (tTemp.update(Input, key)) broadcast.set(TelemetryFrame::TEMP, Input);
+  if (tAmbiant.update(Ambiant, key)) broadcast.set(TelemetryFrame::AMBIANT, Ambiant);
+#ifdef MODULATED_OUTPUTS
+  if (tDutyCycles.update(relayDutyCycles, key)) broadcast.set(TelemetryFrame::DUTY_CYCLES, relayDutyCycles);
 #endif
 
 #ifdef FEATURES_PSVMRD
-    getVoltages(volts);
-    jb.addValue("voltages", volts);
+  if (tVoltages.update(volts, key)) broadcast.set(TelemetryFrame::VOLTAGES, volts);
 #endif // FEATURES_PSVMRD
-    lastSend = millis();
-  }
+}
 
-  if (jb.hasValues()){
-    ws.textAll(jb.finish());
-    jb.clear();
+#ifdef FEATURES_PSVMRD
+void psvmrdTask() {
+#ifdef SMOOTH_TRIAC
+  setMainsPeriod(2 * relayOutput.measuredHalfCycleUs());   // RMS windows follow the mains
+#endif
+  getVoltages(volts);
+}
+#endif
+
+// overflow sink of jb: a frame that filled up goes to the client it is rendered for
+void sendJson(const char *frame, size_t len) {
+  if (jbClient) jbClient->text(frame, len);
+  jbSplit = true;
+}
+
+// per client, see FrameClients: frames only go to an empty queue, the others wait
+// and get the latest values of what they missed once it drains
+void flushTask() {
+  ws.cleanupClients(FrameClients::MAX);
+  if (broadcast.empty() && !wsClients.holding()) return;
+  latest.merge(broadcast);
+  uint16_t fresh = broadcast.present();
+  broadcast.clear();
+
+  // each encoding is built on first use, again only for a client owed other fields
+  uint8_t record[TelemetryFrame::MAX_BINARY];
+  size_t recordLen = 0;
+  uint16_t recordMask = 0, jbMask = 0;
+  unsigned long now = millis();
+  for (size_t i = 0; i < wsClients.count(); i++) {
+    AsyncWebSocketClient *client = ws.client(wsClients.id(i));
+    if (!client) continue;
+    uint16_t mask;
+    switch (wsClients.offer(i, fresh, client->queueLen(), now, mask)) {
+      case FrameClients::HOLD:
+        break;
+      case FrameClients::EVICT:
+        client->close();   // WS_EVT_DISCONNECT unregisters it
+        break;
+      case FrameClients::SEND:
+        if (wsClients.binary(i)) {
+          if (mask != recordMask) {
+            recordLen = latest.toBinary(record, mask);
+            recordMask = mask;
+          }
+          client->binary(record, recordLen);
+        } else {
+          if (mask != jbMask || jbSplit) {
+            jb.clear();
+            jbClient = client;
+            jbSplit = false;
+            latest.toJson(jb, mask);
+            jbMask = mask;
+          }
+          if (jb.hasValues()) client->text(jb.finish(), jb.length());
+        }
+        break;
+    }
   }
+  jb.clear();
+  jbClient = nullptr;
+}
 
-  delay(500);
+void startTasks() {
+  //               name         period  task           deadline [ms]
+  sched.every(    "door",         20,   doorTask);
+  sched.every(    "sensors",      10,   sensorTask);
+  sched.every(    "relays",       10,   relayTask);
+#ifdef FEATURES_PSVMRD
+  sched.every(    "psvmrd",     5000,   psvmrdTask,    100);  // runs ahead of telemetry (EDF)
+#endif
+  sched.every(    "telemetry",  1000,   telemetryTask, 500);  // sends changes only, see telemetry.h
+  sched.every(    "ws",           20,   flushTask);
+  sched.every(    "flashlog",  10000,   flashLogTask);                // appends in page-sized batches
 }
 
+void loop() {
+  unsigned long idle = sched.run();
+  delay(idle < LOOP_IDLE_MAX ? idle : LOOP_IDLE_MAX); // yields to WiFi meanwhile
+}
@@ -1,5 +1,7 @@
 #include <hc_ad_mux.h>
 #include <Ticker.h>
+#include <FS.h>
+#include "spsc_ring.h"
 
 #define	SCLK		D5	// 74HCT595
 //#define 	SDO		D6
@@ -11,85 +13,230 @@
 // ADC calibration
 const float ADC_VOLTAGE_REF = 1.0f;   // V (ESP8266 ADC range)
 const int ADC_MAX = 1023;             // analogRead max (0..1023)
-// TODO move this to another file
-const float calibrationMultiplier = 875.0f; // approx, may need refining and per-device (and per-channel!) tuning
+const int ADC_MID = 512;              // the board biases its inputs to mid-scale
+const float DEFAULT_GAIN = 875.0f;    // [V per ADC volt] approx, per channel in /psvmrd.cal
 
-// Setup MUX1 (bits 0–2) and MUX2 (bits 3–5)
-HC4051 mux1(0, LATCH, SCLK, SDI);
-HC4051 mux2(1, LATCH, SCLK, SDI);
-// System: MUX2 feeds into MUX1 channel 4
-MUXSystem muxSys(AOUTA, mux1, mux2, 4);
+// MUX1 (bits 0–2) and MUX2 (bits 3–5) on one 74HCT595 ; MUX2 feeds into MUX1 channel 4
+MuxScanner scanner(AOUTA, LATCH, SCLK, SDI, 4);
 
 // Sampling config
 /* if sample rate is too high, WiFi starves and watchdog resets device!
- * 250 OK, 500 NOK, 330 OK, 400 starts choking, 350 already chokes
- * then fails at 250.. irregular ping times, I suppose two cores would be better!
- * works so-so, definitely favor two cores there!
+ * with a bit-banged digitalWrite() shift register, two writes for MUX2 and a
+ * 5 µs busy wait per sample: 250 OK, 330 OK, 350 already chokes, 500 NOK.
+ * MuxScanner brings a sample down to the analogRead() and ~30 register
+ * stores, the settling happening between ticks, which should leave room for
+ * 1 kHz aggregate (about 140 Hz per channel). Until that is confirmed on the
+ * device, PSVMRD_FAST_SCAN opts into it and the default stays at 250.
  */
+#ifdef PSVMRD_FAST_SCAN
+const int SAMPLE_RATE_HZ = 1000;
+#else
 const int SAMPLE_RATE_HZ = 250;
-const int BUFFER_SIZE = 100;
+#endif
+const unsigned int MAINS_HZ = 50;     // unless /psvmrd.cal or a zero-crossing detector says otherwise
 
 // TODO move this to another file
 constexpr int NUM_CHANNELS = 7;  // up to 16 channels (8 mux1 + 8 mux2)
 int adcChannels[NUM_CHANNELS] = {0, 1, 2, 3, 8, 9, 10};  // mux channel numbers to read
 
-struct ChannelBuffer {
-  int samples[BUFFER_SIZE];   // big buffer, lives in DRAM
-  volatile uint16_t head;     // index, volatile because ISR writes it
+/* RMS windows span whole mains cycles: a partial one weighs whatever part of
+ * the sine it caught, and only many cycles would average that out. Each
+ * channel is read every SAMPLE_PERIOD_US, so a window is the fewest samples
+ * that land (within 1/2048) on a multiple of the mains period: for 7 channels
+ * on 50 Hz, 20 samples over 28 cycles at 250 Hz or 7 cycles at 1 kHz, their
+ * phases spread evenly over the sine.
+ */
+const uint32_t SAMPLE_PERIOD_US = 1000000UL * NUM_CHANNELS / SAMPLE_RATE_HZ;
+const size_t MIN_WINDOW = 16;
+const size_t MAX_WINDOW = 127;
+
+// last samples of each channel, from the ISR: the one leaving the window is read back from there
+typedef SpscRing<int16_t, 128> SampleRing;
+SampleRing channelSamples[NUM_CHANNELS];
+static_assert(MAX_WINDOW < SampleRing::CAPACITY, "RMS window larger than the sample ring");
+// n·Σ(v - ADC_MID)² stays within 32 bits
+static_assert((uint64_t)MAX_WINDOW * MAX_WINDOW * ADC_MID * ADC_MID <= 0xffffffffULL, "RMS window too long for 32-bit sums");
+
+// running sums over the last windowLength samples of a channel, kept by the ISR
+struct ChannelSums {
+  int32_t sum;        // of v - ADC_MID
+  uint32_t sumSq;
+  uint16_t n;         // samples in them, windowLength once the window is full
+};
+ChannelSums channelSums[NUM_CHANNELS];
+
+uint32_t mainsPeriodUs = 0;
+size_t windowLength = MAX_WINDOW;   // samples, set with the period
+
+// per channel, fixed point: millivolts = (RMS [ADC counts] · gain) >> 16, plus offset
+struct Calibration {
+  uint32_t gain;    // [mV per ADC count] Q16
+  int32_t offset;   // [mV]
 };
-// One buffer per channel, allocated globally (not on stack)
-ChannelBuffer chanBuf[NUM_CHANNELS];
+Calibration calibration[NUM_CHANNELS];
 
 Ticker sampler;
-int currentChannel = 0;
 
 // ---- Sampling ISR ----
 void sampleADC() {
-  int raw;
-  if (adcChannels[currentChannel] >= 8) {
-    raw = muxSys.readMux2(adcChannels[currentChannel]-8);
+  size_t chan;
+  int raw = scanner.sample(chan);
+  SampleRing &ring = channelSamples[chan];
+  ChannelSums &s = channelSums[chan];
+
+  // the sample leaving the window goes out of the sums as the new one comes in
+  if (s.n < windowLength) {
+    s.n++;
   } else {
-    raw = muxSys.readMux1(adcChannels[currentChannel]);
+    int32_t old = ring.recent(windowLength - 1) - ADC_MID;
+    s.sum -= old;
+    s.sumSq -= old * old;
   }
+  int32_t x = raw - ADC_MID;
+  s.sum += x;
+  s.sumSq += x * x;
+  ring.record(raw);
+}
 
-  ChannelBuffer &buf = chanBuf[currentChannel];
-  buf.samples[buf.head] = raw;
-  buf.head = (buf.head + 1) % BUFFER_SIZE;
-
-  if (currentChannel == (NUM_CHANNELS-1)){
-    currentChannel = 0;
-  } else {
-    currentChannel++;
+// the shortest window of whole mains cycles, or the closest to it there is
+size_t windowFor(uint32_t periodUs) {
+  size_t best = MAX_WINDOW;
+  uint32_t bestRest = periodUs, bestSpan = 1;
+  for (size_t n = MIN_WINDOW; n <= MAX_WINDOW; n++) {
+    uint32_t span = n * SAMPLE_PERIOD_US;
+    if (span < periodUs) continue;
+    uint32_t rest = span % periodUs;
+    if (rest > periodUs / 2) rest = periodUs - rest;
+    if ((uint64_t)rest * 2048 <= span) return n;
+    if ((uint64_t)rest * bestSpan < (uint64_t)bestRest * span) {
+      best = n;
+      bestRest = rest;
+      bestSpan = span;
+    }
   }
+  return best;
 }
 
-// ---- Compute RMS on demand ----
-float computeRMS(int chan) {
+// from the configured frequency or a zero-crossing detector ; 0 is ignored
+void setMainsPeriod(uint32_t periodUs) {
+  if (!periodUs || periodUs == mainsPeriodUs) return;
+  mainsPeriodUs = periodUs;
+  size_t n = windowFor(periodUs);
+  if (n == windowLength) return;
+
+  // new window length, rare: the sums start over from what the rings hold
   noInterrupts();
-  ChannelBuffer &buf = chanBuf[chan];
+  windowLength = n;
+  for (size_t i = 0; i < NUM_CHANNELS; i++) {
+    int16_t v[MAX_WINDOW];
+    ChannelSums &s = channelSums[i];
+    s = { 0, 0, (uint16_t)channelSamples[i].window(v, n) };
+    for (size_t k = 0; k < s.n; k++) {
+      int32_t x = v[k] - ADC_MID;
+      s.sum += x;
+      s.sumSq += x * x;
+    }
+  }
   interrupts();
+}
+
+uint32_t gainQ16(float voltsPerAdcVolt) {
+  float q = voltsPerAdcVolt * ADC_VOLTAGE_REF / ADC_MAX * 1000 * 65536;
+  return q <= 0 ? 0 : q >= 4294967295.0f ? 0xffffffff : (uint32_t)(q + .5f);
+}
 
-  double sum = 0, sumSq = 0;
-  for (int i = 0; i < BUFFER_SIZE; i++) {
-    int v = buf.samples[i];
-    sum += v;
-    sumSq += (double)v * v;
+/* /psvmrd.cal, read by beginSampling(): a line per mux channel (0..15) with its gain
+ * in V per ADC volt and its offset in V, and optionally the mains frequency.
+ * Channels left out keep DEFAULT_GAIN and no offset.
+ *
+ *   # channel gain offset
+ *   0 875.0 0
+ *   8 861.5 -0.8
+ *   hz 60
+ *
+ * Returns how many channels it calibrated.
+ */
+size_t loadCalibration(fs::FS &fs, const char *path = "/psvmrd.cal") {
+  for (size_t i = 0; i < NUM_CHANNELS; i++) calibration[i] = { gainQ16(DEFAULT_GAIN), 0 };
+  setMainsPeriod(1000000UL / MAINS_HZ);
+
+  fs::File f = fs.open(path, "r");
+  if (!f) return 0;
+  String text = f.readString();
+  f.close();
+
+  size_t calibrated = 0;
+  for (const char *p = text.c_str(); *p;) {
+    const char *eol = strchr(p, '\n');
+    if (!eol) eol = p + strlen(p);
+    char line[48], *end;
+    size_t len = eol - p < (int)sizeof(line) - 1 ? eol - p : sizeof(line) - 1;
+    memcpy(line, p, len);
+    line[len] = 0;
+    p = *eol ? eol + 1 : eol;
+
+    if (!strncmp(line, "hz ", 3)) {
+      float hz = strtod(line + 3, &end);
+      if (hz >= 10 && hz <= 1000) setMainsPeriod((uint32_t)(1e6f / hz + .5f));
+    } else if (line[0] != '#') {
+      long ch = strtol(line, &end, 10);
+      if (end == line) continue;
+      float gain = strtod(end, &end);
+      float offset = strtod(end, &end);
+      for (size_t i = 0; i < NUM_CHANNELS; i++) {
+        if (adcChannels[i] != ch || gain <= 0) continue;
+        calibration[i] = { gainQ16(gain), (int32_t)lroundf(offset * 1000) };
+        calibrated++;
+      }
+    }
   }
+  return calibrated;
+}
 
-  double mean = sum / BUFFER_SIZE;
-  double variance = (sumSq / BUFFER_SIZE) - (mean * mean);
-  if (variance < 0) variance = 0;
+void beginSampling(fs::FS &fs) {
+  loadCalibration(fs);
+  scanner.begin(adcChannels, NUM_CHANNELS);
+  sampler.attach_ms(1000 / SAMPLE_RATE_HZ, sampleADC);
+}
 
-  double rmsRaw = sqrt(variance);
-  float voltsRMS = rmsRaw * (ADC_VOLTAGE_REF / ADC_MAX);
-  return voltsRMS * calibrationMultiplier;
+// ---- Compute RMS on demand ----
+uint32_t isqrt32(uint32_t x) {
+  uint32_t r = 0;
+  for (uint32_t bit = 1UL << 30; bit; bit >>= 2) {
+    if (x >= r + bit) {
+      x -= r + bit;
+      r = (r >> 1) + bit;
+    } else {
+      r >>= 1;
+    }
+  }
+  return r;
+}
+
+// AC part of a full window, 0 before: n·Σv² - (Σv)² = n²·variance, exact in integers
+int32_t millivoltsFrom(const ChannelSums &s, size_t chan) {
+  if (!s.n || s.n < windowLength) return 0;
+  uint32_t absSum = s.sum < 0 ? -s.sum : s.sum;
+  uint32_t nRms = isqrt32(s.n * s.sumSq - absSum * absSum);
+  int32_t mv = (int32_t)(((uint64_t)nRms * calibration[chan].gain / s.n + 0x8000) >> 16) + calibration[chan].offset;
+  return mv > 0 ? mv : 0;
 }
 
+float computeRMS(int chan) {
+  noInterrupts();
+  ChannelSums s = channelSums[chan];
+  interrupts();
+  return millivoltsFrom(s, chan) * .001f;
+}
+
+// all channels from the same instant: interrupts are off for the copy only
 void getVoltages(float *out) {
-    noInterrupts();
-    for (size_t i = 0; i < NUM_CHANNELS; i++) {
-        out[i] = computeRMS(i);
-    }
-    interrupts();
+  ChannelSums s[NUM_CHANNELS];
+  noInterrupts();
+  memcpy(s, channelSums, sizeof(s));
+  interrupts();
+  for (size_t i = 0; i < NUM_CHANNELS; i++) {
+    out[i] = millivoltsFrom(s[i], i) * .001f;
+  }
 }
 float volts[NUM_CHANNELS];
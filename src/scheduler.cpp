@@ -0,0 +1,96 @@
+#include "scheduler.h"
+#include <limits.h>
+
+int Scheduler::_add(const char *name, unsigned long period, unsigned long delay, TaskFn fn, unsigned long deadline) {
+  size_t slot = _count;
+  for (size_t i = 0; i < _count; i++) {
+    if (!_tasks[i].active) { slot = i; break; }
+  }
+  if (slot >= MAX_TASKS) return -1;
+  if (slot == _count) _count++;
+
+  if (!deadline) deadline = period ? period : LONG_MAX;   // one-shots have no deadline unless asked
+
+  Task &t = _tasks[slot];
+  t.name = name;
+  t.fn = fn;
+  t.period = period;
+  t.deadline = deadline;
+  t.release = _clock() + delay;
+  t.runs = 0;
+  t.overruns = 0;
+  t.maxLateness = 0;
+  t.active = true;
+  return (int)slot;
+}
+
+int Scheduler::every(const char *name, unsigned long period, TaskFn fn, unsigned long deadline) {
+  if (!period) return -1;
+  return _add(name, period, 0, fn, deadline);
+}
+
+int Scheduler::once(const char *name, unsigned long delay, TaskFn fn, unsigned long deadline) {
+  return _add(name, 0, delay, fn, deadline);
+}
+
+void Scheduler::cancel(int id) {
+  if (id >= 0 && (size_t)id < _count) _tasks[id].active = false;
+}
+
+unsigned long Scheduler::run() {
+  bool ran[MAX_TASKS] = {};
+  unsigned long now = _clock();
+
+  for (;;) {
+    // earliest deadline first among the tasks that are due and did not run yet
+    int next = -1;
+    long bestSlack = 0;
+    for (size_t i = 0; i < _count; i++) {
+      const Task &t = _tasks[i];
+      if (!t.active || ran[i] || (long)(now - t.release) < 0) continue;
+      long slack = (long)(t.deadline - (now - t.release));
+      if (next < 0 || slack < bestSlack) {
+        next = (int)i;
+        bestSlack = slack;
+      }
+    }
+    if (next < 0) break;
+
+    Task &t = _tasks[next];
+    ran[next] = true;
+
+    unsigned long released = t.release;
+    unsigned long lateness = now - released;
+    if (lateness > t.maxLateness) t.maxLateness = lateness;
+
+    if (t.period) {
+      t.release += t.period;
+      // too late for the following releases as well: skip them, they count as overruns
+      while ((long)(now - t.release) >= 0) {
+        t.release += t.period;
+        t.overruns++;
+      }
+    } else {
+      t.active = false;
+    }
+
+    // a one-shot may re-arm itself from fn() and land in the same slot
+    bool periodic = t.period != 0;
+    unsigned long deadline = t.deadline;
+    t.runs++;
+    t.fn();
+
+    now = _clock();
+    if (now - released > deadline && (periodic || !t.active)) t.overruns++;
+  }
+
+  unsigned long idle = ULONG_MAX;
+  for (size_t i = 0; i < _count; i++) {
+    const Task &t = _tasks[i];
+    if (!t.active) continue;
+    long wait = (long)(t.release - now);
+    if (wait <= 0) return 0;
+    if ((unsigned long)wait < idle) idle = wait;
+  }
+  return idle;
+}
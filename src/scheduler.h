@@ -0,0 +1,55 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+
+/*
+ * Cooperative scheduler for periodic and one-shot tasks.
+ *
+ * Every task has a release time and a relative deadline ; run() executes the
+ * tasks that are due, earliest deadline first, each at most once per call. A
+ * task that finishes after its deadline, or whose releases had to be skipped
+ * because it was too late, gets its overrun counter bumped.
+ *
+ * The clock is injected so the same code runs under a simulated clock.
+ */
+class Scheduler {
+  public:
+    typedef unsigned long (*Clock)();
+    typedef void (*TaskFn)();
+    static constexpr size_t MAX_TASKS = 12;
+
+    struct Task {
+      const char *name;
+      TaskFn fn;
+      unsigned long period;     // 0 for one-shot tasks
+      unsigned long deadline;   // relative to release
+      unsigned long release;    // next time the task is due
+      unsigned long runs;
+      unsigned long overruns;
+      unsigned long maxLateness;
+      bool active;
+    };
+
+    explicit Scheduler(Clock clock = millis) : _clock(clock), _count(0) {}
+
+    // deadline 0 means "before the next release" (i.e. the period) ; returns task id or -1
+    int every(const char *name, unsigned long period, TaskFn fn, unsigned long deadline = 0);
+    int once(const char *name, unsigned long delay, TaskFn fn, unsigned long deadline = 0);
+    void cancel(int id);
+
+    // runs due tasks ; returns ms until the next release
+    unsigned long run();
+
+    size_t count() const { return _count; }
+    const Task &task(size_t i) const { return _tasks[i]; }
+
+  private:
+    Clock _clock;
+    Task _tasks[MAX_TASKS];
+    size_t _count;
+
+    int _add(const char *name, unsigned long period, unsigned long delay, TaskFn fn, unsigned long deadline);
+};
+
+#endif
@@ -5,50 +5,74 @@
 #include <stddef.h>
 
 // --- internal helpers ---
-static inline uint32_t rotr(uint32_t x, uint32_t n) {
-  return (x >> n) | (x << (32 - n));
-}
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define BSIG0(x) (ROTR(x, 2) ^ ROTR(x, 13) ^ ROTR(x, 22))
+#define BSIG1(x) (ROTR(x, 6) ^ ROTR(x, 11) ^ ROTR(x, 25))
+#define SSIG0(x) (ROTR(x, 7) ^ ROTR(x, 18) ^ ((x) >> 3))
+#define SSIG1(x) (ROTR(x, 17) ^ ROTR(x, 19) ^ ((x) >> 10))
+#define CH(e, f, g) ((g) ^ ((e) & ((f) ^ (g))))
+#define MAJ(a, b, c) (((a) & (b)) | ((c) & ((a) | (b))))
 
-static void sha256_transform(uint32_t state[8], const uint8_t block[64]) {
-  static const uint32_t K[64] = {
-    0x428a2f98,0x71374491,0xb5c0fbcf,0xe9b5dba5,0x3956c25b,0x59f111f1,0x923f82a4,0xab1c5ed5,
-    0xd807aa98,0x12835b01,0x243185be,0x550c7dc3,0x72be5d74,0x80deb1fe,0x9bdc06a7,0xc19bf174,
-    0xe49b69c1,0xefbe4786,0x0fc19dc6,0x240ca1cc,0x2de92c6f,0x4a7484aa,0x5cb0a9dc,0x76f988da,
-    0x983e5152,0xa831c66d,0xb00327c8,0xbf597fc7,0xc6e00bf3,0xd5a79147,0x06ca6351,0x14292967,
-    0x27b70a85,0x2e1b2138,0x4d2c6dfc,0x53380d13,0x650a7354,0x766a0abb,0x81c2c92e,0x92722c85,
-    0xa2bfe8a1,0xa81a664b,0xc24b8b70,0xc76c51a3,0xd192e819,0xd6990624,0xf40e3585,0x106aa070,
-    0x19a4c116,0x1e376c08,0x2748774c,0x34b0bcb5,0x391c0cb3,0x4ed8aa4a,0x5b9cca4f,0x682e6ff3,
-    0x748f82ee,0x78a5636f,0x84c87814,0x8cc70208,0x90befffa,0xa4506ceb,0xbef9a3f7,0xc67178f2
-  };
-  uint32_t W[64];
-  uint32_t a,b,c,d,e,f,g,h;
-  for (int i=0;i<16;i++) {
-    W[i] = (uint32_t)block[i*4] << 24 |
-           (uint32_t)block[i*4+1] << 16 |
-           (uint32_t)block[i*4+2] << 8 |
-           (uint32_t)block[i*4+3];
-  }
-  for (int i=16;i<64;i++) {
-    uint32_t s0 = rotr(W[i-15],7) ^ rotr(W[i-15],18) ^ (W[i-15] >> 3);
-    uint32_t s1 = rotr(W[i-2],17) ^ rotr(W[i-2],19) ^ (W[i-2] >> 10);
-    W[i] = W[i-16] + s0 + W[i-7] + s1;
-  }
-  a = state[0]; b = state[1]; c = state[2]; d = state[3];
-  e = state[4]; f = state[5]; g = state[6]; h = state[7];
-  for (int i=0;i<64;i++) {
-    uint32_t S1 = rotr(e,6) ^ rotr(e,11) ^ rotr(e,25);
-    uint32_t ch = (e & f) ^ ((~e) & g);
-    uint32_t temp1 = h + S1 + ch + K[i] + W[i];
-    uint32_t S0 = rotr(a,2) ^ rotr(a,13) ^ rotr(a,22);
-    uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
-    uint32_t temp2 = S0 + maj;
-    h = g; g = f; f = e; e = d + temp1;
-    d = c; c = b; b = a; a = temp1 + temp2;
+// big endian load, any alignment
+#define LOAD32(p) ((uint32_t)(p)[0] << 24 | (uint32_t)(p)[1] << 16 | (uint32_t)(p)[2] << 8 | (uint32_t)(p)[3])
+
+// rolling 16-word schedule: W[i & 15] becomes W[i] for i >= 16
+#define SCHEDULE(i) \
+  (W[(i) & 15] += SSIG1(W[((i) - 2) & 15]) + W[((i) - 7) & 15] + SSIG0(W[((i) - 15) & 15]))
+
+// one round ; the variables rotate through the arguments instead of being moved
+#define ROUND(a, b, c, d, e, f, g, h, i, w) do { \
+    uint32_t t1 = h + BSIG1(e) + CH(e, f, g) + K[i] + (w); \
+    d += t1; \
+    h = t1 + BSIG0(a) + MAJ(a, b, c); \
+  } while (0)
+
+#define ROUNDS8(i, W_) do { \
+    ROUND(a, b, c, d, e, f, g, h, (i) + 0, W_((i) + 0)); \
+    ROUND(h, a, b, c, d, e, f, g, (i) + 1, W_((i) + 1)); \
+    ROUND(g, h, a, b, c, d, e, f, (i) + 2, W_((i) + 2)); \
+    ROUND(f, g, h, a, b, c, d, e, (i) + 3, W_((i) + 3)); \
+    ROUND(e, f, g, h, a, b, c, d, (i) + 4, W_((i) + 4)); \
+    ROUND(d, e, f, g, h, a, b, c, (i) + 5, W_((i) + 5)); \
+    ROUND(c, d, e, f, g, h, a, b, (i) + 6, W_((i) + 6)); \
+    ROUND(b, c, d, e, f, g, h, a, (i) + 7, W_((i) + 7)); \
+  } while (0)
+
+#define W_LOAD(i) (W[i] = LOAD32(block + 4 * (i)))
+
+static const uint32_t K[64] = {
+  0x428a2f98,0x71374491,0xb5c0fbcf,0xe9b5dba5,0x3956c25b,0x59f111f1,0x923f82a4,0xab1c5ed5,
+  0xd807aa98,0x12835b01,0x243185be,0x550c7dc3,0x72be5d74,0x80deb1fe,0x9bdc06a7,0xc19bf174,
+  0xe49b69c1,0xefbe4786,0x0fc19dc6,0x240ca1cc,0x2de92c6f,0x4a7484aa,0x5cb0a9dc,0x76f988da,
+  0x983e5152,0xa831c66d,0xb00327c8,0xbf597fc7,0xc6e00bf3,0xd5a79147,0x06ca6351,0x14292967,
+  0x27b70a85,0x2e1b2138,0x4d2c6dfc,0x53380d13,0x650a7354,0x766a0abb,0x81c2c92e,0x92722c85,
+  0xa2bfe8a1,0xa81a664b,0xc24b8b70,0xc76c51a3,0xd192e819,0xd6990624,0xf40e3585,0x106aa070,
+  0x19a4c116,0x1e376c08,0x2748774c,0x34b0bcb5,0x391c0cb3,0x4ed8aa4a,0x5b9cca4f,0x682e6ff3,
+  0x748f82ee,0x78a5636f,0x84c87814,0x8cc70208,0x90befffa,0xa4506ceb,0xbef9a3f7,0xc67178f2
+};
+
+void sha256_blocks_soft(uint32_t state[8], const uint8_t *data, size_t blocks) {
+  uint32_t W[16];
+  for (; blocks; blocks--, data += SHA256_BLOCK_SIZE) {
+    const uint8_t *block = data;
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+    ROUNDS8(0, W_LOAD);
+    ROUNDS8(8, W_LOAD);
+    for (int i = 16; i < 64; i += 8) ROUNDS8(i, SCHEDULE);
+
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
   }
-  state[0] += a; state[1] += b; state[2] += c; state[3] += d;
-  state[4] += e; state[5] += f; state[6] += g; state[7] += h;
 }
 
+#ifndef SHA256_BACKEND_EXTERNAL
+void sha256_blocks(uint32_t state[8], const uint8_t *data, size_t blocks) {
+  sha256_blocks_soft(state, data, blocks);
+}
+#endif
+
 void sha256_init(sha256_ctx *ctx) {
   ctx->state[0] = 0x6a09e667; ctx->state[1] = 0xbb67ae85;
   ctx->state[2] = 0x3c6ef372; ctx->state[3] = 0xa54ff53a;
@@ -61,13 +85,25 @@ void sha256_init(sha256_ctx *ctx) {
 void sha256_update(sha256_ctx *ctx, const uint8_t *data, size_t len) {
   size_t idx = (ctx->bitcount >> 3) % 64;
   ctx->bitcount += (uint64_t)len << 3;
-  for (size_t i=0;i<len;i++) {
-    ctx->buffer[idx++] = data[i];
-    if (idx == 64) {
-      sha256_transform(ctx->state, ctx->buffer);
-      idx = 0;
-    }
+
+  // top up a partial block first
+  if (idx) {
+    size_t n = len < 64 - idx ? len : 64 - idx;
+    memcpy(ctx->buffer + idx, data, n);
+    data += n;
+    len -= n;
+    if (idx + n < 64) return;
+    sha256_blocks(ctx->state, ctx->buffer, 1);
+  }
+
+  // whole blocks straight from the input
+  size_t blocks = len / 64;
+  if (blocks) {
+    sha256_blocks(ctx->state, data, blocks);
+    data += blocks * 64;
+    len -= blocks * 64;
   }
+  memcpy(ctx->buffer, data, len);
 }
 
 void sha256_final(sha256_ctx *ctx, uint8_t hash[SHA256_HASH_SIZE]) {
@@ -75,7 +111,7 @@ void sha256_final(sha256_ctx *ctx, uint8_t hash[SHA256_HASH_SIZE]) {
   ctx->buffer[idx++] = 0x80;
   if (idx > 56) {
     while (idx < 64) ctx->buffer[idx++] = 0;
-    sha256_transform(ctx->state, ctx->buffer);
+    sha256_blocks(ctx->state, ctx->buffer, 1);
     idx = 0;
   }
   while (idx < 56) ctx->buffer[idx++] = 0;
@@ -83,7 +119,7 @@ void sha256_final(sha256_ctx *ctx, uint8_t hash[SHA256_HASH_SIZE]) {
   for (int i=7;i>=0;i--) {
     ctx->buffer[idx++] = (uint8_t)(bc >> (i*8));
   }
-  sha256_transform(ctx->state, ctx->buffer);
+  sha256_blocks(ctx->state, ctx->buffer, 1);
   for (int i=0;i<8;i++) {
     hash[i*4]   = (uint8_t)(ctx->state[i] >> 24);
     hash[i*4+1] = (uint8_t)(ctx->state[i] >> 16);
@@ -132,4 +168,3 @@ void hmac_sha256(const uint8_t *key, size_t keylen,
   sha256_update(&ctx, inner_hash, SHA256_HASH_SIZE);
   sha256_final(&ctx, out);
 }
-
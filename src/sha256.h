@@ -17,6 +17,19 @@ typedef struct {
   uint8_t buffer[64];
 } sha256_ctx;
 
+/**
+ * Compression backend: folds whole 64-byte blocks into the state (host word
+ * order). sha256_update() hands it full blocks straight from the input and
+ * only buffers a partial one.
+ *
+ * sha256_blocks_soft() is the portable kernel. A build with
+ * SHA256_BACKEND_EXTERNAL defined links its own sha256_blocks() instead, e.g.
+ * sha256_esp32.cpp for an ESP32 SoC accelerator. The backend has to resume
+ * from any state, since HMAC contexts start from cached midstates (hmac.h).
+ */
+void sha256_blocks(uint32_t state[8], const uint8_t *data, size_t blocks);
+void sha256_blocks_soft(uint32_t state[8], const uint8_t *data, size_t blocks);
+
 void sha256_init(sha256_ctx *ctx);
 void sha256_update(sha256_ctx *ctx, const uint8_t *data, size_t len);
 void sha256_final(sha256_ctx *ctx, uint8_t hash[SHA256_HASH_SIZE]);
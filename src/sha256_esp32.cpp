@@ -0,0 +1,42 @@
+// sha256_esp32.cpp
+// SHA-256 compression backend for the ESP32 family's SHA accelerator (see
+// sha256.h) ; build with -DSHA256_BACKEND_EXTERNAL. Nothing here on ESP8266,
+// which has no accelerator.
+#if defined(ESP32) && defined(SHA256_BACKEND_EXTERNAL)
+#include "sha256.h"
+#include <string.h>
+#include "soc/soc_caps.h"
+
+#if SOC_SHA_SUPPORT_RESUME
+#include "hal/sha_hal.h"
+#include "sha/sha_dma.h"      // esp_sha_acquire_hardware(), shared with mbedtls
+
+// the peripheral keeps the digest words in memory (big endian) byte order
+static inline uint32_t swap32(uint32_t v) { return __builtin_bswap32(v); }
+
+void sha256_blocks(uint32_t state[8], const uint8_t *data, size_t blocks) {
+  uint32_t digest[8];
+  uint32_t block[SHA256_BLOCK_SIZE / 4];    // the text registers take aligned words
+  for (int i=0;i<8;i++) digest[i] = swap32(state[i]);
+
+  esp_sha_acquire_hardware();
+  sha_hal_write_digest(SHA2_256, digest);
+  for (; blocks; blocks--, data += SHA256_BLOCK_SIZE) {
+    memcpy(block, data, SHA256_BLOCK_SIZE);
+    sha_hal_hash_block(SHA2_256, block, SHA256_BLOCK_SIZE / 4, false);   // waits for the previous one
+  }
+  sha_hal_wait_idle();
+  sha_hal_read_digest(SHA2_256, digest);
+  esp_sha_release_hardware();
+
+  for (int i=0;i<8;i++) state[i] = swap32(digest[i]);
+}
+
+#else
+// the original ESP32's accelerator cannot be loaded with a state: no midstates
+void sha256_blocks(uint32_t state[8], const uint8_t *data, size_t blocks) {
+  sha256_blocks_soft(state, data, blocks);
+}
+#endif
+
+#endif
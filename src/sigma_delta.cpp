@@ -0,0 +1,76 @@
+#include "sigma_delta.h"
+
+SsrSigmaDelta *SsrSigmaDelta::_instance = nullptr;
+
+SsrSigmaDelta::SsrSigmaDelta(const int *pins, size_t count, unsigned long cycleMs, int closedLevel, uint8_t zeroCrossPin)
+  : _pins(pins), _count(count < MAX_OUTPUTS ? count : MAX_OUTPUTS), _cycleMs(cycleMs ? cycleMs : 1),
+    _closedLevel(closedLevel), _zcPin(zeroCrossPin), _halfCycle(_cycleMs * 500), _cut(false),
+    _lastCrossing(0), _crossings(0) {
+  for (size_t i = 0; i < _count; i++) {
+    _mod[i] = SigmaDelta(SigmaDelta::ONE * i / _count);
+    _closed[i] = false;
+  }
+}
+
+void SsrSigmaDelta::begin() {
+  for (size_t i = 0; i < _count; i++) _write(i, false);
+  if (_zcPin != NO_ZERO_CROSS) {
+    _instance = this;
+    pinMode(_zcPin, INPUT);
+    attachInterrupt(digitalPinToInterrupt(_zcPin), _zeroCrossIsr, RISING);
+  }
+  // free-running, or standing in for a detector that went silent
+  _cycle.attach_ms(_cycleMs, [this]() { if (!locked()) tick(); });
+}
+
+void SsrSigmaDelta::publish(const float *duty) {
+  for (size_t i = 0; i < _count; i++) {
+    _mod[i].set(duty[i]);
+    if (!_mod[i].level() && _closed[i]) _write(i, false);   // do not wait for the next cycle
+  }
+}
+
+void IRAM_ATTR SsrSigmaDelta::cutoff() {
+  _cut = true;
+  for (size_t i = 0; i < _count; i++) {
+    _closed[i] = false;
+    digitalWrite(_pins[i], _closedLevel == LOW ? HIGH : LOW);
+  }
+}
+
+void SsrSigmaDelta::resume() {
+  _cut = false;
+}
+
+void IRAM_ATTR SsrSigmaDelta::tick() {
+  for (size_t i = 0; i < _count; i++) {
+    bool on = _mod[i].tick();
+    if (on != _closed[i]) _write(i, on);
+  }
+}
+
+void IRAM_ATTR SsrSigmaDelta::_zeroCrossIsr() {
+  if (_instance) _instance->_onZeroCross();
+}
+
+void IRAM_ATTR SsrSigmaDelta::_onZeroCross() {
+  unsigned long now = micros();
+  unsigned long since = now - _lastCrossing;
+  if (_crossings && since < _halfCycle * 3 / 4) return;   // detector ringing
+  _lastCrossing = now;
+  if (!_crossings || since >= 3 * _halfCycle) {
+    _crossings = 1;   // (re)locking: the Ticker stepped so far, cycles start at the next crossing
+    return;
+  }
+  unsigned long before = _crossings;
+  _crossings += (since + _halfCycle / 2) / _halfCycle;   // a crossing the detector missed still counts
+  if (_crossings / 2 != before / 2) tick();              // every other one: whole cycles
+}
+
+void IRAM_ATTR SsrSigmaDelta::_write(size_t i, bool closed) {
+  noInterrupts();   // not between cutoff() and its write
+  if (_cut) closed = false;
+  _closed[i] = closed;
+  digitalWrite(_pins[i], closed ? _closedLevel : (_closedLevel == LOW ? HIGH : LOW));
+  interrupts();
+}
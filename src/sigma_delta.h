@@ -0,0 +1,84 @@
+#ifndef SIGMA_DELTA_H
+#define SIGMA_DELTA_H
+
+#include <Arduino.h>
+#include <Ticker.h>
+
+/*
+ * First-order sigma-delta (Bresenham) modulator: called once per mains cycle,
+ * tick() says whether the output conducts during that cycle. On-cycles come
+ * out as evenly spread as the duty cycle allows (1/3 -> on, off, off, on...),
+ * which keeps thermal and current ripple to a single cycle.
+ *
+ * Pure integer arithmetic, no clock: host code can drive it with any tick.
+ */
+class SigmaDelta {
+  public:
+    static constexpr uint32_t ONE = 1UL << 16;   // duty 1.0 in fixed point
+
+    explicit SigmaDelta(uint32_t phase = 0) : _level(0), _acc(phase % ONE) {}
+
+    void set(float duty) { _level = duty <= 0 ? 0 : (duty >= 1 ? ONE : (uint32_t)(duty * ONE + .5f)); }
+    uint32_t level() const { return _level; }
+
+    bool tick() {
+      _acc += _level;
+      if (_acc < ONE) return false;
+      _acc -= ONE;
+      return true;
+    }
+
+  private:
+    uint32_t _level;
+    uint32_t _acc;
+};
+
+/*
+ * SSR outputs modulated cycle by cycle with SigmaDelta, same publish()
+ * interface as SsrWindow ; the accumulators start out of phase so outputs do
+ * not switch together.
+ *
+ * With a zero-crossing detector, the modulator steps on every other crossing,
+ * so zero-crossing SSRs conduct whole cycles: no DC on the feed. Without one,
+ * or while it is silent, a Ticker free-runs at the mains period instead ; it
+ * is not locked to the zeros, so a run of on-cycles may start and end on
+ * different half-cycles and runs are whole cycles on average only.
+ */
+class SsrSigmaDelta {
+  public:
+    static constexpr size_t MAX_OUTPUTS = 9;
+    static constexpr uint8_t NO_ZERO_CROSS = 0xff;
+
+    SsrSigmaDelta(const int *pins, size_t count, unsigned long cycleMs = 20, int closedLevel = LOW,
+                  uint8_t zeroCrossPin = NO_ZERO_CROSS);
+
+    void begin();                         // pins must already be outputs
+    void publish(const float *duty);      // 0..1 per output
+    void IRAM_ATTR cutoff();              // all open now, from an ISR too ; and until resume()
+    void resume();                        // from the next cycle
+    void IRAM_ATTR tick();                // one mains cycle (called on the zero cross or by the Ticker)
+    unsigned long cycleMs() const { return _cycleMs; }
+    bool locked() const { return _crossings && micros() - _lastCrossing < 3 * _halfCycle; }
+
+  private:
+    const int *_pins;
+    size_t _count;
+    unsigned long _cycleMs;
+    int _closedLevel;
+    uint8_t _zcPin;
+    uint32_t _halfCycle;                  // [us] nominal, from cycleMs
+
+    SigmaDelta _mod[MAX_OUTPUTS];
+    bool _closed[MAX_OUTPUTS];
+    volatile bool _cut;
+    volatile unsigned long _lastCrossing;
+    volatile unsigned long _crossings;    // half-cycles since the detector (re)locked
+    Ticker _cycle;
+
+    static SsrSigmaDelta *_instance;
+    static void IRAM_ATTR _zeroCrossIsr();
+    void IRAM_ATTR _onZeroCross();
+    void IRAM_ATTR _write(size_t i, bool closed);
+};
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+/*
+ * Single-producer single-consumer ring, for handing data from an ISR (or a
+ * Ticker) to loop() without turning interrupts off.
+ *
+ * Head and tail are free-running 32-bit counters, masked into the N slots:
+ * N a power of two keeps that right across their wrap. Each is written by
+ * one side only, and published with release ordering after the slot it
+ * covers, so whoever acquires it sees the data: memw on the ESP8266, real
+ * fences on a multicore host.
+ *
+ * Two ways to use it, not to be mixed on one ring:
+ *
+ *   queue    push() / pop(): nothing is lost, push() fails when full.
+ *            Door edges, events.
+ *
+ *   window   record() / window(): the producer never waits and overwrites
+ *            the oldest ; the consumer copies the last n items whenever it
+ *            likes. ADC samples, zero-cross timestamps.
+ *
+ *   SpscRing<uint32_t, 8> crossings;
+ *   crossings.record(micros());            // ISR
+ *   uint32_t t[7];
+ *   size_t n = crossings.window(t, 7);     // loop(), oldest first
+ */
+template <class T, size_t N>
+class SpscRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing capacity must be a power of two");
+
+  public:
+    static constexpr size_t CAPACITY = N;
+
+    // ---- producer ----
+
+    bool push(const T &item) {
+      uint32_t head = _head.load(std::memory_order_relaxed);
+      if (head - _tail.load(std::memory_order_acquire) == N) return false;
+      _items[head & MASK] = item;
+      _head.store(head + 1, std::memory_order_release);
+      return true;
+    }
+
+    // window use: overwrites the oldest, never fails
+    void record(const T &item) {
+      uint32_t head = _head.load(std::memory_order_relaxed);
+      _items[head & MASK] = item;
+      // from 2^32 - 1 on to N, the same slot: a full ring never reads as a new one
+      _head.store(head + 1 ? head + 1 : N, std::memory_order_release);
+    }
+
+    // the item recorded age records ago, 0 the latest: T() before there was one.
+    // Producer side only, as the consumer may see it being overwritten.
+    const T &recent(size_t age) const {
+      return _items[(_head.load(std::memory_order_relaxed) - 1 - age) & MASK];
+    }
+
+    // ---- consumer ----
+
+    bool pop(T &item) {
+      uint32_t tail = _tail.load(std::memory_order_relaxed);
+      if (tail == _head.load(std::memory_order_acquire)) return false;
+      item = _items[tail & MASK];
+      _tail.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+    // up to max items, oldest first ; how many
+    size_t pop(T *out, size_t max) {
+      uint32_t tail = _tail.load(std::memory_order_relaxed);
+      size_t n = _head.load(std::memory_order_acquire) - tail;
+      if (n > max) n = max;
+      for (size_t i = 0; i < n; i++) out[i] = _items[(tail + i) & MASK];
+      _tail.store(tail + n, std::memory_order_release);
+      return n;
+    }
+
+    // Queue use: items waiting. Either side, a lower bound for the consumer.
+    size_t size() const {
+      return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+    bool empty() const { return size() == 0; }
+
+    // Window use: the last n (at most N - 1, the slot of the next record being
+    // fair game) items recorded, oldest first ; how many. The head is read
+    // again after the copy: items the producer may have overwritten meanwhile
+    // are dropped from the front, never returned torn.
+    size_t window(T *out, size_t n) const {
+      uint32_t head = _head.load(std::memory_order_acquire);
+      if (n > N - 1) n = N - 1;
+      if (n > head) n = head;                    // fewer recorded yet
+      uint32_t from = head - n;
+      for (size_t i = 0; i < n; i++) out[i] = _items[(from + i) & MASK];
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+      uint32_t now = _head.load(std::memory_order_relaxed);
+      // the slot of item now is being written, and held item now - N
+      int32_t lost = (int32_t)(now - N + 1 - from);
+      if (lost <= 0) return n;
+      if ((size_t)lost >= n) return 0;
+      for (size_t i = lost; i < n; i++) out[i - lost] = out[i];
+      return n - lost;
+    }
+
+    // items recorded (or pushed) since the start, modulo 2^32: tells a window
+    // reader how far the producer went between two looks
+    uint32_t recorded() const { return _head.load(std::memory_order_acquire); }
+
+  private:
+    static constexpr uint32_t MASK = N - 1;
+
+    T _items[N] = {};
+    std::atomic<uint32_t> _head{0};
+    std::atomic<uint32_t> _tail{0};
+};
+
+#endif // SPSC_RING_H
@@ -0,0 +1,69 @@
+#include "ssr_window.h"
+
+SsrWindow::SsrWindow(const int *pins, size_t count, unsigned long windowMs, int closedLevel)
+  : _pins(pins), _count(count < MAX_OUTPUTS ? count : MAX_OUTPUTS), _windowMs(windowMs),
+    _closedLevel(closedLevel), _windowStart(0), _cut(false) {
+  for (size_t i = 0; i < MAX_OUTPUTS; i++) {
+    _duty[i] = 0;
+    _onMs[i] = 0;
+  }
+}
+
+void SsrWindow::begin() {
+  _startWindow();
+  _window.attach_ms(_windowMs, [this]() { _startWindow(); });
+}
+
+void SsrWindow::publish(const float *duty) {
+  unsigned long elapsed = millis() - _windowStart;
+
+  for (size_t i = 0; i < _count; i++) {
+    float d = duty[i] < 0 ? 0 : (duty[i] > 1 ? 1 : duty[i]);
+    _duty[i] = d;
+
+    unsigned long on = d * _windowMs + .5;
+    if (on >= _onMs[i]) continue;         // more power: from the next window on
+
+    // less power: shorten the running pulse
+    _onMs[i] = on;
+    if (on <= elapsed) {
+      _open(i);
+    } else {
+      _off[i].once_ms(on - elapsed, [this, i]() { _open(i); });
+    }
+  }
+}
+
+void IRAM_ATTR SsrWindow::cutoff() {
+  _cut = true;
+  for (size_t i = 0; i < _count; i++) digitalWrite(_pins[i], _closedLevel == LOW ? HIGH : LOW);
+}
+
+void SsrWindow::resume() {
+  _cut = false;
+}
+
+void SsrWindow::_startWindow() {
+  _windowStart = millis();
+  for (size_t i = 0; i < _count; i++) {
+    _onMs[i] = _duty[i] * _windowMs + .5;
+    if (!_onMs[i]) {
+      _open(i);
+    } else {
+      _close(i);
+      if (_onMs[i] < _windowMs) _off[i].once_ms(_onMs[i], [this, i]() { _open(i); });
+    }
+  }
+}
+
+void SsrWindow::_open(size_t i) {
+  _off[i].detach();
+  digitalWrite(_pins[i], _closedLevel == LOW ? HIGH : LOW);
+}
+
+void SsrWindow::_close(size_t i) {
+  _off[i].detach();
+  noInterrupts();   // not between cutoff() and its write
+  if (!_cut) digitalWrite(_pins[i], _closedLevel);
+  interrupts();
+}
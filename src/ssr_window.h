@@ -0,0 +1,50 @@
+#ifndef SSR_WINDOW_H
+#define SSR_WINDOW_H
+
+#include <Arduino.h>
+#include <Ticker.h>
+
+/*
+ * Time-proportional SSR output driven by timers instead of loop() polling.
+ *
+ * A periodic Ticker opens each window: outputs with a non-zero duty cycle are
+ * closed, and a one-shot Ticker per output opens it again at duty * window ms.
+ * The control code only publishes duty cycles ; the edges no longer depend
+ * on how long loop() takes.
+ *
+ * A new duty cycle takes effect at the next window, except that a lower one
+ * cuts the current on-time short right away (door, disable...).
+ */
+class SsrWindow {
+  public:
+    static constexpr size_t MAX_OUTPUTS = 9;
+
+    SsrWindow(const int *pins, size_t count, unsigned long windowMs, int closedLevel = LOW);
+
+    void begin();                         // pins must already be outputs
+    void publish(const float *duty);      // 0..1 per output
+    void IRAM_ATTR cutoff();              // all open now, from an ISR too ; and until resume()
+    void resume();                        // closes again from the next window
+    float duty(size_t i) const { return i < _count ? _duty[i] : 0; }
+    unsigned long windowMs() const { return _windowMs; }
+
+  private:
+    const int *_pins;
+    size_t _count;
+    unsigned long _windowMs;
+    int _closedLevel;
+
+    float _duty[MAX_OUTPUTS];             // what the next window will apply
+    unsigned long _onMs[MAX_OUTPUTS];     // on-time in the running window
+    unsigned long _windowStart;
+    volatile bool _cut;
+
+    Ticker _window;
+    Ticker _off[MAX_OUTPUTS];
+
+    void _startWindow();
+    void _open(size_t i);
+    void _close(size_t i);
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef STAGER_H
+#define STAGER_H
+/*
+ * Staged power allocation over N heater outputs of arbitrary wattage.
+ *
+ * A power fraction is met by turning whole outputs fully on, largest first,
+ * and time-proportioning the smallest output left over for the remainder:
+ * whatever the number of elements, at most one output is PWM-switched at a
+ * time. Outputs taken out of PID control (forced on or off) are skipped, the
+ * fraction then applies to the power of the outputs still under control.
+ *
+ * The order in which outputs are considered only depends on the wattage
+ * table, so it is sorted at compile time:
+ *
+ *   constexpr float watts[] = { 1500, 3000, 1500 };
+ *   constexpr auto stages = makeStagingTable(watts);
+ *   stages.allocate(Output, pidMask, relayDutyCycles);
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+template <size_t N>
+struct StagingTable {
+  static_assert(N > 0 && N <= 32, "one bit per output in the eligibility mask");
+
+  float watts[N];
+  uint8_t order[N];   // output indices by decreasing power, ties in wiring order
+
+  // total power of the outputs set in `mask`
+  float power(uint32_t mask) const {
+    float p = 0;
+    for (size_t i = 0; i < N; i++) {
+      if (mask & (1UL << i)) p += watts[i];
+    }
+    return p;
+  }
+
+  // fills duty[] (0..1) for the outputs in `mask`, others are zeroed ;
+  // returns the index of the modulated output, or -1 if none is
+  int allocate(double fraction, uint32_t mask, float *duty) const {
+    for (size_t i = 0; i < N; i++) duty[i] = 0;
+    if (fraction <= 0) return -1;
+    if (fraction > 1) fraction = 1;
+
+    float left = fraction * power(mask);
+    int pwm = -1;
+    for (size_t k = 0; k < N; k++) {
+      uint8_t i = order[k];
+      if (!(mask & (1UL << i))) continue;
+      if (watts[i] <= left) {
+        duty[i] = 1;
+        left -= watts[i];
+      } else {
+        pwm = i;          // outputs come largest first: the last one skipped is the smallest
+      }
+    }
+    if (pwm < 0 || left <= 0) return -1;
+    duty[pwm] = left / watts[pwm];
+    return pwm;
+  }
+};
+
+template <size_t N>
+constexpr StagingTable<N> makeStagingTable(const float (&watts)[N]) {
+  StagingTable<N> t = {};
+  for (size_t i = 0; i < N; i++) {
+    t.watts[i] = watts[i];
+    t.order[i] = i;
+  }
+  // insertion sort: stable, and N is a handful of elements
+  for (size_t i = 1; i < N; i++) {
+    uint8_t o = t.order[i];
+    size_t j = i;
+    for (; j > 0 && watts[t.order[j - 1]] < watts[o]; j--) t.order[j] = t.order[j - 1];
+    t.order[j] = o;
+  }
+  return t;
+}
+
+#endif
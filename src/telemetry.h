@@ -0,0 +1,88 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <Arduino.h>
+
+/*
+ * Delta telemetry: a field is only sent when it moved by more than its
+ * deadband since the value last sent, so a settled sauna costs next to no
+ * airtime. Every so often a keyframe sends everything, for clients that
+ * missed a frame or just connected.
+ *
+ *   if (tTemp.update(Input, telemetry.keyframe())) jb.addValue("temp", Input);
+ */
+class Deadband {
+  public:
+    explicit Deadband(float band) : _band(band), _last(0), _valid(false) {}
+
+    // true when v must go out ; v is then what the clients know
+    bool update(float v, bool force = false) {
+      if (!force && _valid && !_moved(_last, v)) return false;
+      _last = v;
+      _valid = true;
+      return true;
+    }
+
+  protected:
+    float _band;
+
+    bool _moved(float last, float v) const {
+      if (isnan(v) || isnan(last)) return isnan(v) != isnan(last);
+      return fabsf(v - last) > _band;
+    }
+
+  private:
+    float _last;
+    bool _valid;
+};
+
+// an array goes out as a whole as soon as one element moved
+template <size_t N>
+class DeadbandArray : protected Deadband {
+  public:
+    explicit DeadbandArray(float band) : Deadband(band), _valid(false) {}
+
+    template <typename T>
+    bool update(const T (&v)[N], bool force = false) {
+      bool moved = force || !_valid;
+      for (size_t i = 0; i < N && !moved; i++) moved = _moved(_last[i], v[i]);
+      if (!moved) return false;
+      for (size_t i = 0; i < N; i++) _last[i] = v[i];
+      _valid = true;
+      return true;
+    }
+
+  private:
+    float _last[N];
+    bool _valid;
+};
+
+class Telemetry {
+  public:
+    typedef unsigned long (*Clock)();
+
+    explicit Telemetry(unsigned long keyframeMs, Clock clock = millis)
+      : _keyframeMs(keyframeMs), _clock(clock), _lastKeyframe(0), _keyframe(false), _forced(true) {}
+
+    // once per telemetry tick, before the fields are updated
+    void beginTick() {
+      unsigned long now = _clock();
+      _keyframe = _forced || now - _lastKeyframe >= _keyframeMs;
+      if (_keyframe) {
+        _lastKeyframe = now;
+        _forced = false;
+      }
+    }
+
+    bool keyframe() const { return _keyframe; }
+    void requestKeyframe() { _forced = true; }   // next tick sends everything
+
+  private:
+    unsigned long _keyframeMs;
+    Clock _clock;
+    unsigned long _lastKeyframe;
+    bool _keyframe;
+    bool _forced;
+};
+
+#endif
@@ -0,0 +1,286 @@
+#ifndef TELEMETRY_FRAME_H
+#define TELEMETRY_FRAME_H
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+/*
+ * Broadcast frame: what changed within a tick, rendered once per protocol
+ * when it is flushed. JSON stays the default ; a client that sends
+ * "proto:bin1" gets WS_BINARY records instead (decoder in data/sauna.js):
+ *
+ *   byte 0      version (1)
+ *   bytes 1-2   field presence bitmap, bit n = Field n
+ *   then, for each present field in bit order, little endian:
+ *     bool      u8 0/1                    enabled, door (1: open)
+ *     fixed     i16 or u16, value*scale   0x8000 / 0xffff when NaN
+ *     array     u8 count, then items      modes and states as u8
+ *     client    4 x u8 (IPv4)
+ *
+ * Rendering takes a field mask, so a client that fell behind can be sent
+ * the latest value of just the fields it missed (see FrameClients).
+ */
+class TelemetryFrame {
+  public:
+    enum Field : uint8_t {
+      ENABLED, TARGET, PID, TEMP, AMBIANT, DOOR,
+      RELAY_MODES, RELAY_STATES, DUTY_CYCLES, VOLTAGES, CLIENT,
+      FIELDS
+    };
+    static constexpr uint8_t VERSION = 1;
+    static constexpr size_t MAX_ITEMS = 9;
+    static constexpr size_t MAX_BINARY = 3 + 1 + 4 * 2 + 1 + 2 * (1 + MAX_ITEMS) + 2 * (1 + 2 * MAX_ITEMS) + 4;
+
+    TelemetryFrame() : _present(0) {}
+
+    void clear() { _present = 0; }
+    bool empty() const { return !_present; }
+    uint16_t present() const { return _present; }
+
+    // takes the fields set in newer, keeps the others
+    void merge(const TelemetryFrame &newer) {
+      for (uint8_t f = 0; f < FIELDS; f++) {
+        if (newer._present & (1U << f)) _set((Field)f, newer._v[f], newer._n[f]);
+      }
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_arithmetic<T>::value || std::is_enum<T>::value>::type
+    set(Field f, T v) {
+      float x = v;
+      _set(f, &x, 1);
+    }
+
+    template <typename T, size_t N>
+    void set(Field f, const T (&arr)[N]) {
+      float v[N];
+      for (size_t i = 0; i < N; i++) v[i] = arr[i];
+      _set(f, v, N);
+    }
+
+    void set(Field f, const IPAddress &ip) {
+      float v[4] = { (float)ip[0], (float)ip[1], (float)ip[2], (float)ip[3] };
+      _set(f, v, 4);
+    }
+
+    // same keys and precision as the JSON frames have always had
+    template <class J>
+    void toJson(J &jb, uint16_t mask = 0xffff) const {
+      for (uint8_t f = 0; f < FIELDS; f++) {
+        if (!(_present & mask & (1U << f))) continue;
+        const Spec &s = _spec(f);
+        const float *v = _v[f];
+        switch (s.type) {
+          case T_BOOL:  jb.addValue(s.key, *v != 0); break;
+          case T_DOOR:  jb.addValue(s.key, *v != 0 ? "open" : "closed"); break;
+          case T_S16:
+          case T_U16:   jb.addValue(s.key, *v, s.decimals); break;
+          case T_U8S:
+          case T_U16S:  jb.addValue(s.key, v, _n[f], s.decimals); break;
+          case T_IP: {
+            char ip[16];
+            size_t p = 0;
+            for (size_t i = 0; i < 4; i++) {
+              uint8_t b = v[i];
+              if (i) ip[p++] = '.';
+              if (b >= 100) ip[p++] = '0' + b / 100;
+              if (b >= 10) ip[p++] = '0' + b / 10 % 10;
+              ip[p++] = '0' + b % 10;
+            }
+            ip[p] = '\0';
+            jb.addValue(s.key, (const char *)ip);
+            break;
+          }
+        }
+      }
+    }
+
+    // out must hold MAX_BINARY bytes ; returns the record length
+    size_t toBinary(uint8_t *out, uint16_t mask = 0xffff) const {
+      uint16_t present = _present & mask;
+      size_t p = 0;
+      out[p++] = VERSION;
+      out[p++] = present & 0xff;
+      out[p++] = present >> 8;
+      for (uint8_t f = 0; f < FIELDS; f++) {
+        if (!(present & (1U << f))) continue;
+        const Spec &s = _spec(f);
+        const float *v = _v[f];
+        switch (s.type) {
+          case T_BOOL:
+          case T_DOOR:  out[p++] = *v != 0; break;
+          case T_S16:   p = _put16(out, p, _fixed(*v, s.scale, -32767, 32767, 0x8000)); break;
+          case T_U16:   p = _put16(out, p, _fixed(*v, s.scale, 0, 65534, 0xffff)); break;
+          case T_U8S:
+            out[p++] = _n[f];
+            for (size_t i = 0; i < _n[f]; i++) out[p++] = (uint8_t)v[i];
+            break;
+          case T_U16S:
+            out[p++] = _n[f];
+            for (size_t i = 0; i < _n[f]; i++) p = _put16(out, p, _fixed(v[i], s.scale, 0, 65534, 0xffff));
+            break;
+          case T_IP:
+            for (size_t i = 0; i < 4; i++) out[p++] = (uint8_t)v[i];
+            break;
+        }
+      }
+      return p;
+    }
+
+  private:
+    enum Type : uint8_t { T_BOOL, T_DOOR, T_S16, T_U16, T_U8S, T_U16S, T_IP };
+    struct Spec {
+      const char *key;
+      Type type;
+      uint16_t scale;      // binary fixed point
+      uint8_t decimals;    // JSON
+    };
+    static const Spec &_spec(uint8_t f) {
+      static const Spec specs[FIELDS] = {
+        { "enabled",         T_BOOL,  1,     0 },
+        { "target",          T_S16,   100,   3 },
+        { "pid",             T_U16,   10000, 3 },
+        { "temp",            T_S16,   100,   2 },
+        { "ambiant",         T_S16,   100,   2 },
+        { "door",            T_DOOR,  1,     0 },
+        { "relayModes",      T_U8S,   1,     0 },
+        { "relayStates",     T_U8S,   1,     0 },
+        { "relayDutyCycles", T_U16S,  10000, 3 },
+        { "voltages",        T_U16S,  10,    1 },
+        { "client",          T_IP,    1,     0 },
+      };
+      return specs[f];
+    }
+
+    uint16_t _present;
+    uint8_t _n[FIELDS];
+    float _v[FIELDS][MAX_ITEMS];
+
+    void _set(Field f, const float *v, size_t n) {
+      if (f >= FIELDS) return;
+      if (n > MAX_ITEMS) n = MAX_ITEMS;
+      for (size_t i = 0; i < n; i++) _v[f][i] = v[i];
+      _n[f] = n;
+      _present |= 1U << f;
+    }
+
+    static uint16_t _fixed(float v, uint16_t scale, long lo, long hi, uint16_t nan) {
+      if (isnan(v)) return nan;
+      float x = v * scale;
+      long q = x < 0 ? (long)(x - .5f) : (long)(x + .5f);
+      if (x < lo) q = lo;
+      if (x > hi) q = hi;
+      return (uint16_t)q;
+    }
+
+    static size_t _put16(uint8_t *out, size_t p, uint16_t v) {
+      out[p++] = v & 0xff;
+      out[p++] = v >> 8;
+      return p;
+    }
+};
+
+/*
+ * Protocol and outbound state of each websocket client, so a flush only
+ * builds the encodings someone listens to and a slow link cannot pile up
+ * frames in the library's queue (and heap) for everyone.
+ *
+ * Telemetry is only handed to a client whose queue is empty. Otherwise the
+ * fields of the frame are held, and the client gets their latest values in
+ * one frame once its queue drains: newer frames replace older ones instead
+ * of queueing behind them. Command replies bypass this and always go out.
+ * A client whose queue stays non-empty for LAG_BUDGET_MS is evicted.
+ */
+class FrameClients {
+  public:
+    static constexpr size_t MAX = 8;   // AsyncWebSocket::cleanupClients() default
+    static constexpr unsigned long LAG_BUDGET_MS = 5000;
+
+    enum Action : uint8_t { SEND, HOLD, EVICT };
+
+    FrameClients() : _count(0), _binary(0), _evicted(0) {}
+
+    // false when all MAX slots are taken: that client would get no telemetry
+    bool add(uint32_t id) {
+      if (_find(id) >= 0) return true;
+      if (_count >= MAX) return false;
+      _clients[_count++] = { id, false, 0, 0, 0, 0 };
+      return true;
+    }
+
+    void remove(uint32_t id) {
+      int i = _find(id);
+      if (i < 0) return;
+      if (_clients[i].binary) _binary--;
+      _clients[i] = _clients[--_count];
+    }
+
+    bool setBinary(uint32_t id, bool binary) {
+      int i = _find(id);
+      if (i < 0) return false;
+      if (_clients[i].binary != binary) {
+        if (binary) _binary++; else _binary--;
+        _clients[i].binary = binary;
+      }
+      return true;
+    }
+
+    // a frame with these fields (possibly none) for client i, whose library
+    // queue holds `queued` messages ; on SEND, mask is what to render
+    Action offer(size_t i, uint16_t fields, size_t queued, unsigned long now, uint16_t &mask) {
+      Client &c = _clients[i];
+      if (queued > c.maxQueue) c.maxQueue = queued;
+      if (!queued) {
+        c.laggingSince = 0;
+        mask = c.held | fields;
+        c.held = 0;
+        return mask ? SEND : HOLD;
+      }
+      if (!c.laggingSince) c.laggingSince = now ? now : 1;
+      if (fields) {
+        if (c.held) c.dropped++;     // replaces the frame held so far
+        c.held |= fields;
+      }
+      if (now - c.laggingSince < LAG_BUDGET_MS) return HOLD;
+      _evicted++;
+      return EVICT;
+    }
+
+    bool holding() const {
+      for (size_t i = 0; i < _count; i++) {
+        if (_clients[i].held) return true;
+      }
+      return false;
+    }
+
+    size_t count() const { return _count; }
+    size_t binaryCount() const { return _binary; }
+    uint32_t id(size_t i) const { return _clients[i].id; }
+    bool binary(size_t i) const { return _clients[i].binary; }
+    uint16_t maxQueue(size_t i) const { return _clients[i].maxQueue; }  // deepest seen by a flush
+    uint32_t dropped(size_t i) const { return _clients[i].dropped; }   // frames merged into a later one
+    uint32_t evicted() const { return _evicted; }                      // since boot
+
+  private:
+    struct Client {
+      uint32_t id;
+      bool binary;
+      uint16_t held;                // fields owed
+      uint16_t maxQueue;
+      uint32_t dropped;
+      unsigned long laggingSince;   // 0: queue empty at the last flush
+    };
+    Client _clients[MAX];
+    size_t _count;
+    size_t _binary;
+    uint32_t _evicted;
+
+    int _find(uint32_t id) const {
+      for (size_t i = 0; i < _count; i++) {
+        if (_clients[i].id == id) return i;
+      }
+      return -1;
+    }
+};
+
+#endif
@@ -0,0 +1,35 @@
+#include "tempsensors.h"
+
+AsyncTempSensors::AsyncTempSensors(DallasTemperature &bus, const uint8_t *addr0, const uint8_t *addr1,
+                                   Clock clock)
+  : _bus(bus), _addr{addr0, addr1}, _clock(clock),
+    _state(RESULT_READY), _requestedAt(0), _conversionTime(750),
+    _values{DEVICE_DISCONNECTED_C, DEVICE_DISCONNECTED_C} {}
+
+void AsyncTempSensors::begin() {
+  _bus.setWaitForConversion(false);
+  _conversionTime = _bus.millisToWaitForConversion(_bus.getResolution());
+  _request();
+}
+
+void AsyncTempSensors::_request() {
+  _bus.requestTemperatures();   // returns immediately, conversion runs on the sensors
+  _requestedAt = _clock();
+  _state = CONVERSION_REQUESTED;
+}
+
+bool AsyncTempSensors::poll() {
+  if (_state == RESULT_READY) {
+    _request();
+    return false;
+  }
+
+  // 32-bit unsigned arithmetic: safe across millis() rollover, whatever the width of unsigned long
+  if ((uint32_t)(_clock() - _requestedAt) < _conversionTime) return false;
+
+  for (size_t i = 0; i < 2; i++) {
+    _values[i] = _bus.getTempC(_addr[i]);
+  }
+  _state = RESULT_READY;
+  return true;
+}
@@ -0,0 +1,42 @@
+#ifndef TEMPSENSORS_H
+#define TEMPSENSORS_H
+
+#include <Arduino.h>
+#include <DallasTemperature.h>
+
+/*
+ * Non-blocking reader for the two DS18B20 sensors (process and ambiant).
+ *
+ * A conversion is started on the bus and left running ; the results are only
+ * read back once its millis() deadline has passed, so loop() never sits in
+ * DallasTemperature's blocking wait (~750 ms at 12 bits).
+ */
+class AsyncTempSensors {
+  public:
+    enum State { CONVERSION_REQUESTED, RESULT_READY };
+    typedef unsigned long (*Clock)();
+
+    AsyncTempSensors(DallasTemperature &bus, const uint8_t *addr0, const uint8_t *addr1,
+                     Clock clock = millis);
+
+    void begin();             // call after bus.begin() and address discovery
+    bool poll();              // true right after a fresh set of readings was stored
+
+    State state() const { return _state; }
+    float value(size_t i) const { return i < 2 ? _values[i] : DEVICE_DISCONNECTED_C; }
+    unsigned long conversionTime() const { return _conversionTime; }
+
+  private:
+    DallasTemperature &_bus;
+    const uint8_t *_addr[2];
+    Clock _clock;
+
+    State _state;
+    unsigned long _requestedAt;
+    unsigned long _conversionTime;
+    float _values[2];
+
+    void _request();
+};
+
+#endif
@@ -0,0 +1,154 @@
+#include "triac.h"
+#include <math.h>
+
+static_assert(TriacPhaseControl::STAGGER_US >= TriacPhaseControl::GATE_PULSE_US,
+              "a gate is released before the next one fires: edges stay in order");
+
+TriacPhaseControl *TriacPhaseControl::_instance = nullptr;
+
+// timer1 at 80 MHz / 16
+static const uint32_t TICKS_PER_US = 5;
+static const uint32_t MIN_TICKS = 10;
+
+TriacPhaseControl::TriacPhaseControl(const int *pins, size_t count, uint8_t zeroCrossPin, unsigned int mainsHz, int gateLevel)
+  : _pins(pins), _count(count < MAX_OUTPUTS ? count : MAX_OUTPUTS), _zcPin(zeroCrossPin),
+    _halfCycle(500000UL / (mainsHz ? mainsHz : 50)), _gateLevel(gateLevel),
+    _active(0), _plan(&_plans[0]), _next(0), _lastCrossing(0), _crossings(0), _cut(false) {
+  _plans[0].count = _plans[1].count = 0;
+
+  // linearization: firing angle that delivers power i/(LUT_SIZE-1), by bisection
+  for (size_t i = 0; i < LUT_SIZE; i++) {
+    double target = (double)i / (LUT_SIZE - 1);
+    double lo = 0, hi = M_PI;
+    for (int k = 0; k < 24; k++) {
+      double a = (lo + hi) / 2;
+      double p = 1 - a / M_PI + sin(2 * a) / (2 * M_PI);
+      if (p > target) lo = a; else hi = a;
+    }
+    _lut[i] = (uint16_t)((lo + hi) / 2 / M_PI * _halfCycle + .5);
+  }
+}
+
+uint32_t TriacPhaseControl::delayFor(float power) const {
+  if (power <= 0) return 0;
+  if (power >= 1) return MIN_DELAY_US;
+
+  float x = power * (LUT_SIZE - 1);
+  size_t i = (size_t)x;
+  float f = x - i;
+  uint32_t d = _lut[i] + f * ((float)_lut[i + 1] - _lut[i]) + .5f;
+
+  if (d < MIN_DELAY_US) return MIN_DELAY_US;
+  if (d > _halfCycle - END_MARGIN_US) return 0;     // a fraction of a percent: not worth a misfire
+  return d;
+}
+
+uint32_t TriacPhaseControl::measuredHalfCycleUs() const {
+  if (!mainsPresent()) return 0;
+  uint32_t t[decltype(_crossingTimes)::CAPACITY];
+  size_t n = _crossingTimes.window(t, sizeof(t) / sizeof(t[0]));
+  // a crossing lost to noise shows as a double gap: only what follows the last one
+  size_t first = 0;
+  for (size_t i = 1; i < n; i++) {
+    if (t[i] - t[i - 1] > _halfCycle * 3 / 2) first = i;
+  }
+  return n - first > 1 ? (t[n - 1] - t[first]) / (n - 1 - first) : 0;
+}
+
+void TriacPhaseControl::begin() {
+  _instance = this;
+  for (size_t i = 0; i < _count; i++) _gate(i, false);
+
+  pinMode(_zcPin, INPUT);
+  timer1_isr_init();
+  timer1_attachInterrupt(_timerIsr);
+  timer1_enable(TIM_DIV16, TIM_EDGE, TIM_SINGLE);
+  attachInterrupt(digitalPinToInterrupt(_zcPin), _zeroCrossIsr, RISING);
+}
+
+void TriacPhaseControl::publish(const float *power) {
+  // firing delays, earliest first
+  uint32_t at[MAX_OUTPUTS];
+  uint8_t order[MAX_OUTPUTS];
+  size_t n = 0;
+  for (size_t i = 0; i < _count; i++) {
+    uint32_t d = delayFor(power[i]);
+    if (!d) continue;
+    size_t j = n++;
+    for (; j > 0 && at[j - 1] > d; j--) {
+      at[j] = at[j - 1];
+      order[j] = order[j - 1];
+    }
+    at[j] = d;
+    order[j] = i;
+  }
+
+  Plan plan;
+  plan.count = 0;
+  uint32_t last = 0;
+  for (size_t k = 0; k < n; k++) {
+    uint32_t d = at[k];
+    if (plan.count && d < last + STAGGER_US) d = last + STAGGER_US;
+    if (d > _halfCycle - END_MARGIN_US) break;
+    plan.edges[plan.count++] = { d, order[k], true };
+    plan.edges[plan.count++] = { d + GATE_PULSE_US, order[k], false };
+    last = d;
+  }
+
+  // hand over to the ISRs, never into the plan of the half-cycle being fired
+  noInterrupts();
+  uint8_t target = _plan == &_plans[0] ? 1 : 0;
+  _plans[target] = plan;
+  _active = target;
+  interrupts();
+}
+
+void IRAM_ATTR TriacPhaseControl::cutoff() {
+  _cut = true;
+  for (size_t i = 0; i < _count; i++) _gate(i, false);
+}
+
+void TriacPhaseControl::resume() {
+  _cut = false;
+}
+
+void IRAM_ATTR TriacPhaseControl::_zeroCrossIsr() {
+  if (_instance) _instance->_onZeroCross();
+}
+
+void IRAM_ATTR TriacPhaseControl::_timerIsr() {
+  if (_instance) _instance->_onTimer();
+}
+
+void IRAM_ATTR TriacPhaseControl::_onZeroCross() {
+  unsigned long now = micros();
+  if (_crossings && now - _lastCrossing < _halfCycle * 3 / 4) return;   // detector ringing
+  _lastCrossing = now;
+  _crossings++;
+  _crossingTimes.record(now);
+
+  for (size_t i = 0; i < _count; i++) _gate(i, false);   // whatever happened, start clean
+  _plan = &_plans[_active];
+  _next = 0;
+  if (_plan->count) _arm(_plan->edges[0].at);
+}
+
+void IRAM_ATTR TriacPhaseControl::_onTimer() {
+  uint32_t t = micros() - _lastCrossing;
+  while (_next < _plan->count && _plan->edges[_next].at <= t + 2) {
+    const Edge &e = _plan->edges[_next++];
+    _gate(e.output, e.gate);
+  }
+  if (_next < _plan->count) _arm(_plan->edges[_next].at);
+}
+
+void IRAM_ATTR TriacPhaseControl::_arm(uint32_t at) {
+  uint32_t t = micros() - _lastCrossing;
+  uint32_t ticks = at > t ? (at - t) * TICKS_PER_US : 0;
+  timer1_write(ticks < MIN_TICKS ? MIN_TICKS : ticks);
+}
+
+void IRAM_ATTR TriacPhaseControl::_gate(uint8_t output, bool on) {
+  if (on && _cut) return;
+  digitalWrite(_pins[output], on ? _gateLevel : (_gateLevel == LOW ? HIGH : LOW));
+}
@@ -0,0 +1,78 @@
+#ifndef TRIAC_H
+#define TRIAC_H
+
+#include <Arduino.h>
+#include "spsc_ring.h"
+
+/*
+ * Phase-angle control of TRIAC outputs (SMOOTH_TRIAC).
+ *
+ * A zero-crossing detector interrupts at the start of every mains half-cycle ;
+ * timer1 then fires each output's gate at its delay into the half-cycle, with
+ * a short pulse (the TRIAC latches until the next zero). No zero crossing, no
+ * firing: outputs fall off by themselves if the detector or the mains go away.
+ *
+ * publish() takes power fractions, not angles: the power of a resistive load
+ * fired at angle a is 1 - a/pi + sin(2a)/(2pi), inverted once into a table.
+ * Gates are kept at least STAGGER_US apart so the outputs do not all switch
+ * their inrush at the same instant.
+ */
+class TriacPhaseControl {
+  public:
+    static constexpr size_t MAX_OUTPUTS = 9;
+    static constexpr size_t LUT_SIZE = 65;              // power 0..1 in 1/64 steps
+    static constexpr uint32_t GATE_PULSE_US = 100;
+    static constexpr uint32_t STAGGER_US = 150;         // between two gates of one half-cycle
+    static constexpr uint32_t MIN_DELAY_US = 200;       // current must build up before the TRIAC latches
+    static constexpr uint32_t END_MARGIN_US = 400;      // too close to the next zero to latch
+
+    TriacPhaseControl(const int *pins, size_t count, uint8_t zeroCrossPin, unsigned int mainsHz = 50, int gateLevel = LOW);
+
+    void begin();                         // pins must already be outputs
+    void publish(const float *power);     // 0..1 per output, from loop()
+    void IRAM_ATTR cutoff();              // no more gates, from an ISR too, until resume() ;
+    void resume();                        // a TRIAC still conducts to the next zero
+
+    uint32_t delayFor(float power) const; // firing delay after the zero crossing [us], 0 for never
+    uint32_t halfCycleUs() const { return _halfCycle; }
+    unsigned long zeroCrossings() const { return _crossings; }
+    bool mainsPresent() const { return _crossings && micros() - _lastCrossing < 3 * _halfCycle; }
+    uint32_t measuredHalfCycleUs() const; // mean over the last zero crossings [us], 0 without mains
+
+  private:
+    struct Edge {
+      uint32_t at;                        // [us] after the zero crossing
+      uint8_t output;
+      bool gate;
+    };
+    struct Plan {
+      Edge edges[2 * MAX_OUTPUTS];
+      uint8_t count;
+    };
+
+    const int *_pins;
+    size_t _count;
+    uint8_t _zcPin;
+    uint32_t _halfCycle;
+    int _gateLevel;
+    uint16_t _lut[LUT_SIZE];
+
+    Plan _plans[2];                       // loop() fills one while the ISRs read the other
+    volatile uint8_t _active;
+    const Plan *_plan;                    // half-cycle being fired
+    uint8_t _next;
+    volatile unsigned long _lastCrossing;
+    volatile unsigned long _crossings;
+    volatile bool _cut;
+    SpscRing<uint32_t, 16> _crossingTimes;   // micros() of the last accepted crossings
+
+    static TriacPhaseControl *_instance;
+    static void IRAM_ATTR _zeroCrossIsr();
+    static void IRAM_ATTR _timerIsr();
+    void IRAM_ATTR _onZeroCross();
+    void IRAM_ATTR _onTimer();
+    void IRAM_ATTR _arm(uint32_t at);
+    void IRAM_ATTR _gate(uint8_t output, bool on);
+};
+
+#endif
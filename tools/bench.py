@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+# vim: noet ts=4 number
+"""Closed-loop benchmark: runs the native firmware against the thermal model
+(lib/sauna_sim) for every setpoint x gain set and tabulates the step response.
+
+Build first with `pio run -e native`.
+"""
+import argparse
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+from concurrent.futures import ThreadPoolExecutor
+
+PROGRAM = ".pio/build/native/program"
+COLUMNS = ["setpoint", "kp", "ki", "kd", "rise_s", "overshoot_c", "settling_s", "ripple_c", "kwh_to_setpoint", "kwh_total"]
+
+def staged_fs(src):
+	"""A private copy of the LittleFS directory for one run: the firmware writes
+	its flash log there and reads it back at boot, so parallel runs must not
+	share it (nor leave their log in the staging directory)."""
+	fs = tempfile.mkdtemp(prefix="bench.")
+	if os.path.isdir(src):
+		# without a flash log left there by an earlier run
+		top = os.path.abspath(src)
+		shutil.copytree(src, fs, dirs_exist_ok=True,
+			ignore=lambda d, names: ["log"] if os.path.abspath(d) == top and "log" in names else [])
+	return fs
+
+def run(program, setpoint, gains, args):
+	fs = staged_fs(args.fs)
+	cmd = [program, "--speed", "0", "--quiet", "--plant", "1",
+		"--input", "2=0", "--get", "/enable",
+		"--setpoint", str(setpoint), "--gains", gains,
+		"--duration", str(args.duration), "--band", str(args.band),
+		"--fs", fs]
+	for h in args.heater or []:
+		cmd += ["--heater", h]
+	if args.ambiant is not None:
+		cmd += ["--ambiant", str(args.ambiant)]
+
+	try:
+		out = subprocess.run(cmd, capture_output=True, text=True).stdout
+	finally:
+		shutil.rmtree(fs, ignore_errors=True)
+	for line in out.splitlines():
+		if line.startswith("bench "):
+			return dict(kv.split("=", 1) for kv in line.split()[1:])
+	return None
+
+def main():
+	p = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+	p.add_argument("-s", "--setpoints", default="60,80,95", help="comma separated setpoints [C]")
+	p.add_argument("-g", "--gains", action="append", help="KP:KI:KD, repeatable (default: firmware gains)")
+	p.add_argument("-d", "--duration", type=int, default=3 * 3600, help="virtual seconds per run")
+	p.add_argument("--band", type=float, default=1.0, help="settling band [C]")
+	p.add_argument("--heater", action="append", help="PIN:W heater element, repeatable")
+	p.add_argument("--ambiant", type=float, help="room temperature [C]")
+	p.add_argument("--fs", default=".pio/littlefs", help="LittleFS host directory, copied for each run")
+	p.add_argument("--program", default=PROGRAM)
+	p.add_argument("-j", "--jobs", type=int, default=4)
+	args = p.parse_args()
+
+	setpoints = [float(s) for s in args.setpoints.split(",")]
+	gains = args.gains or ["5:2:2"]
+	matrix = [(s, g) for g in gains for s in setpoints]
+
+	with ThreadPoolExecutor(args.jobs) as pool:
+		results = list(pool.map(lambda m: run(args.program, m[0], m[1], args), matrix))
+
+	print("\t".join(COLUMNS))
+	failed = 0
+	for (s, g), r in zip(matrix, results):
+		if r is None:
+			print(f"{s}\t{g}\tno bench line (did the firmware boot?)", file=sys.stderr)
+			failed += 1
+			continue
+		print("\t".join(r.get(c, "-") for c in COLUMNS))
+	return 1 if failed else 0
+
+if __name__ == "__main__":
+	sys.exit(main())
@@ -0,0 +1,204 @@
+#!/usr/bin/env python3
+# vim: noet ts=4 number
+"""Builds the LittleFS image contents from data/ (which stays the editable source):
+
+  - stylesheets and local scripts linked from index.html are minified and
+    bundled into one app.<hash>.css and one app.<hash>.js
+  - every file referenced from the page or the stylesheet is renamed
+    <name>.<hash>.<ext>, so it can be cached for good: a new version is a new URL
+  - files are stored as <name>.gz when gzip makes them smaller (text, SVG...),
+    as is otherwise (JPEG, PNG: already compressed)
+  - /assets.txt lists what the firmware serves with an ETag (src/assets.h):
+    "<url> <etag> <content type> <immutable|revalidate>" per line
+
+Files nobody references (hmac.js...) keep their name and are served with
+revalidation, like index.html. Device configuration (*.cal) is copied as is,
+uncompressed, for the firmware to read. Run by PlatformIO before buildfs /
+uploadfs (tools/pio_assets.py), or by hand:
+
+	python3 tools/build_assets.py [--src data] [--out .pio/data]
+"""
+import argparse
+import gzip
+import hashlib
+import os
+import re
+import shutil
+import sys
+
+MANIFEST = "assets.txt"
+CONFIG = (".cal",)     # read by the firmware itself: never gzipped, not in the manifest
+HASH_LEN = 10
+MIN_GAIN = 0.95        # keep the .gz only below this ratio
+
+TYPES = {
+	".html": "text/html", ".htm": "text/html", ".css": "text/css",
+	".js": "application/javascript", ".json": "application/json",
+	".png": "image/png", ".jpg": "image/jpeg", ".jpeg": "image/jpeg",
+	".gif": "image/gif", ".svg": "image/svg+xml", ".ico": "image/x-icon",
+	".txt": "text/plain",
+}
+
+def content_type(name):
+	return TYPES.get(os.path.splitext(name)[1].lower(), "application/octet-stream")
+
+def digest(data):
+	return hashlib.sha256(data).hexdigest()[:HASH_LEN]
+
+def hashed_name(name, data):
+	stem, ext = os.path.splitext(name)
+	return f"{stem}.{digest(data)}{ext}"
+
+def is_local(ref):
+	return not re.match(r"^([a-z]+:|//|#|data:)", ref, re.I)
+
+# ---- minifiers: whitespace and comments only, nothing that needs a parser ----
+
+def minify_css(text):
+	text = re.sub(r"/\*.*?\*/", "", text, flags=re.S)
+	text = re.sub(r"\s+", " ", text)
+	text = re.sub(r"\s*([{};,>])\s*", r"\1", text)
+	text = re.sub(r":\s+", ":", text)
+	text = text.replace(";}", "}")
+	return text.strip() + "\n"
+
+def minify_js(text):
+	# whole-line comments, indentation and blank lines ; line breaks stay (ASI),
+	# lines inside a multi-line template literal are left alone
+	out = []
+	in_template = False
+	for line in text.splitlines():
+		if in_template:
+			out.append(line)
+		else:
+			s = line.strip()
+			if s and not s.startswith("//"):
+				out.append(s)
+		if line.count("`") % 2:
+			in_template = not in_template
+	return "\n".join(out) + "\n"
+
+def minify_html(text):
+	text = re.sub(r"<!--(?!\[).*?-->", "", text, flags=re.S)
+	lines = (l.strip() for l in text.splitlines())
+	return "\n".join(l for l in lines if l) + "\n"
+
+# ---- build ----
+
+def read(src, name):
+	with open(os.path.join(src, name), "rb") as f:
+		return f.read()
+
+def local_path(ref):
+	return ref.split("?")[0].split("#")[0].lstrip("/")
+
+def build(src, out):
+	html = read(src, "index.html").decode()
+	files = sorted(f for f in os.listdir(src) if os.path.isfile(os.path.join(src, f)))
+	served = {}        # name in the image -> (bytes, immutable)
+	renamed = {}       # source name -> hashed name
+
+	def rename(name):
+		if name not in renamed:
+			data = read(src, name)
+			renamed[name] = hashed_name(name, data)
+			served[renamed[name]] = (data, True)
+		return renamed[name]
+
+	def rewrite_urls(css):
+		def sub(m):
+			ref = m.group(2)
+			if not is_local(ref) or local_path(ref) not in files:
+				return m.group(0)
+			return f"url({m.group(1)}{rename(local_path(ref))}{m.group(1)})"
+		return re.sub(r"url\(\s*(['\"]?)([^'\")]+)\1\s*\)", sub, css)
+
+	# stylesheets, in page order, into one
+	css_links = [m for m in re.finditer(r"<link\b[^>]*\brel=[\"']stylesheet[\"'][^>]*>", html)
+		if is_local(re.search(r"href=[\"']([^\"']+)", m.group(0)).group(1))]
+	if css_links:
+		css = "".join(minify_css(rewrite_urls(read(src, local_path(re.search(r"href=[\"']([^\"']+)", m.group(0)).group(1))).decode()))
+			for m in css_links).encode()
+		name = hashed_name("app.css", css)
+		served[name] = (css, True)
+		html = _replace_tags(html, css_links, f'<link rel="stylesheet" href="{name}" />')
+
+	# local scripts, in page order, into one (the first tag's attributes are kept)
+	js_tags = [m for m in re.finditer(r"<script\b([^>]*)\bsrc=[\"']([^\"']+)[\"']([^>]*)>\s*</script>", html)
+		if is_local(m.group(2))]
+	if js_tags:
+		js = ";\n".join(minify_js(read(src, local_path(m.group(2))).decode()) for m in js_tags).encode()
+		name = hashed_name("app.js", js)
+		served[name] = (js, True)
+		first = js_tags[0]
+		html = _replace_tags(html, js_tags, f"<script{first.group(1)}src=\"{name}\"{first.group(3)}></script>")
+
+	# anything else the page points at: icons, images
+	def sub_attr(m):
+		ref = m.group(3)
+		if not is_local(ref) or local_path(ref) not in files or local_path(ref) == "index.html":
+			return m.group(0)
+		prefix = "/" if ref.startswith("/") else ""
+		return f"{m.group(1)}={m.group(2)}{prefix}{rename(local_path(ref))}{m.group(2)}"
+	html = re.sub(r"\b(href|src)=([\"'])([^\"']+)\2", sub_attr, html)
+
+	index = minify_html(html).encode()
+	served["index.html"] = (index, False)
+
+	# unreferenced files: same name, revalidated
+	bundled = {local_path(re.search(r"href=[\"']([^\"']+)", m.group(0)).group(1)) for m in css_links}
+	bundled |= {local_path(m.group(2)) for m in js_tags}
+	for f in files:
+		if f.endswith(CONFIG):
+			continue
+		if f != "index.html" and f not in renamed and f not in bundled and f != MANIFEST:
+			served[f] = (read(src, f), False)
+
+	if os.path.isdir(out):
+		shutil.rmtree(out)
+	os.makedirs(out)
+
+	manifest = []
+	total_in = total_out = 0
+	for name, (data, immutable) in sorted(served.items()):
+		packed = gzip.compress(data, 9, mtime=0)
+		if len(packed) < len(data) * MIN_GAIN:
+			path, body = name + ".gz", packed
+		else:
+			path, body = name, data
+		with open(os.path.join(out, path), "wb") as f:
+			f.write(body)
+		manifest.append(f"/{name} \"{digest(data)}\" {content_type(name)} {'immutable' if immutable else 'revalidate'}")
+		total_in += len(data)
+		total_out += len(body)
+		print(f"{path:40} {len(data):8} -> {len(body):8}")
+
+	with open(os.path.join(out, MANIFEST), "w") as f:
+		f.write("\n".join(manifest) + "\n")
+
+	for name in (f for f in files if f.endswith(CONFIG)):
+		shutil.copyfile(os.path.join(src, name), os.path.join(out, name))
+		print(f"{name:40} {'config':>8}")
+
+	source = sum(os.path.getsize(os.path.join(src, f)) for f in files)
+	print(f"{len(served)} files, {source} bytes in {src}/, {total_out} bytes in {out}/ ({total_in} uncompressed)")
+
+def _replace_tags(html, matches, replacement):
+	# the first match becomes the bundle, the others go ; from the end so offsets hold
+	for i, m in reversed(list(enumerate(matches))):
+		html = html[:m.start()] + (replacement if i == 0 else "") + html[m.end():]
+	return html
+
+def main():
+	p = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+	p.add_argument("--src", default="data", help="asset sources")
+	p.add_argument("--out", default=".pio/data", help="LittleFS image directory (erased first)")
+	args = p.parse_args()
+	if not os.path.isfile(os.path.join(args.src, "index.html")):
+		print(f"no index.html in {args.src}/", file=sys.stderr)
+		return 1
+	build(args.src, args.out)
+	return 0
+
+if __name__ == "__main__":
+	sys.exit(main())
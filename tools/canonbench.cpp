@@ -0,0 +1,466 @@
+/*
+ * Host fuzz test and benchmark of src/canon.cpp against the String based
+ * canonicalizer it replaced (kept below), on query strings and JSON objects.
+ *
+ *   g++ -O2 -std=gnu++17 -fsanitize=address,undefined -DARDUINOJSON_ENABLE_ARDUINO_STRING=1 \
+ *       -Ilib/native_hal -Isrc -I.pio/libdeps/nodemcuv2/ArduinoJson/src \
+ *       tools/canonbench.cpp src/canon.cpp src/hmac.cpp src/sha256.cpp lib/native_hal/WString.cpp -o /tmp/canonbench
+ *   /tmp/canonbench [fuzz cases] [bench iterations]
+ *
+ * Fuzzing checks, on random inputs:
+ *  - same canonical text and hmac field as before, where the two agree by
+ *    design (unique keys, JSON numbers that %.6g prints as written)
+ *  - the same text whatever the order of the fields, duplicates included
+ *  - JSON escapes come out as the UTF-8 they stand for
+ *  - verifyQueryHMAC() / verifyJsonHMAC() accept the right MAC only
+ *  - truncated and mutated inputs parse or fail without touching memory they
+ *    should not (build with the sanitizers as above)
+ * Exits non-zero on the first failure.
+ */
+#include <Arduino.h>
+#include <WString.h>
+#include <ArduinoJson.h>
+#include "canon.h"
+#include "hmac.h"
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+static size_t allocations = 0;
+
+void *operator new(size_t n) {
+  allocations++;
+  if (void *p = malloc(n ? n : 1)) return p;
+  throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+// ---- before ----
+
+namespace before {
+
+struct KV {
+  String key;
+  String val;
+};
+
+size_t parseQueryString(const String &qs, KV out[], size_t maxItems, String &hmacOut) {
+  hmacOut = "";
+  size_t count = 0;
+  size_t start = 0;
+  while (start < qs.length()) {
+    int amp = qs.indexOf('&', start);
+    if (amp == -1) amp = qs.length();
+    String pair = qs.substring(start, amp);
+    int eq = pair.indexOf('=');
+    if (eq >= 0) {
+      String k = pair.substring(0, eq);
+      String v = pair.substring(eq+1);
+      if (k.equalsIgnoreCase("hmac")) {
+        hmacOut = v;
+      } else if (count < maxItems) {
+        out[count].key = k;
+        out[count].val = v;
+        count++;
+      }
+    }
+    start = (amp == (int)qs.length()) ? qs.length() : amp + 1;
+  }
+  return count;
+}
+
+size_t parseJsonToKVs(const String &json, KV out[], size_t maxItems, String &hmacOut) {
+  hmacOut = "";
+  StaticJsonDocument<1024> doc;
+  DeserializationError err = deserializeJson(doc, json);
+  if (err) return 0;
+
+  size_t count = 0;
+  for (JsonPair kv : doc.as<JsonObject>()) {
+    String k = String(kv.key().c_str());
+    if (k.equalsIgnoreCase("hmac")) {
+      hmacOut = kv.value().as<String>();
+    } else if (count < maxItems) {
+      if (kv.value().is<bool>()) {
+        out[count].val = kv.value().as<bool>() ? "true" : "false";
+      } else if (kv.value().is<long>() || kv.value().is<int>()) {
+        out[count].val = String(kv.value().as<long>());
+      } else if (kv.value().is<float>() || kv.value().is<double>()) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.6g", kv.value().as<double>());
+        out[count].val = buf;
+      } else {
+        out[count].val = kv.value().as<String>();
+      }
+      out[count].key = k;
+      count++;
+    }
+  }
+  return count;
+}
+
+void sortKVs(KV arr[], size_t n) {
+  for (size_t i=0; i<n; i++) {
+    size_t min = i;
+    for (size_t j=i+1; j<n; j++) {
+      if (arr[j].key < arr[min].key) min = j;
+    }
+    if (min != i) {
+      KV tmp = arr[i];
+      arr[i] = arr[min];
+      arr[min] = tmp;
+    }
+  }
+}
+
+String buildCanonical(KV arr[], size_t n) {
+  String out;
+  for (size_t i=0; i<n; i++) {
+    if (i > 0) out += "&";
+    out += arr[i].key;
+    out += "=";
+    out += arr[i].val;
+  }
+  return out;
+}
+
+}  // namespace before
+
+// ---- helpers ----
+
+struct StringSink {
+  std::string s;
+  void update(const uint8_t *p, size_t n) { s.append((const char *)p, n); }
+};
+
+static std::string canonical(const Canon &canon) {
+  StringSink sink;
+  canon.write(sink);
+  return sink.s;
+}
+
+static std::string legacyQuery(const std::string &qs, std::string &hmac) {
+  before::KV kvs[MAX_KV];
+  String h;
+  size_t n = before::parseQueryString(String(qs.c_str()), kvs, MAX_KV, h);
+  before::sortKVs(kvs, n);
+  hmac = h.c_str();
+  return before::buildCanonical(kvs, n).c_str();
+}
+
+static std::string legacyJson(const std::string &json, std::string &hmac) {
+  before::KV kvs[MAX_KV];
+  String h;
+  size_t n = before::parseJsonToKVs(String(json.c_str()), kvs, MAX_KV, h);
+  before::sortKVs(kvs, n);
+  hmac = h.c_str();
+  return before::buildCanonical(kvs, n).c_str();
+}
+
+static std::string macHex(const std::string &text) {
+  uint8_t mac[SHA256_HASH_SIZE];
+  hmac_sha256((const uint8_t *)"my_secret_seed", 14, (const uint8_t *)text.data(), text.size(), mac);
+  char hex[2 * SHA256_HASH_SIZE + 1];
+  bin_to_hex_lower(mac, SHA256_HASH_SIZE, hex);
+  return hex;
+}
+
+static std::mt19937 rng(1);
+static size_t pick(size_t n) { return rng() % n; }
+
+static void fail(const char *what, const std::string &input, const std::string &got, const std::string &want) {
+  printf("FAIL %s\n  input %s\n  got   %s\n  want  %s\n", what, input.c_str(), got.c_str(), want.c_str());
+  exit(1);
+}
+
+struct GenField {
+  std::string key, value;   // value as written
+  std::string decoded;      // what the canonical form holds
+};
+
+static std::string genKey(bool unique, std::vector<std::string> &used) {
+  static const char CHARS[] = "abcdefghijklmnopqrstuvwxyz_0123456789";
+  for (;;) {
+    std::string k;
+    for (size_t n = 1 + pick(6); n; n--) k += CHARS[pick(sizeof(CHARS) - 1)];
+    if (k == "hmac") continue;
+    if (unique && std::find(used.begin(), used.end(), k) != used.end()) continue;
+    used.push_back(k);
+    return k;
+  }
+}
+
+static std::string queryText(const std::vector<GenField> &fields, const std::string &hmac) {
+  std::string qs;
+  for (const GenField &f : fields) qs += (qs.empty() ? "" : "&") + f.key + "=" + f.value;
+  if (!hmac.empty()) {
+    size_t at = pick(fields.size() + 1), pos = 0;
+    for (size_t i = 0; i < at; i++) pos = qs.find('&', pos) + 1;
+    std::string field = (pick(2) ? "hmac=" : "HMAC=") + hmac;
+    if (!at) qs = field + (qs.empty() ? "" : "&") + qs;
+    else if (!pos || pos > qs.size()) qs += "&" + field;
+    else qs.insert(pos - 1, "&" + field);
+  }
+  if (pick(4) == 0) qs += "&novalue";       // left out, as before
+  if (pick(4) == 0) qs = "&" + qs;
+  return qs;
+}
+
+static std::vector<GenField> genQueryFields(bool unique) {
+  static const char CHARS[] = "abcXYZ0189.:-_=%+";
+  std::vector<std::string> used;
+  std::vector<GenField> fields(pick(12));
+  for (GenField &f : fields) {
+    f.key = genKey(unique, used);
+    for (size_t n = pick(10); n; n--) f.value += CHARS[pick(sizeof(CHARS) - 1)];
+    f.decoded = f.value;
+  }
+  return fields;
+}
+
+static void appendUtf8(std::string &s, uint32_t cp) {
+  if (cp < 0x80) s += (char)cp;
+  else if (cp < 0x800) { s += (char)(0xc0 | cp >> 6); s += (char)(0x80 | (cp & 0x3f)); }
+  else if (cp < 0x10000) { s += (char)(0xe0 | cp >> 12); s += (char)(0x80 | (cp >> 6 & 0x3f)); s += (char)(0x80 | (cp & 0x3f)); }
+  else { s += (char)(0xf0 | cp >> 18); s += (char)(0x80 | (cp >> 12 & 0x3f)); s += (char)(0x80 | (cp >> 6 & 0x3f)); s += (char)(0x80 | (cp & 0x3f)); }
+}
+
+// strict = only what the legacy parser prints as written
+static std::vector<GenField> genJsonFields(bool unique, bool strict) {
+  std::vector<std::string> used;
+  std::vector<GenField> fields(pick(12));
+  char buf[40];
+  for (GenField &f : fields) {
+    f.key = genKey(unique, used);
+    switch (pick(strict ? 4 : 6)) {
+      case 0:
+        snprintf(buf, sizeof(buf), "%ld", (long)(rng() % 2000001) - 1000000);
+        f.value = buf;
+        break;
+      case 1:
+        snprintf(buf, sizeof(buf), "%d.%d", (int)pick(20000) - 10000, 1 + (int)pick(9));
+        f.value = buf;
+        break;
+      case 2:
+        f.value = pick(2) ? "true" : "false";
+        break;
+      case 3:
+        f.value = "\"";
+        for (size_t n = pick(10); n; n--) {
+          char c = "abc XYZ:=&.-"[pick(12)];
+          f.value += c;
+          f.decoded += c;
+        }
+        f.value += "\"";
+        continue;
+      case 4: {
+        // escapes, astral planes included
+        static const uint32_t CPS[] = { '"', '\\', '/', '\n', '\t', 0xe9, 0x20ac, 0x1f525, 'a' };
+        f.value = "\"";
+        for (size_t n = 1 + pick(6); n; n--) {
+          uint32_t cp = CPS[pick(sizeof(CPS) / sizeof(*CPS))];
+          if (cp == '"' || cp == '\\' || cp == '/') { f.value += '\\'; f.value += (char)cp; }
+          else if (cp == '\n') f.value += "\\n";
+          else if (cp == '\t') f.value += "\\t";
+          else if (cp < 0x10000) { snprintf(buf, sizeof(buf), "\\u%04X", cp); f.value += buf; }
+          else {
+            snprintf(buf, sizeof(buf), "\\u%04x\\u%04x", 0xd800 + ((cp - 0x10000) >> 10), 0xdc00 + ((cp - 0x10000) & 0x3ff));
+            f.value += buf;
+          }
+          appendUtf8(f.decoded, cp);
+        }
+        f.value += "\"";
+        continue;
+      }
+      case 5:
+        snprintf(buf, sizeof(buf), "%.9g", (rng() % 100000000) / 1e5);
+        f.value = buf;
+        break;
+    }
+    f.decoded = f.value;
+  }
+  return fields;
+}
+
+static std::string jsonText(const std::vector<GenField> &fields, const std::string &hmac) {
+  static const char *SPACE[] = { "", "", " ", "\n  " };
+  std::string json = "{";
+  size_t at = pick(fields.size() + 1);
+  for (size_t i = 0; i <= fields.size(); i++) {
+    std::string member;
+    if (i == at && !hmac.empty()) member = std::string(pick(2) ? "\"hmac\"" : "\"Hmac\"") + ":\"" + hmac + "\"";
+    if (i < fields.size()) {
+      if (!member.empty()) member += ",";
+      member += std::string(SPACE[pick(4)]) + "\"" + fields[i].key + "\"" + SPACE[pick(4)] + ":" + SPACE[pick(4)] + fields[i].value;
+    }
+    if (member.empty()) continue;
+    json += (json.size() > 1 ? "," : "") + member;
+  }
+  return json + SPACE[pick(4)] + "}";
+}
+
+static std::string expected(std::vector<GenField> fields) {
+  std::sort(fields.begin(), fields.end(), [](const GenField &a, const GenField &b) {
+    return a.key != b.key ? a.key < b.key : a.decoded < b.decoded;
+  });
+  std::string s;
+  for (const GenField &f : fields) s += (s.empty() ? "" : "&") + f.key + "=" + f.decoded;
+  return s;
+}
+
+// ---- fuzzing ----
+
+static void fuzzQuery() {
+  bool unique = pick(2);
+  std::vector<GenField> fields = genQueryFields(unique);
+  std::string want = expected(fields), mac = pick(2) ? macHex(want) : "";
+  std::string qs = queryText(fields, mac);
+
+  Canon canon;
+  if (!canon.parseQuery(qs.data(), qs.size())) fail("query parse", qs, "", "");
+  std::string got = canonical(canon), hmac(canon.hmac(), canon.hmacLength());
+  if (got != want) fail("query canonical", qs, got, want);
+  if (hmac != mac) fail("query hmac field", qs, hmac, mac);
+
+  if (unique) {
+    std::string legacyHmac, legacy = legacyQuery(qs, legacyHmac);
+    if (got != legacy) fail("query vs before", qs, got, legacy);
+    if (hmac != legacyHmac) fail("query hmac vs before", qs, hmac, legacyHmac);
+  }
+
+  HmacKey key("my_secret_seed");
+  if (verifyQueryHMAC(key, qs.data(), qs.size()) != !mac.empty()) fail("verifyQueryHMAC", qs, "", "");
+  if (!mac.empty()) {
+    std::string bad = qs;
+    bad[bad.find(mac) + pick(mac.size())] ^= 1;
+    if (verifyQueryHMAC(key, bad.data(), bad.size())) fail("verifyQueryHMAC accepted", bad, "", "");
+  }
+}
+
+static void fuzzJson() {
+  bool strict = pick(2);
+  std::vector<GenField> fields = genJsonFields(true, strict);
+  std::string want = expected(fields), mac = pick(2) ? macHex(want) : "";
+  std::string json = jsonText(fields, mac);
+
+  Canon canon;
+  if (!canon.parseJson(json.data(), json.size())) fail("json parse", json, "", "");
+  std::string got = canonical(canon), hmac(canon.hmac(), canon.hmacLength());
+  if (got != want) fail("json canonical", json, got, want);
+  if (hmac != mac) fail("json hmac field", json, hmac, mac);
+
+  if (strict) {
+    std::string legacyHmac, legacy = legacyJson(json, legacyHmac);
+    if (got != legacy) fail("json vs before", json, got, legacy);
+    if (hmac != legacyHmac) fail("json hmac vs before", json, hmac, legacyHmac);
+  }
+
+  // field order does not matter
+  std::shuffle(fields.begin(), fields.end(), rng);
+  std::string shuffled = jsonText(fields, mac);
+  Canon again;
+  if (!again.parseJson(shuffled.data(), shuffled.size()) || canonical(again) != want) fail("json order", shuffled, canonical(again), want);
+
+  HmacKey key("my_secret_seed");
+  if (verifyJsonHMAC(key, json.data(), json.size()) != !mac.empty()) fail("verifyJsonHMAC", json, "", "");
+}
+
+static void fuzzGarbage() {
+  std::vector<GenField> fields = pick(2) ? genJsonFields(false, false) : genQueryFields(false);
+  std::string text = pick(2) ? jsonText(fields, "") : queryText(fields, "");
+  for (size_t n = 1 + pick(4); n; n--) {
+    if (text.empty()) break;
+    switch (pick(3)) {
+      case 0: text[pick(text.size())] = "{}[]\":,\\u&=\x01\xff"[pick(14)]; break;
+      case 1: text.resize(pick(text.size())); break;
+      case 2: text.erase(pick(text.size()), 1); break;
+    }
+  }
+  // exactly sized copies, so that the sanitizer sees any read past the end
+  std::vector<char> buf(text.begin(), text.end());
+  Canon canon;
+  if (canon.parseJson(buf.data(), buf.size())) canonical(canon);
+  if (canon.parseQuery(buf.data(), buf.size())) canonical(canon);
+}
+
+// ---- benchmark ----
+
+static const char *QUERY = "target=72.5&relay=2:pid&save=1&ts=1700000000&hmac=0f3c5d8a2b4e6f708192a3b4c5d6e7f8091a2b3c4d5e6f708192a3b4c5d6e7f8";
+static const char *JSON = "{\"target\":72.5,\"relay\":\"2:pid\",\"save\":true,\"ts\":1700000000,\"hmac\":\"0f3c5d8a2b4e6f708192a3b4c5d6e7f8091a2b3c4d5e6f708192a3b4c5d6e7f8\"}";
+
+template <class F>
+static void run(const char *name, F f, long iterations) {
+  size_t before = allocations;
+  auto t0 = std::chrono::steady_clock::now();
+  for (long i = 0; i < iterations; i++) f();
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+  printf("%-14s %8.1f ns/message %8.2f allocations/message\n", name, ns / iterations, (double)(allocations - before) / iterations);
+}
+
+int main(int argc, char **argv) {
+  long cases = argc > 1 ? atol(argv[1]) : 20000;
+  long iterations = argc > 2 ? atol(argv[2]) : 200000;
+
+  for (long i = 0; i < cases; i++) {
+    fuzzQuery();
+    fuzzJson();
+    fuzzGarbage();
+  }
+  printf("ok   %ld fuzz cases each: query, JSON, mangled input\n\n", cases);
+
+  // parse, sort and MAC the canonical form, with the same precomputed key on both sides
+  HmacKey key("my_secret_seed");
+  static volatile uint8_t sinkByte;
+  const String query(QUERY), json(JSON);
+  const size_t queryLen = strlen(QUERY), jsonLen = strlen(JSON);
+  run("query before", [&]() {
+    before::KV kvs[MAX_KV];
+    String hmac;
+    size_t n = before::parseQueryString(query, kvs, MAX_KV, hmac);
+    before::sortKVs(kvs, n);
+    String text = before::buildCanonical(kvs, n);
+    uint8_t mac[SHA256_HASH_SIZE];
+    HmacContext ctx(key);
+    ctx.update((const uint8_t *)text.c_str(), text.length());
+    ctx.final(mac);
+    sinkByte = mac[0];
+  }, iterations);
+  run("query now", [&]() {
+    Canon canon;
+    canon.parseQuery(QUERY, queryLen);
+    uint8_t mac[SHA256_HASH_SIZE];
+    HmacContext ctx(key);
+    canon.write(ctx);
+    ctx.final(mac);
+    sinkByte = mac[0];
+  }, iterations);
+  run("json before", [&]() {
+    before::KV kvs[MAX_KV];
+    String hmac;
+    size_t n = before::parseJsonToKVs(json, kvs, MAX_KV, hmac);
+    before::sortKVs(kvs, n);
+    String text = before::buildCanonical(kvs, n);
+    uint8_t mac[SHA256_HASH_SIZE];
+    HmacContext ctx(key);
+    ctx.update((const uint8_t *)text.c_str(), text.length());
+    ctx.final(mac);
+    sinkByte = mac[0];
+  }, iterations);
+  run("json now", [&]() {
+    Canon canon;
+    canon.parseJson(JSON, jsonLen);
+    uint8_t mac[SHA256_HASH_SIZE];
+    HmacContext ctx(key);
+    canon.write(ctx);
+    ctx.final(mac);
+    sinkByte = mac[0];
+  }, iterations);
+  printf("\nstack: Canon %zu bytes ; KV[MAX_KV] %zu + StaticJsonDocument<1024> before\n", sizeof(Canon), sizeof(before::KV) * MAX_KV);
+  return 0;
+}
@@ -0,0 +1,131 @@
+/*
+ * Host microbenchmark: websocket command parsing, the String path the
+ * firmware used to take against commands.h, on the same mix of frames.
+ * Counts heap allocations by replacing operator new.
+ *
+ *   g++ -O2 -std=gnu++17 -Ilib/native_hal -Isrc tools/cmdbench.cpp lib/native_hal/WString.cpp -o /tmp/cmdbench
+ *   /tmp/cmdbench [iterations]
+ *
+ * The String stand-in sits on std::string, whose small-string buffer (15
+ * bytes with libstdc++) hides the allocations of short frames ; the ESP8266
+ * String's is 11 bytes, so the legacy counts here are a lower bound.
+ */
+#include <Arduino.h>
+#include <WString.h>
+#include "commands.h"
+#include <chrono>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+
+static size_t allocations = 0;
+
+void *operator new(size_t n) {
+  allocations++;
+  if (void *p = malloc(n ? n : 1)) return p;
+  throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+static const char *FRAMES[] = {
+  "enable", "disable", "target:72.5", "relay:2:pid", "temp", "ambiant",
+  "door", "relays", "enabled", "voltages", "target:105.25", "relay:1:off",
+  "unknown:verb", "proto:bin1",
+};
+static const size_t RELAY_COUNT = 3;
+
+// what the handlers would touch
+static volatile float target;
+static volatile int modes[RELAY_COUNT];
+static volatile int hits;
+
+// ---- before: String copy, == / startsWith chain, substring + toInt / toFloat ----
+
+static void legacy(const uint8_t *data, size_t len) {
+  String msg;
+  for (size_t i = 0; i < len; i++) {
+    msg += (char)data[i];
+  }
+  if (msg.startsWith("proto:")) { hits++; return; }
+  if (msg == "enable") hits++;
+  else if (msg == "disable") hits++;
+  else if (msg.startsWith("target:")) target = msg.substring(7).toFloat();
+  else if (msg.startsWith("relay:")) {
+    size_t r = msg.substring(6, 7).toInt() - 1;
+    String mode = msg.substring(8);
+    if (r < RELAY_COUNT) {
+      if (mode == "on") modes[r] = 2;
+      else if (mode == "off") modes[r] = 0;
+      else if (mode == "pid") modes[r] = 1;
+    }
+  }
+  else if (msg == "enabled") hits++;
+  else if (msg == "ambiant") hits++;
+  else if (msg == "temp") hits++;
+  else if (msg == "door") hits++;
+  else if (msg == "relays") hits++;
+  else if (msg == "voltages") hits++;
+}
+
+// ---- after: commands.h ----
+
+static bool hit(const Command &, int) { hits++; return true; }
+
+static bool onTarget(const Command &cmd, int) {
+  float t;
+  if (!cmd.arg(0).toFloat(t)) return false;
+  target = t;
+  return true;
+}
+
+static bool onRelay(const Command &cmd, int) {
+  uint32_t r;
+  if (!cmd.arg(0).toUInt(r) || r < 1 || r > RELAY_COUNT) return false;
+  const CommandArg &mode = cmd.arg(1);
+  if (mode.equals("on")) modes[r - 1] = 2;
+  else if (mode.equals("off")) modes[r - 1] = 0;
+  else if (mode.equals("pid")) modes[r - 1] = 1;
+  else return false;
+  return true;
+}
+
+static constexpr CommandVerb<int> VERBS[] = {
+  { "ambiant",  0, hit },
+  { "disable",  0, hit },
+  { "door",     0, hit },
+  { "enable",   0, hit },
+  { "enabled",  0, hit },
+  { "relay",    2, onRelay },
+  { "relays",   0, hit },
+  { "target",   1, onTarget },
+  { "temp",     0, hit },
+  { "voltages", 0, hit },
+};
+static_assert(commandsSorted(VERBS), "VERBS must be sorted by verb");
+
+static void parsed(const uint8_t *data, size_t len) {
+  Command cmd;
+  if (!cmd.parse(data, len)) return;
+  if (cmd.verb.equals("proto")) { hits++; return; }
+  dispatchCommand(VERBS, cmd, 0);
+}
+
+template <class F>
+static void run(const char *name, F f, long iterations) {
+  size_t before = allocations;
+  auto t0 = std::chrono::steady_clock::now();
+  for (long i = 0; i < iterations; i++) {
+    const char *frame = FRAMES[i % (sizeof(FRAMES) / sizeof(*FRAMES))];
+    f((const uint8_t *)frame, strlen(frame));
+  }
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+  printf("%-8s %8.1f ns/command %8.3f allocations/command\n", name, ns / iterations, (double)(allocations - before) / iterations);
+}
+
+int main(int argc, char **argv) {
+  long iterations = argc > 1 ? atol(argv[1]) : 2000000;
+  run("String", legacy, iterations);
+  run("parsed", parsed, iterations);
+  return 0;
+}
@@ -0,0 +1,284 @@
+/*
+ * Host test of src/flashlog.cpp against the native LittleFS shim, with small
+ * segments so that a few hundred records go round the rotation.
+ *
+ *   g++ -O1 -g -std=gnu++17 -fsanitize=address,undefined -Ilib/native_hal -Isrc \
+ *       tools/flashlogtest.cpp src/flashlog.cpp src/history.cpp lib/native_hal/hal.cpp \
+ *       lib/native_hal/FS.cpp lib/native_hal/WString.cpp -o /tmp/flashlogtest
+ *   /tmp/flashlogtest
+ *
+ * The log runs on a 32-bit clock of its own, as millis() is on the ESP8266,
+ * so it can be taken across the wrap. Each case works in its own directory of a
+ * temporary FS root:
+ *  - rotation: slots are reused, the oldest segment goes, reads start there
+ *  - seek: reads from any time match a scan, through the footer index and
+ *    through the binary search once the footer is damaged
+ *  - crc: a corrupt record is skipped, its neighbours are not
+ *  - torn: a half record at the tail is cut at boot, appends go on after it
+ *  - resume: the clock goes on from the last record after a reboot, even
+ *    when the newest segment holds no record yet
+ *  - wrap: the clock keeps going forward across the millis() wrap
+ *  - short: a write the FS cuts short leaves no partial record behind
+ * Exits non-zero on failure.
+ */
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "flashlog.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+// millis() as the ESP8266 has it: 32 bits
+static uint32_t fakeMillis = 0;
+static unsigned long clock32() { return fakeMillis; }
+
+static int failures = 0;
+
+static void check(bool ok, const char *what, long at = 0) {
+  if (!ok && failures++ < 20) printf("FAIL %s (%ld)\n", what, at);
+}
+
+static const uint8_t SEGMENTS = 3;
+static const uint16_t CAPACITY = 128;   // two index entries per footer
+static const size_t SEALED = FlashLog::HEADER_SIZE + CAPACITY * FlashLog::RECORD_SIZE;
+
+static std::string host(const char *dir, unsigned slot) {
+  return hal::fsRoot + dir + "/" + std::to_string(slot) + ".seg";
+}
+
+static long fileSize(const std::string &path) {
+  FILE *f = fopen(path.c_str(), "rb");
+  if (!f) return -1;
+  fseek(f, 0, SEEK_END);
+  long n = ftell(f);
+  fclose(f);
+  return n;
+}
+
+static void flipByte(const std::string &path, long at) {
+  FILE *f = fopen(path.c_str(), "r+b");
+  fseek(f, at, SEEK_SET);
+  int c = fgetc(f);
+  fseek(f, at, SEEK_SET);
+  fputc(c ^ 0x5a, f);
+  fclose(f);
+}
+
+// events logged with their number as value, one a second
+static void logEvents(FlashLog &log, int from, int count) {
+  for (int i = from; i < from + count; i++) {
+    log.event(FlashLog::TARGET, (int16_t)i);
+    fakeMillis += 1000;
+  }
+}
+
+static std::vector<FlashLog::Record> events(const FlashLog &log, uint32_t from = 0, uint32_t to = 0xffffffff) {
+  std::vector<FlashLog::Record> out;
+  log.read(from, to, FlashLog::EVENT, [&](const FlashLog::Record &r) {
+    if (r.code == FlashLog::TARGET) out.push_back(r);
+    return true;
+  });
+  return out;
+}
+
+// values are consecutive from `first`, times never go back
+static bool consecutive(const std::vector<FlashLog::Record> &v, int first) {
+  for (size_t i = 0; i < v.size(); i++) {
+    if (v[i].v[0] != (int16_t)(first + i) || (i && v[i].time < v[i - 1].time)) return false;
+  }
+  return true;
+}
+
+static void rotation() {
+  fakeMillis = 0;
+  FlashLog log(LittleFS, "/rotation", SEGMENTS, CAPACITY, clock32);
+  check(!log.begin(), "rotation: nothing on a fresh FS");
+  logEvents(log, 0, 4 * CAPACITY + 40);   // BOOT took a slot in the first segment
+  log.flush();
+
+  for (unsigned slot = 0; slot < SEGMENTS; slot++) check(fileSize(host("/rotation", slot)) > 0, "rotation: slot in use", slot);
+  check(fileSize(host("/rotation", SEGMENTS)) < 0, "rotation: no slot past the rotation");
+  check(fileSize(host("/rotation", 0)) == SEALED + 4 * 2 + 8, "rotation: sealed segment with its footer", fileSize(host("/rotation", 0)));
+
+  // segments 2, 3 and 4 (in slot 1) kept: 2 * CAPACITY + what went into the last one
+  std::vector<FlashLog::Record> all = events(log);
+  int first = 2 * CAPACITY - 1;
+  check(!all.empty() && all[0].v[0] == first, "rotation: reads start at the oldest kept", all.empty() ? -1 : all[0].v[0]);
+  check(all.size() == (size_t)(4 * CAPACITY + 40 - first), "rotation: every kept record", all.size());
+  check(consecutive(all, first), "rotation: in order");
+  check(log.oldest() == all[0].time, "rotation: oldest()", log.oldest());
+
+  // and the same after a reboot
+  fakeMillis = 0;
+  FlashLog again(LittleFS, "/rotation", SEGMENTS, CAPACITY, clock32);
+  check(again.begin(), "rotation: found again");
+  std::vector<FlashLog::Record> back = events(again);
+  check(back.size() == all.size() && consecutive(back, first), "rotation: read back after reboot", back.size());
+}
+
+static void seekMatchesScan(const FlashLog &log, const std::vector<FlashLog::Record> &all, const char *what) {
+  for (uint32_t from = all.front().time - 2; from <= all.back().time + 2; from += 7) {
+    std::vector<FlashLog::Record> got = events(log, from, from + 90);
+    std::vector<FlashLog::Record> want;
+    for (const auto &r : all) {
+      if (r.time >= from && r.time < from + 90) want.push_back(r);
+    }
+    bool same = got.size() == want.size();
+    for (size_t i = 0; same && i < got.size(); i++) same = got[i].v[0] == want[i].v[0];
+    check(same, what, from);
+  }
+}
+
+static void seek() {
+  fakeMillis = 0;
+  FlashLog log(LittleFS, "/seek", SEGMENTS, CAPACITY, clock32);
+  log.begin();
+  logEvents(log, 0, 2 * CAPACITY + 50);
+  log.flush();
+  std::vector<FlashLog::Record> all = events(log);
+  check(all.size() == 2 * CAPACITY + 50, "seek: all written", all.size());
+
+  seekMatchesScan(log, all, "seek: footer index");
+  flipByte(host("/seek", 0), SEALED + 1);   // the footer's CRC no longer matches
+  flipByte(host("/seek", 1), SEALED + 4 * 2);
+  seekMatchesScan(log, all, "seek: binary search");
+}
+
+static void crc() {
+  fakeMillis = 0;
+  FlashLog log(LittleFS, "/crc", SEGMENTS, CAPACITY, clock32);
+  log.begin();
+  logEvents(log, 0, CAPACITY + 20);
+  log.flush();
+
+  // event 39 of the sealed segment, after BOOT
+  flipByte(host("/crc", 0), FlashLog::HEADER_SIZE + 40 * FlashLog::RECORD_SIZE + 7);
+  std::vector<FlashLog::Record> all = events(log);
+  check(all.size() == CAPACITY + 19, "crc: one record skipped", all.size());
+  check(all.size() > 40 && all[38].v[0] == 38 && all[39].v[0] == 40 && consecutive({ all.begin() + 39, all.end() }, 40),
+        "crc: exactly the corrupt one");
+}
+
+static void torn() {
+  fakeMillis = 0;
+  {
+    FlashLog log(LittleFS, "/torn", SEGMENTS, CAPACITY, clock32);
+    log.begin();
+    logEvents(log, 0, 31);   // two batches with BOOT
+    log.flush();
+  }
+  std::string path = host("/torn", 0);
+  long size = fileSize(path);
+  FILE *f = fopen(path.c_str(), "ab");
+  fwrite("\x01\x02\x03\x04\x05\x06\x07", 1, 7, f);   // power cut mid-append
+  fclose(f);
+
+  fakeMillis = 0;
+  FlashLog log(LittleFS, "/torn", SEGMENTS, CAPACITY, clock32);
+  log.begin();
+  check(fileSize(path) == size, "torn: tail cut at boot", fileSize(path));
+  logEvents(log, 31, 20);
+  log.flush();
+  std::vector<FlashLog::Record> all = events(log);
+  check(all.size() == 51 && consecutive(all, 0), "torn: appends after it read back", all.size());
+}
+
+static void resume() {
+  fakeMillis = 0;
+  uint32_t last;
+  {
+    FlashLog log(LittleFS, "/resume", SEGMENTS, CAPACITY, clock32);
+    log.begin();
+    logEvents(log, 0, 100);
+    log.flush();
+    last = events(log).back().time;
+  }
+
+  // reboot: millis() from 0 again, the clock from the last record
+  fakeMillis = 0;
+  {
+    FlashLog log(LittleFS, "/resume", SEGMENTS, CAPACITY, clock32);
+    log.begin();
+    check(log.now() == last + 1, "resume: after the last record", log.now());
+    logEvents(log, 100, CAPACITY);   // seals the first segment, starts the next
+    log.flush();
+  }
+
+  // a segment with its header and no record: power cut or full FS right after it was started
+  std::string path = host("/resume", 1);
+  FILE *f = fopen(path.c_str(), "r+b");
+  check(ftruncate(fileno(f), FlashLog::HEADER_SIZE) == 0, "resume: ftruncate");
+  fclose(f);
+  fakeMillis = 0;
+  FlashLog log(LittleFS, "/resume", SEGMENTS, CAPACITY, clock32);
+  log.begin();
+  last = events(log).back().time;
+  uint32_t boot = log.now();
+  check(boot > last, "resume: not behind what is on flash", (long)boot - last);
+  logEvents(log, 1000, 20);
+  log.flush();
+  std::vector<FlashLog::Record> all = events(log);
+  bool ordered = true;
+  for (size_t i = 1; i < all.size(); i++) ordered = ordered && all[i].time >= all[i - 1].time;
+  check(ordered && all.back().v[0] == 1019, "resume: still in time order");
+  check(events(log, boot).size() == 20, "resume: new records found by time", events(log, boot).size());
+}
+
+static void wrap() {
+  fakeMillis = 0xffffffff - 3 * 3600 * 1000;   // 3 h before the wrap
+  FlashLog log(LittleFS, "/wrap", SEGMENTS, CAPACITY, clock32);
+  log.begin();
+  uint32_t start = log.now(), previous = start;
+  for (int minute = 0; minute < 6 * 60; minute++) {
+    fakeMillis += 60000;
+    log.poll();
+    check(log.now() >= previous, "wrap: never backwards", minute);
+    previous = log.now();
+  }
+  check(log.now() - start == 6 * 3600, "wrap: counts the whole 6 h", log.now() - start);
+}
+
+static void shortWrite() {
+  fakeMillis = 0;
+  FlashLog log(LittleFS, "/short", SEGMENTS, CAPACITY, clock32);
+  log.begin();
+  hal::fsSpace = FlashLog::HEADER_SIZE + 5 * FlashLog::RECORD_SIZE + 9;
+  logEvents(log, 0, 15);   // BOOT and these fill a batch, that only partly fits
+  log.flush();
+  check(fileSize(host("/short", 0)) == FlashLog::HEADER_SIZE + 5 * FlashLog::RECORD_SIZE, "short: no partial record left",
+        fileSize(host("/short", 0)));
+
+  hal::fsSpace = -1;   // space again
+  logEvents(log, 15, 10);
+  log.flush();
+  std::vector<FlashLog::Record> all = events(log);
+  check(all.size() == 25 && consecutive(all, 0), "short: the rest appended in line", all.size());
+
+  fakeMillis = 0;
+  FlashLog again(LittleFS, "/short", SEGMENTS, CAPACITY, clock32);
+  again.begin();
+  all = events(again);
+  check(all.size() == 25 && consecutive(all, 0), "short: read back after reboot", all.size());
+}
+
+int main() {
+  char root[] = "/tmp/flashlogtest.XXXXXX";
+  if (!mkdtemp(root)) return 2;
+  hal::fsRoot = root;
+  LittleFS.begin();
+
+  rotation();
+  seek();
+  crc();
+  torn();
+  resume();
+  wrap();
+  shortWrite();
+
+  std::string rm = std::string("rm -rf ") + root;
+  if (system(rm.c_str())) {}
+  printf(failures ? "%d failures\n" : "all good\n", failures);
+  return failures != 0;
+}
@@ -0,0 +1,14 @@
+# vim: noet ts=4 number
+# PlatformIO extra script: rebuilds the LittleFS image directory (data_dir,
+# .pio/data) from data/ before the filesystem image is made ; see build_assets.py
+Import("env")
+import os
+import subprocess
+import sys
+
+FS_TARGETS = ("buildfs", "uploadfs", "uploadfsota")
+
+if any(t in FS_TARGETS for t in COMMAND_LINE_TARGETS):
+	project = env.subst("$PROJECT_DIR")
+	subprocess.check_call([sys.executable, os.path.join(project, "tools", "build_assets.py"),
+		"--src", os.path.join(project, "data"), "--out", env.subst("$PROJECT_DATA_DIR")])
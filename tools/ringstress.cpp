@@ -0,0 +1,140 @@
+/*
+ * Host stress test for src/spsc_ring.h: a producer thread stands in for the
+ * ISR, the main thread for loop(), on separate cores where the host has them.
+ *
+ *   g++ -O2 -std=gnu++17 -pthread -Isrc tools/ringstress.cpp -o /tmp/ringstress
+ *   /tmp/ringstress [--wrap] [items]
+ *
+ * Queue: every item arrives once, in order, through pop() and pop(out, max).
+ * Window: record() runs flat out while window() copies ; what it returns must
+ * be consecutive, untorn, and no older than the head it started from. Items
+ * are three words checked against each other, so a torn copy shows.
+ * --wrap also runs the counters past 2^32.
+ *
+ * -fsanitize=thread passes the queue part ; it reports the window part, whose
+ * copy races the producer on purpose and is validated by the head reread.
+ */
+#include "spsc_ring.h"
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+struct Item {
+  uint32_t seq, check, pad;
+  static Item of(uint32_t s) { return { s, ~s * 2654435761u, s ^ 0x5a5a5a5a }; }
+  bool intact() const { return check == ~seq * 2654435761u && pad == (seq ^ 0x5a5a5a5a); }
+};
+
+static int failures = 0;
+
+static void fail(const char *what, uint32_t at) {
+  if (failures++ < 10) printf("FAIL %s at %u\n", what, at);
+}
+
+static double seconds(std::chrono::steady_clock::time_point since) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+}
+
+template <size_t N>
+static void queue(uint32_t items, bool batch) {
+  SpscRing<Item, N> ring;
+  auto start = std::chrono::steady_clock::now();
+  std::thread producer([&]() {
+    for (uint32_t i = 0; i < items; i++) {
+      while (!ring.push(Item::of(i))) std::this_thread::yield();
+    }
+  });
+
+  uint32_t expect = 0;
+  unsigned long empty = 0;
+  Item out[N];
+  while (expect < items) {
+    size_t n = batch ? ring.pop(out, N) : ring.pop(out[0]);
+    if (!n) {
+      empty++;
+      std::this_thread::yield();
+      continue;
+    }
+    for (size_t i = 0; i < n; i++, expect++) {
+      if (!out[i].intact()) fail("torn item", expect);
+      if (out[i].seq != expect) fail("out of order", expect);
+    }
+  }
+  producer.join();
+  if (!ring.empty()) fail("left over", expect);
+  printf("queue  N=%-4zu %-6s %u items  %5.1f Mitems/s  %lu empty polls\n",
+         N, batch ? "batch" : "single", items, items / seconds(start) / 1e6, empty);
+}
+
+template <size_t N>
+static void window(uint32_t items, size_t want) {
+  SpscRing<Item, N> ring;
+  std::atomic<bool> done{false};
+  auto start = std::chrono::steady_clock::now();
+  std::thread producer([&]() {
+    for (uint32_t i = 0; i < items; i++) ring.record(Item::of(i));
+    done = true;
+  });
+
+  unsigned long looks = 0, full = 0, dropped = 0;
+  Item out[N];
+  while (!done) {
+    uint32_t before = ring.recorded();
+    size_t n = ring.window(out, want);
+    looks++;
+    if (n == (want < N ? want : N - 1)) full++;
+    dropped += (want < N ? want : N - 1) - n;
+    for (size_t i = 0; i < n; i++) {
+      if (!out[i].intact()) fail("torn item", out[i].seq);
+      if (i && out[i].seq != out[i - 1].seq + 1) fail("gap", out[i].seq);
+    }
+    // the newest item returned was recorded no earlier than the head we saw
+    if (n && out[n - 1].seq + 1 < before) fail("stale window", before);
+  }
+  producer.join();
+
+  size_t n = ring.window(out, want);
+  if (n != (want < N ? want : N - 1) || out[n - 1].seq != items - 1) fail("final window", n);
+  printf("window N=%-4zu n=%-4zu %u items  %5.1f Mitems/s  %lu looks, %.1f%% whole, %.2f items dropped per look\n",
+         N, want, items, items / seconds(start) / 1e6, looks, 100.0 * full / looks, (double)dropped / looks);
+}
+
+int main(int argc, char **argv) {
+  bool wrap = argc > 1 && !strcmp(argv[1], "--wrap");
+  if (wrap) argc--, argv++;
+  uint32_t items = argc > 1 ? strtoul(argv[1], nullptr, 0) : 2000000;
+
+  queue<8>(items, false);
+  queue<8>(items, true);
+  queue<128>(items, false);
+  queue<128>(items, true);
+
+  window<16>(items, 8);
+  window<128>(items, 100);
+  window<128>(items, 128);
+
+  if (wrap) {
+    // the counters across 2^32, one thread: a few seconds
+    SpscRing<uint32_t, 4> ring;
+    uint32_t x, t[4];
+    for (uint64_t i = 0; i < (1ull << 32) + 6; i++) {
+      ring.push((uint32_t)i);
+      if (!ring.pop(x) || x != (uint32_t)i) {
+        fail("wrap pop", (uint32_t)i);
+        break;
+      }
+    }
+
+    SpscRing<uint32_t, 4> window;
+    for (uint64_t i = 0; i < (1ull << 32) + 1; i++) window.record((uint32_t)i);
+    size_t n = window.window(t, 4);
+    if (n != 3 || t[0] != 0xfffffffe || t[1] != 0xffffffff || t[2] != 0) fail("wrap window", n);
+    printf("wrap   counters past 2^32\n");
+  }
+
+  printf(failures ? "%d failures\n" : "all good\n", failures);
+  return failures != 0;
+}
@@ -0,0 +1,103 @@
+/*
+ * Host test of src/tempsensors.cpp on the fake 1-wire bus of lib/native_hal:
+ * the state machine driven through request, deadline and read on the virtual
+ * clock.
+ *
+ *   g++ -O1 -g -std=gnu++17 -fsanitize=address,undefined -Ilib/native_hal -Isrc \
+ *       tools/sensortest.cpp src/tempsensors.cpp lib/native_hal/hal.cpp lib/native_hal/OneWire.cpp \
+ *       lib/native_hal/DallasTemperature.cpp lib/native_hal/WString.cpp -o /tmp/sensortest
+ *   /tmp/sensortest
+ *
+ * The reader runs on a 32-bit clock, as millis() is on the ESP8266, that
+ * starts just short of its wrap so that one of the conversions spans it.
+ * Checks:
+ *  - poll() requests a conversion, then returns false until the deadline
+ *    for the resolution has passed, and only then reads
+ *  - what it reads is the temperature at the time of the request
+ *  - a conversion across the millis() wrap takes its normal time
+ *  - an unplugged sensor reads DEVICE_DISCONNECTED_C, the other one goes on
+ * Exits non-zero on failure.
+ */
+#include <Arduino.h>
+#include <OneWire.h>
+#include <DallasTemperature.h>
+#include "tempsensors.h"
+#include <stdio.h>
+
+// the virtual clock as the device's millis() would show it: 32 bits, wrapping
+static const uint32_t START = 0xffffffff - 1000;
+static unsigned long clock32() { return (uint32_t)(START + hal::now_us() / 1000); }
+
+static int failures = 0;
+
+static void check(bool ok, const char *what, double at = 0) {
+  if (!ok && failures++ < 20) printf("FAIL %s (%g)\n", what, at);
+}
+
+// polls every ms until a reading comes: how long it took
+static unsigned long untilReading(AsyncTempSensors &reader) {
+  unsigned long start = clock32();
+  for (unsigned long ms = 0; ms < 5000; ms++) {
+    if (reader.poll()) return (uint32_t)(clock32() - start);
+    check(reader.state() == AsyncTempSensors::CONVERSION_REQUESTED, "requested while waiting", ms);
+    hal::advance(1);
+  }
+  return 0;
+}
+
+int main() {
+  OneWire bus(D1);
+  DallasTemperature sensors(&bus);
+  FakeDS18B20 *probe = bus.attach(62.3f);
+  FakeDS18B20 *ambiant = bus.attach(21.1f);
+  DeviceAddress addr0, addr1;
+  sensors.begin();
+  check(sensors.getAddress(addr0, 0) && sensors.getAddress(addr1, 1), "addresses");
+
+  AsyncTempSensors reader(sensors, addr0, addr1, clock32);
+  reader.begin();
+  check(reader.state() == AsyncTempSensors::CONVERSION_REQUESTED, "begin() requests");
+  check(reader.value(0) == DEVICE_DISCONNECTED_C, "no value before the first read", reader.value(0));
+
+  // 12 bits: 750 ms, first reading
+  probe->temperature = 70;   // after the request: not in this conversion
+  unsigned long took = untilReading(reader);
+  check(took == 750, "reading at the deadline", took);
+  check(reader.value(0) == 62.25f && reader.value(1) == 21.0625f, "values of the request time", reader.value(0));
+  check(reader.state() == AsyncTempSensors::RESULT_READY, "ready after the read");
+
+  // the next poll() requests again ; this conversion spans the millis() wrap
+  check(!reader.poll(), "request is not a reading");
+  unsigned long requested = clock32();
+  took = untilReading(reader);
+  check(requested > clock32(), "conversion spanned the wrap", requested);
+  check(took == 750, "same conversion time across the wrap", took);
+  check(reader.value(0) == 70, "new value", reader.value(0));
+
+  // unplugged: that one reads disconnected, the other goes on
+  ambiant->connected = false;
+  probe->temperature = 71.5f;
+  reader.poll();
+  took = untilReading(reader);
+  check(took == 750, "conversion with a sensor gone", took);
+  check(reader.value(1) == DEVICE_DISCONNECTED_C, "unplugged reads disconnected", reader.value(1));
+  check(reader.value(0) == 71.5f, "the other one still read", reader.value(0));
+
+  // plugged back: values again from the next conversion on
+  ambiant->connected = true;
+  ambiant->temperature = 22;
+  reader.poll();
+  untilReading(reader);
+  check(reader.value(1) == 22, "plugged back", reader.value(1));
+
+  // resolution: its own conversion time
+  sensors.setResolution(9);
+  AsyncTempSensors fast(sensors, addr0, addr1, clock32);
+  fast.begin();
+  took = untilReading(fast);
+  check(took == 94, "9 bit conversion time", took);
+  check(fast.value(0) == 71.5f && fast.value(1) == 22, "9 bit values", fast.value(0));
+
+  printf(failures ? "%d failures\n" : "all good\n", failures);
+  return failures != 0;
+}
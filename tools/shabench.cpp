@@ -0,0 +1,184 @@
+/*
+ * Host check and benchmark of src/sha256.cpp: FIPS 180-2 and RFC 4231
+ * vectors (whole and fed in odd-sized pieces), then cycles per byte against
+ * the previous kernel (64-word schedule, byte-at-a-time update), kept below.
+ *
+ *   g++ -O2 -Isrc tools/shabench.cpp src/sha256.cpp -o /tmp/shabench
+ *   /tmp/shabench
+ *
+ * Exits non-zero if a vector fails. Cycles come from the TSC on x86 and are
+ * nanoseconds elsewhere.
+ */
+#include "sha256.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static uint64_t ticks() { return __rdtsc(); }
+static const char *UNIT = "cycles/byte";
+#else
+static uint64_t ticks() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+static const char *UNIT = "ns/byte";
+#endif
+
+// ---- the previous implementation ----
+
+namespace before {
+
+static inline uint32_t rotr(uint32_t x, uint32_t n) { return (x >> n) | (x << (32 - n)); }
+
+static void transform(uint32_t state[8], const uint8_t block[64]) {
+  static const uint32_t K[64] = {
+    0x428a2f98,0x71374491,0xb5c0fbcf,0xe9b5dba5,0x3956c25b,0x59f111f1,0x923f82a4,0xab1c5ed5,
+    0xd807aa98,0x12835b01,0x243185be,0x550c7dc3,0x72be5d74,0x80deb1fe,0x9bdc06a7,0xc19bf174,
+    0xe49b69c1,0xefbe4786,0x0fc19dc6,0x240ca1cc,0x2de92c6f,0x4a7484aa,0x5cb0a9dc,0x76f988da,
+    0x983e5152,0xa831c66d,0xb00327c8,0xbf597fc7,0xc6e00bf3,0xd5a79147,0x06ca6351,0x14292967,
+    0x27b70a85,0x2e1b2138,0x4d2c6dfc,0x53380d13,0x650a7354,0x766a0abb,0x81c2c92e,0x92722c85,
+    0xa2bfe8a1,0xa81a664b,0xc24b8b70,0xc76c51a3,0xd192e819,0xd6990624,0xf40e3585,0x106aa070,
+    0x19a4c116,0x1e376c08,0x2748774c,0x34b0bcb5,0x391c0cb3,0x4ed8aa4a,0x5b9cca4f,0x682e6ff3,
+    0x748f82ee,0x78a5636f,0x84c87814,0x8cc70208,0x90befffa,0xa4506ceb,0xbef9a3f7,0xc67178f2
+  };
+  uint32_t W[64];
+  uint32_t a,b,c,d,e,f,g,h;
+  for (int i=0;i<16;i++) {
+    W[i] = (uint32_t)block[i*4] << 24 | (uint32_t)block[i*4+1] << 16 |
+           (uint32_t)block[i*4+2] << 8 | (uint32_t)block[i*4+3];
+  }
+  for (int i=16;i<64;i++) {
+    uint32_t s0 = rotr(W[i-15],7) ^ rotr(W[i-15],18) ^ (W[i-15] >> 3);
+    uint32_t s1 = rotr(W[i-2],17) ^ rotr(W[i-2],19) ^ (W[i-2] >> 10);
+    W[i] = W[i-16] + s0 + W[i-7] + s1;
+  }
+  a = state[0]; b = state[1]; c = state[2]; d = state[3];
+  e = state[4]; f = state[5]; g = state[6]; h = state[7];
+  for (int i=0;i<64;i++) {
+    uint32_t S1 = rotr(e,6) ^ rotr(e,11) ^ rotr(e,25);
+    uint32_t ch = (e & f) ^ ((~e) & g);
+    uint32_t temp1 = h + S1 + ch + K[i] + W[i];
+    uint32_t S0 = rotr(a,2) ^ rotr(a,13) ^ rotr(a,22);
+    uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+    uint32_t temp2 = S0 + maj;
+    h = g; g = f; f = e; e = d + temp1;
+    d = c; c = b; b = a; a = temp1 + temp2;
+  }
+  state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+  state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+static void update(sha256_ctx *ctx, const uint8_t *data, size_t len) {
+  size_t idx = (ctx->bitcount >> 3) % 64;
+  ctx->bitcount += (uint64_t)len << 3;
+  for (size_t i=0;i<len;i++) {
+    ctx->buffer[idx++] = data[i];
+    if (idx == 64) {
+      transform(ctx->state, ctx->buffer);
+      idx = 0;
+    }
+  }
+}
+
+}  // namespace before
+
+// ---- vectors ----
+
+static std::string hex(const uint8_t *p, size_t n) {
+  std::string s;
+  char b[3];
+  for (size_t i = 0; i < n; i++) {
+    snprintf(b, sizeof(b), "%02x", p[i]);
+    s += b;
+  }
+  return s;
+}
+
+static int failures = 0;
+
+static void expect(const char *name, const uint8_t *digest, const char *want) {
+  std::string got = hex(digest, SHA256_HASH_SIZE);
+  bool ok = got == want;
+  if (!ok) failures++;
+  printf("%-4s %s%s%s\n", ok ? "ok" : "FAIL", name, ok ? "" : "\n     got  ", ok ? "" : got.c_str());
+}
+
+static void sha256Vector(const char *name, const std::string &msg, const char *want) {
+  uint8_t digest[SHA256_HASH_SIZE];
+  sha256_ctx ctx;
+  sha256_init(&ctx);
+  sha256_update(&ctx, (const uint8_t *)msg.data(), msg.size());
+  sha256_final(&ctx, digest);
+  expect(name, digest, want);
+
+  // the same in pieces of 1, 2, 3... bytes: partial blocks, bulk blocks and their joins
+  sha256_init(&ctx);
+  for (size_t p = 0, n = 1; p < msg.size(); p += n, n = n % 150 + 1) {
+    sha256_update(&ctx, (const uint8_t *)msg.data() + p, n < msg.size() - p ? n : msg.size() - p);
+  }
+  sha256_final(&ctx, digest);
+  expect((std::string(name) + ", in pieces").c_str(), digest, want);
+}
+
+static void hmacVector(const char *name, const std::string &key, const std::string &msg, const char *want) {
+  uint8_t mac[SHA256_HASH_SIZE];
+  hmac_sha256((const uint8_t *)key.data(), key.size(), (const uint8_t *)msg.data(), msg.size(), mac);
+  expect(name, mac, want);
+}
+
+// ---- benchmark ----
+
+template <class F>
+static double perByte(F f, const std::vector<uint8_t> &msg) {
+  double best = 1e30;
+  size_t rounds = 1 + (1 << 20) / msg.size();
+  for (int rep = 0; rep < 5; rep++) {
+    uint64_t t0 = ticks();
+    for (size_t r = 0; r < rounds; r++) f(msg);
+    double t = (double)(ticks() - t0) / rounds / msg.size();
+    if (t < best) best = t;
+  }
+  return best;
+}
+
+int main() {
+  sha256Vector("FIPS 180-2 \"abc\"", "abc",
+               "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+  sha256Vector("empty", "",
+               "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+  sha256Vector("FIPS 180-2 448 bits", "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+               "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+  sha256Vector("896 bits", "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+               "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1");
+  sha256Vector("FIPS 180-2 million a", std::string(1000000, 'a'),
+               "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+  hmacVector("RFC 4231 case 2", "Jefe", "what do ya want for nothing?",
+             "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843");
+  hmacVector("RFC 4231 case 6", std::string(131, '\xaa'), "Test Using Larger Than Block-Size Key - Hash Key First",
+             "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54");
+
+  printf("\n%8s %14s %14s\n", "bytes", "before", "now");
+  for (size_t n : { 64, 1024, 16384 }) {
+    std::vector<uint8_t> msg(n);
+    for (size_t i = 0; i < n; i++) msg[i] = (uint8_t)(i * 31 + 7);
+    double old = perByte([](const std::vector<uint8_t> &m) {
+      sha256_ctx ctx;
+      sha256_init(&ctx);
+      before::update(&ctx, m.data(), m.size());
+      uint8_t d[SHA256_HASH_SIZE];
+      sha256_final(&ctx, d);   // the padding block: same cost on both sides
+    }, msg);
+    double now = perByte([](const std::vector<uint8_t> &m) {
+      sha256_ctx ctx;
+      sha256_init(&ctx);
+      sha256_update(&ctx, m.data(), m.size());
+      uint8_t d[SHA256_HASH_SIZE];
+      sha256_final(&ctx, d);
+    }, msg);
+    printf("%8zu %14.2f %14.2f %s\n", n, old, now, UNIT);
+  }
+  return failures ? 1 : 0;
+}
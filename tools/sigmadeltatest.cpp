@@ -0,0 +1,243 @@
+/*
+ * Host test of src/sigma_delta.h: the modulator on a simulated 50 Hz tick,
+ * then SsrSigmaDelta on its Ticker over the virtual clock of lib/native_hal.
+ *
+ *   g++ -O1 -g -std=gnu++17 -fsanitize=address,undefined -Ilib/native_hal -Isrc \
+ *       tools/sigmadeltatest.cpp src/sigma_delta.cpp lib/native_hal/hal.cpp lib/native_hal/WString.cpp \
+ *       -o /tmp/sigmadeltatest
+ *   /tmp/sigmadeltatest
+ *
+ * For a range of demand levels and start phases:
+ *  - spacing: any run of n cycles holds floor or ceil of n x duty on-cycles,
+ *    so they are spread as evenly as whole cycles allow
+ *  - duty: over an hour of cycles it matches the demand to the fixed point step
+ *  - a new demand takes over within a cycle, with no burst to make up for the old one
+ * and for SsrSigmaDelta, three outputs on their pins:
+ *  - each conducts its duty of the time
+ *  - out of phase: at 1/3 each, never two at once
+ *  - publishing 0 opens at once, not at the next cycle
+ * and on a simulated mains a little off 50 Hz, with zero-crossing SSRs that
+ * conduct a half-cycle when their input is on at its zero:
+ *  - paced by the detector, every run of on half-cycles is a whole number of
+ *    cycles (no DC on the feed) and the duty holds ; free-running, it is not
+ *  - a missed crossing costs one odd run at most, not the pairing after it
+ *  - the detector going silent hands over to the Ticker, and back
+ * Exits non-zero on failure.
+ */
+#include <Arduino.h>
+#include "sigma_delta.h"
+#include <hal.h>
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+static int failures = 0;
+
+static void check(bool ok, const char *what, double duty, double at = 0) {
+  if (!ok && failures++ < 20) printf("FAIL %s at duty %g (%g)\n", what, duty, at);
+}
+
+static const double DEMANDS[] = { 0, .001, .01, .05, .1, .25, 1.0 / 3, .4, .5, .6, 2.0 / 3, .75, .9, .99, .999, 1 };
+static const long CYCLES_PER_HOUR = 50L * 3600;
+
+static void modulator() {
+  for (double d : DEMANDS) {
+    for (uint32_t phase : { 0u, SigmaDelta::ONE / 3, SigmaDelta::ONE - 1 }) {
+      SigmaDelta sd(phase);
+      sd.set(d);
+      double level = (double)sd.level() / SigmaDelta::ONE;
+      check(fabs(level - d) <= .5 / SigmaDelta::ONE, "fixed point level", d, level);
+
+      std::vector<uint8_t> on(CYCLES_PER_HOUR);
+      long total = 0;
+      for (long i = 0; i < CYCLES_PER_HOUR; i++) total += on[i] = sd.tick();
+      check(fabs((double)total / CYCLES_PER_HOUR - level) <= 1.0 / CYCLES_PER_HOUR, "duty over an hour", d,
+            (double)total / CYCLES_PER_HOUR);
+
+      // every window of up to 2 s, over the first minute
+      std::vector<long> prefix(3001);
+      for (long i = 0; i < 3000; i++) prefix[i + 1] = prefix[i] + on[i];
+      bool even = true;
+      for (long n = 1; n <= 100 && even; n++) {
+        for (long s = 0; s + n <= 3000; s++) {
+          long k = prefix[s + n] - prefix[s];
+          if (k < floor(n * level - 1e-9) || k > ceil(n * level + 1e-9)) {
+            check(false, "spacing", d, n);
+            even = false;
+            break;
+          }
+        }
+      }
+    }
+  }
+
+  // from a long stretch off to full on, and back: no carried-over burst or gap
+  SigmaDelta sd;
+  sd.set(0);
+  for (int i = 0; i < 1000; i++) sd.tick();
+  sd.set(1);
+  check(sd.tick() && sd.tick(), "full on at once", 1);
+  sd.set(.5);
+  int ons = 0;
+  for (int i = 0; i < 10; i++) ons += sd.tick();
+  check(ons == 5, "half from the next cycle", .5, ons);
+  sd.set(0);
+  ons = 0;
+  for (int i = 0; i < 10; i++) ons += sd.tick();
+  check(ons == 0, "off at once", 0, ons);
+}
+
+// time each pin spends closed (low), from the write hook
+static const int PINS[] = { D3, RX, TX };
+static uint64_t closedSince[3], closedFor[3];
+static int closedNow = 0;
+static uint64_t lastChange = 0, together = 0;   // time with two or more closed
+
+static int index(uint8_t pin) {
+  for (int i = 0; i < 3; i++) {
+    if (PINS[i] == pin) return i;
+  }
+  return -1;
+}
+
+static void outputs() {
+  for (int pin : PINS) {
+    pinMode(pin, OUTPUT);
+    digitalWrite(pin, HIGH);
+  }
+  hal::onDigitalWrite([](uint8_t pin, int level) {
+    int i = index(pin);
+    if (i < 0) return;
+    if (closedNow > 1) together += hal::now_us() - lastChange;
+    lastChange = hal::now_us();
+    if (level == LOW) {
+      closedSince[i] = hal::now_us();
+      closedNow++;
+    } else {
+      closedFor[i] += hal::now_us() - closedSince[i];
+      closedNow--;
+    }
+  });
+
+  SsrSigmaDelta ssr(PINS, 3, 20, LOW);
+  ssr.begin();
+
+  // a third each: the accumulators start a third apart
+  float third[3] = { 1.0f / 3, 1.0f / 3, 1.0f / 3 };
+  ssr.publish(third);
+  hal::advance(60000);
+  check(together == 0, "out of phase, one at a time", 1.0 / 3, together);
+  for (int i = 0; i < 3; i++) {
+    check(fabs(closedFor[i] / 60e6 - 1.0 / 3) < .001, "time closed", 1.0 / 3, closedFor[i] / 60e6);
+  }
+
+  // different demands
+  float duty[3] = { .1f, .5f, .95f };
+  ssr.publish(duty);
+  hal::advance(1000);   // settle into them
+  uint64_t from[3];
+  for (int i = 0; i < 3; i++) from[i] = closedFor[i] + (hal::pinLevel(PINS[i]) == LOW ? hal::now_us() - closedSince[i] : 0);
+  uint64_t start = hal::now_us();
+  hal::advance(600000);
+  for (int i = 0; i < 3; i++) {
+    uint64_t now = closedFor[i] + (hal::pinLevel(PINS[i]) == LOW ? hal::now_us() - closedSince[i] : 0);
+    double got = (double)(now - from[i]) / (hal::now_us() - start);
+    check(fabs(got - duty[i]) < .001, "time closed", duty[i], got);
+  }
+
+  // zero opens right away, mid-cycle
+  float off[3] = { 0, 0, 0 };
+  hal::advance_us(7000);
+  ssr.publish(off);
+  for (int i = 0; i < 3; i++) check(hal::pinLevel(PINS[i]) == HIGH, "zero opens at once", 0, i);
+  hal::advance(1000);
+  check(closedNow == 0, "stays open", 0, closedNow);
+}
+
+// mains zeros: each one starts a half-cycle that the SSR of a closed input conducts
+static const uint8_t ZC_PIN = D6;
+struct Mains : hal::Timer {
+  uint64_t halfCycle_us = 9973;   // 50.14 Hz: the Ticker drifts against it
+  bool detector = true;
+  long skip = -1;                 // zero whose detector pulse is lost
+  long zeros = 0;
+  long onHalfCycles = 0, oddRuns = 0, runs = 0;
+  long run = 0;                   // on half-cycles in the current run
+
+  void fire() override {
+    hal::arm(this, due_us + halfCycle_us);
+    zeros++;
+    bool on = hal::pinLevel(PINS[0]) == LOW;
+    if (on) {
+      run++;
+      onHalfCycles++;
+    } else if (run) {
+      runs++;
+      if (run % 2) oddRuns++;
+      run = 0;
+    }
+    if (detector && zeros != skip) {
+      hal::setInput(ZC_PIN, LOW);
+      hal::setInput(ZC_PIN, HIGH);
+    }
+  }
+};
+
+static void zeroCross(bool paced, double duty) {
+  Mains mains;
+  hal::setInput(ZC_PIN, LOW);
+  SsrSigmaDelta ssr(PINS, 1, 20, LOW, paced ? ZC_PIN : SsrSigmaDelta::NO_ZERO_CROSS);
+  ssr.begin();
+  float d[1] = { (float)duty };
+  ssr.publish(d);
+  hal::arm(&mains, hal::now_us() + 3000);
+  hal::advance(120000);
+  if (paced) {
+    check(ssr.locked(), "locked on the detector", duty);
+    check(mains.oddRuns == 0, "paced: whole cycles only", duty, mains.oddRuns);
+    check(fabs((double)mains.onHalfCycles / mains.zeros - duty) < .002, "paced: duty", duty,
+          (double)mains.onHalfCycles / mains.zeros);
+  } else if (duty > 0 && duty < 1) {
+    check(mains.oddRuns > 0, "free-running: odd runs expected", duty, mains.runs);
+  }
+
+  if (paced && duty > 0 && duty < 1) {
+    // a pulse lost: that cycle's switching comes a half-cycle late, then
+    // the following cycles pair the same half-cycles as before
+    mains.skip = mains.zeros + 7;
+    long odd = mains.oddRuns;
+    hal::advance(200);
+    check(mains.oddRuns - odd <= 1, "missed crossing: one odd run at most", duty, mains.oddRuns - odd);
+    odd = mains.oddRuns;
+    hal::advance(10000);
+    check(mains.oddRuns == odd, "missed crossing: whole cycles after it", duty, mains.oddRuns - odd);
+
+    // detector gone: the Ticker keeps the outputs modulated ; back: locked again
+    mains.detector = false;
+    long on = mains.onHalfCycles, zeros = mains.zeros;
+    hal::advance(10000);
+    check(!ssr.locked(), "silent detector: unlocked", duty);
+    check(fabs((double)(mains.onHalfCycles - on) / (mains.zeros - zeros) - duty) < .01, "silent detector: duty", duty,
+          (double)(mains.onHalfCycles - on) / (mains.zeros - zeros));
+    mains.detector = true;
+    hal::advance(100);
+    odd = mains.oddRuns;
+    hal::advance(10000);
+    check(ssr.locked() && mains.oddRuns == odd, "detector back: whole cycles again", duty, mains.oddRuns - odd);
+  }
+  hal::disarm(&mains);
+  detachInterrupt(ZC_PIN);   // the next one may not use it
+  float off[1] = { 0 };
+  ssr.publish(off);
+}
+
+int main() {
+  modulator();
+  outputs();
+  for (double d : { 0.0, .1, 1.0 / 3, .5, .77, 1.0 }) {
+    zeroCross(false, d);
+    zeroCross(true, d);
+  }
+  printf(failures ? "%d failures\n" : "all good\n", failures);
+  return failures != 0;
+}